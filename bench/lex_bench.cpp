@@ -0,0 +1,262 @@
+/**
+ * Lexer throughput benchmark.
+ *
+ *   make lex_bench && ./lex_bench [MB] [runs]
+ *
+ * It writes a C0 source of about MB megabytes (26 by default) to
+ * lex_bench.txt, then reads all its words with readSymbol(), and with
+ * a per-character lexer, which is readSymbol() as it was before the
+ * scan kernels (see scan.h): nextch() for every character, tolower()
+ * and push_back() for every identifier character. Keywords are looked
+ * up by reservedWord() in both, so only the scanning differs. Each
+ * lexer reads the source `runs` times (5 by default), the best time
+ * is printed. Source lines are echoed to a null stream, on the first
+ * run only, as the lexer prints each line once.
+ */
+#include <iostream>         // cout
+#include <fstream>          // ofstream
+#include <string>           // string
+#include <chrono>           // steady_clock
+#include <cctype>           // isalpha(), isdigit(), tolower()
+#include <cstdio>           // remove(), printf()
+#include <cstdlib>          // atoi()
+#include <iomanip>          // setw()
+#include "common.h"
+#include "symbol.h"
+#include "error.h"
+#include "source.h"
+
+
+/* globals defined by main.cpp */
+std::string     source_filename;
+std::ostream    midcode_stream(NULL);
+std::ostream    mipscode_stream(NULL);
+std::ostream    opt_midcode_stream(NULL);
+std::ostream    opt_mipscode_stream(NULL);
+std::ostream    debug_stream(NULL);
+
+/* stream buffer throwing away what is written */
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) { return c; }
+    std::streamsize xsputn(const char *, std::streamsize n) { return n; }
+};
+
+static void writeSource(const std::string &filename, size_t bytes);
+static size_t lexSource();
+static size_t lexSourceByChar();
+
+
+int main(int argc, char *argv[])
+{
+    int mb = argc > 1 ? std::atoi(argv[1]) : 26;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (mb < 1 || runs < 1) {
+        std::cout << "usage: lex_bench [MB] [runs]" << std::endl;
+        return 1;
+    }
+    source_filename = "lex_bench.txt";
+    writeSource(source_filename, (size_t)mb << 20);
+    if (!loadSource(source_filename)) {
+        std::cout << "can't open source file: " << source_filename << std::endl;
+        return 1;
+    }
+    std::remove(source_filename.c_str());
+    setServerMode(true);        // end of source throws CompileStop
+
+    NullBuffer null_buffer;
+    std::streambuf *stdout_buffer = std::cout.rdbuf(&null_buffer);
+    typedef std::chrono::steady_clock Clock;
+    double best[2] = { 1e30, 1e30 };
+    size_t words[2] = { 0, 0 };
+    for (int run = 0; run < runs; run++) {
+        for (int k = 0; k < 2; k++) {
+            Clock::time_point start = Clock::now();
+            words[k] = (k == 0 ? lexSourceByChar() : lexSource());
+            double t = std::chrono::duration<double>(Clock::now() - start).count();
+            if (t < best[k])
+                best[k] = t;
+        }
+    }
+    std::cout.rdbuf(stdout_buffer);
+    unloadSource();
+
+    if (words[0] != words[1]) {
+        std::printf("lexers disagree: %zu words by character, %zu words\n",
+                words[0], words[1]);
+        return 1;
+    }
+    std::printf("%d MB, %zu words, best of %d runs\n", mb, words[1], runs);
+    std::printf("  by character:   %.3fs  %6.1f MB/s\n", best[0], mb / best[0]);
+    std::printf("  readSymbol():   %.3fs  %6.1f MB/s\n", best[1], mb / best[1]);
+    std::printf("  speedup:        %.2fx\n", best[0] / best[1]);
+    return 0;
+}
+
+/**
+ * Functions of declarations, loops, conditions, calls and strings,
+ * with names in mixed case, until the source has `bytes` bytes.
+ */
+static void writeSource(const std::string &filename, size_t bytes)
+{
+    std::ofstream out(filename);
+    out << "int Global_Counter, global_table[100];\n";
+    size_t size = 0;
+    for (int n = 0; size < bytes; n++) {
+        std::string f = "compute_Value_" + std::to_string(n);
+        std::string text =
+            "int " + f + "(int Left_Operand, int right_operand)\n"
+            "{\n"
+            "    const int LIMIT = 1000, Step_Size = 17;\n"
+            "    int index_Variable, accumulated_sum, TEMPORARY;\n"
+            "    char Current_Char;\n"
+            "    index_Variable = 0;\n"
+            "    accumulated_sum = Left_Operand * 31 + right_operand;\n"
+            "    do {\n"
+            "        TEMPORARY = global_table[index_Variable] + Step_Size;\n"
+            "        if (TEMPORARY >= LIMIT) {\n"
+            "            accumulated_sum = accumulated_sum - TEMPORARY / 3;\n"
+            "        } else {\n"
+            "            accumulated_sum = accumulated_sum + TEMPORARY * 2;\n"
+            "        }\n"
+            "        Current_Char = 'a';\n"
+            "        index_Variable = index_Variable + 1;\n"
+            "    } while (index_Variable < 100)\n"
+            "    printf(\"accumulated sum of " + f + " is: \", accumulated_sum);\n"
+            "    Global_Counter = Global_Counter + 1;\n"
+            "    return (accumulated_sum);\n"
+            "}\n\n";
+        out << text;
+        size += text.size();
+    }
+    out << "void main()\n{\n    printf(\"done\");\n}\n";
+}
+
+/* number of words read by readSymbol() up to the end of source */
+static size_t lexSource()
+{
+    seekSource(0, 0);
+    size_t words = 0;
+    try {
+        for (;;) {
+            readSymbol();
+            words++;
+        }
+    } catch (const CompileStop &) {
+        takeDiagnostics();      // the "program incomplete" error
+    }
+    return words;
+}
+
+
+/**
+ * readSymbol() before the scan kernels, kept for comparison. Words
+ * are read into the same globals, errors are not reported.
+ */
+static char         ch;
+static const char  *line_ptr;
+static unsigned int line_len;
+static unsigned int echoed_line_no = 0;
+
+/* false at the end of source */
+static bool nextch()
+{
+    // g_pos == line_len + 1 means the line break is consumed
+    if (g_line_no == 0 || g_pos > line_len) {
+        if (g_line_no == sourceLineCount())
+            return false;
+        g_pos = 0;
+        g_line_no++;
+        line_ptr = sourceLineBegin(g_line_no);
+        line_len = sourceLineLength(g_line_no);
+        if (echoed_line_no < g_line_no) {
+            echoed_line_no = g_line_no;
+            std::cout << std::setw(4) << (int)g_line_no << " ";
+            std::cout.write(line_ptr, line_len) << '\n';
+        }
+    }
+    // every line ends with a '\n' no matter what line break is used
+    ch = (g_pos == line_len) ? '\n' : line_ptr[g_pos];
+    g_pos++;
+    return true;
+}
+
+static bool isBlankCharacter(char c)
+{
+    return (c == 32 || c == 9 || c == 10);
+}
+
+/* false at the end of source */
+static bool readSymbolByChar()
+{
+    while (isBlankCharacter(ch)) {
+        if (!nextch())
+            return false;
+    }
+    g_word_pos = g_pos - 1;
+    if (std::isdigit(ch)) {
+        g_num = 0;
+        while (ch >= '0' && ch <= '9') {
+            g_num = 10 * g_num + ch - '0';
+            nextch();
+        }
+        g_sym = INTVALUE;
+        return true;
+    }
+    if (std::isalpha(ch) || ch == '_') {
+        static std::string id;
+        id.clear();
+        while (std::isdigit(ch) || std::isalpha(ch) || ch == '_') {
+            ch = std::tolower(ch);
+            id.push_back(ch);
+            nextch();
+        }
+        g_sym = reservedWord(id.data(), id.size());
+        return true;
+    }
+    switch (ch) {
+        case '\"':
+            g_str.clear();
+            nextch();
+            while (ch != '\"' && ch != '\n') {
+                if (ch == 32 || ch == 33 || (ch >= 35 && ch <= 126))
+                    g_str.push_back(ch);
+                nextch();
+            }
+            g_sym = STRVALUE;
+            nextch();
+            break;
+        case '\'':
+            nextch();
+            g_char = ch;
+            nextch();
+            g_sym = CHARVALUE;
+            nextch();
+            break;
+        case '>': case '<': case '!': case '=':
+            g_sym = ch == '>' ? GTR : ch == '<' ? LSS :
+                    ch == '!' ? NEQ : BECOMES;
+            nextch();
+            if (ch == '=') {
+                g_sym = g_sym == GTR ? GEQ : g_sym == LSS ? LEQ :
+                        g_sym == NEQ ? NEQ : EQL;
+                nextch();
+            }
+            break;
+        default:
+            g_sym = char2sym[(int)ch];
+            nextch();
+    }
+    return true;
+}
+
+static size_t lexSourceByChar()
+{
+    g_line_no = 0;
+    g_pos = 0;
+    ch = ' ';
+    size_t words = 0;
+    while (readSymbolByChar())
+        words++;
+    return words;
+}
@@ -0,0 +1,43 @@
+#include <vector>       // vector
+#include <cassert>      // assert
+#include "arena.h"
+
+
+#define ARENA_BLOCK_SIZE    (64 * 1024)
+
+Arena::Arena(): used(ARENA_BLOCK_SIZE)
+{
+}
+
+Arena::~Arena()
+{
+    clear();
+}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+    assert(align != 0 && (align & (align - 1)) == 0 && align <= 16);
+    if (size > ARENA_BLOCK_SIZE / 4) {
+        // big objects get their own block, put it before
+        // the current block so we can keep using that one
+        char *block = new char[size];
+        blocks.insert(blocks.end() - (blocks.empty() ? 0 : 1), block);
+        return block;
+    }
+    size_t offset = (used + align - 1) & ~(align - 1);
+    if (offset + size > ARENA_BLOCK_SIZE) {
+        // `new char[]` is aligned for any fundamental type
+        blocks.push_back(new char[ARENA_BLOCK_SIZE]);
+        offset = 0;
+    }
+    used = offset + size;
+    return blocks.back() + offset;
+}
+
+void Arena::clear()
+{
+    for (auto block : blocks)
+        delete[] block;
+    blocks.clear();
+    used = ARENA_BLOCK_SIZE;
+}
@@ -0,0 +1,42 @@
+/**
+ * This is a bump allocator.
+ *
+ * Memory is taken from big blocks by moving a pointer forward,
+ * nothing is freed until clear() frees all blocks in one go.
+ * Objects made in an arena never have their destructors called,
+ * so only trivially destructible types can be made.
+ */
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>          // size_t
+#include <vector>           // vector
+#include <new>              // placement new
+#include <type_traits>      // is_trivially_destructible
+
+class Arena {
+public:
+    Arena();
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /* `align` must be a power of 2 and no more than 16 */
+    void *allocate(size_t size, size_t align);
+    /* free all memory allocated */
+    void clear();
+
+    template <typename T>
+    T *make()
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                "destructors are not called in arena");
+        return new (allocate(sizeof(T), alignof(T))) T();
+    }
+
+private:
+    std::vector<char *> blocks;
+    size_t              used;   // bytes used in blocks.back()
+};
+
+#endif // ARENA_H_
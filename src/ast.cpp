@@ -0,0 +1,398 @@
+#include <vector>       // vector
+#include <cassert>      // assert
+#include "ast.h"
+#include "midcode.h"
+
+
+/* initialize global variables, one arena for each thread */
+thread_local Arena ast_arena;
+
+/**
+ * Lowering walks the tree with an explicit work stack instead of
+ * recursion, so that deep trees can't overflow the native stack,
+ * e.g. a long `a + b + ... + z` is a left-deep tree. Works are
+ * popped in LIFO order, so those of a node are pushed in reverse.
+ */
+enum WorkKind {
+    WORK_STMTS,         // statements from `stmt`
+    WORK_EXPR,          // `expr` with its operands
+    WORK_EXPR_CODE,     // `expr` itself, operands are done
+    WORK_ARGS,          // arguments from `arg`
+    WORK_CASES,         // comparisons and default clause from `item`
+    WORK_CASE_BODIES,   // other case bodies from `item`
+    WORK_CODE,          // single mid-code `code`
+};
+
+struct Work {
+    WorkKind            kind;
+    const Stmt         *stmt;
+    const Expr         *expr;
+    const Arg          *arg;
+    const CaseItem     *item;
+    const SwitchStmt   *owner;      // switch of `item`
+    FourTuple           code;
+};
+
+static thread_local std::vector<Work> works;
+
+static void lowerDecls(const Decl *decl);
+static void genTemp(DataType type, Operand res);
+static void runWorks();
+static void lowerStmt(const Stmt *stmt);
+static void lowerExprCode(const Expr *expr);
+static void lowerCall(const CallExpr *call);
+
+
+/* works of a node in code order, then push() them */
+class WorkList {
+public:
+    WorkList(): count(0) {}
+
+    /* push all works to the stack, the first one ends on top */
+    void push()
+    {
+        while (count != 0)
+            works.push_back(list[--count]);
+    }
+
+    WorkList &stmts(const Stmt *stmt)
+    {
+        Work &t = add(WORK_STMTS);
+        t.stmt = stmt;
+        return *this;
+    }
+    WorkList &expr(const Expr *expr, WorkKind kind = WORK_EXPR)
+    {
+        Work &t = add(kind);
+        t.expr = expr;
+        return *this;
+    }
+    WorkList &args(const Arg *arg)
+    {
+        Work &t = add(WORK_ARGS);
+        t.arg = arg;
+        return *this;
+    }
+    WorkList &cases(WorkKind kind, const CaseItem *item, const SwitchStmt *owner)
+    {
+        Work &t = add(kind);
+        t.item = item;
+        t.owner = owner;
+        return *this;
+    }
+    WorkList &code(OpCode op, Operand a, Operand b, Operand res)
+    {
+        Work &t = add(WORK_CODE);
+        t.code = { op, a, b, res };
+        return *this;
+    }
+    WorkList &condition(const Condition &cond)
+    {
+        expr(cond.left);
+        if (cond.op == NONE)
+            return code(COMPARE, cond.left->res, NONE, NONE);
+        expr(cond.right);
+        return code(COMPARE, cond.left->res, cond.op, cond.right->res);
+    }
+
+private:
+    Work &add(WorkKind kind)
+    {
+        assert(count < MAX_WORKS);
+        list[count] = Work();
+        list[count].kind = kind;
+        return list[count++];
+    }
+
+    enum { MAX_WORKS = 12 };
+    Work    list[MAX_WORKS];
+    int     count;
+};
+
+
+void lowerProgram(const Program *program)
+{
+    for (const Decl *decl = program->decls; decl != NULL; decl = decl->next) {
+        lowerDecl(decl);
+        if (decl->kind == DECL_FUNCTION) {
+            FunctionScope scope = tabTakeScope();
+            tabKeepScope(scope);
+        }
+    }
+}
+
+static void lowerDecls(const Decl *decl)
+{
+    for (; decl != NULL; decl = decl->next)
+        lowerDecl(decl);
+}
+
+void lowerDecl(const Decl *decl)
+{
+    if (decl->kind == DECL_VAR) {
+        auto t = static_cast<const VarDecl *>(decl);
+        genMidCode(t->op, typeOperand(t->type), t->id, t->size);
+        return;
+    }
+    auto t = static_cast<const FunctionDecl *>(decl);
+    tabRestoreScope(t->scope, t->first_temp);
+    genMidCode(FUNC, typeOperand(t->type), t->id, NONE);
+    lowerDecls(t->params);
+    lowerDecls(t->vars);
+    WorkList().stmts(t->body).push();
+    runWorks();
+    genMidCode(END, NONE, NONE, NONE);
+    tabLayoutFrame(tabName(t->id.value));
+}
+
+/* temp vars are local variables, so they get their frame slots */
+static void genTemp(DataType type, Operand res)
+{
+    tabInsertTemp(res.value, type);
+    genMidCode(TEMP, typeOperand(type), res, NONE);
+}
+
+static void runWorks()
+{
+    while (!works.empty()) {
+        Work t = works.back();
+        works.pop_back();
+        switch (t.kind) {
+            case WORK_STMTS:
+                // one statement at a time, the stack doesn't
+                // grow with length of the list
+                if (t.stmt != NULL) {
+                    WorkList().stmts(t.stmt->next).push();
+                    lowerStmt(t.stmt);
+                }
+                break;
+            case WORK_EXPR:
+                switch (t.expr->kind) {
+                    case EXPR_VALUE:
+                        break;
+                    case EXPR_BINARY: {
+                        auto e = static_cast<const BinaryExpr *>(t.expr);
+                        WorkList().expr(e->left).expr(e->right)
+                            .expr(e, WORK_EXPR_CODE).push();
+                        break;
+                    }
+                    case EXPR_NEG: {
+                        auto e = static_cast<const NegExpr *>(t.expr);
+                        WorkList().expr(e->operand)
+                            .expr(e, WORK_EXPR_CODE).push();
+                        break;
+                    }
+                    case EXPR_ARRAY: {
+                        auto e = static_cast<const ArrayExpr *>(t.expr);
+                        WorkList().expr(e->index)
+                            .expr(e, WORK_EXPR_CODE).push();
+                        break;
+                    }
+                    case EXPR_CALL: {
+                        auto e = static_cast<const CallExpr *>(t.expr);
+                        WorkList().args(e->args)
+                            .expr(e, WORK_EXPR_CODE).push();
+                        break;
+                    }
+                }
+                break;
+            case WORK_EXPR_CODE:
+                lowerExprCode(t.expr);
+                break;
+            case WORK_ARGS:
+                if (t.arg != NULL)
+                    WorkList().expr(t.arg->value).args(t.arg->next).push();
+                break;
+            case WORK_CASES: {
+                if (t.item == NULL)
+                    break;
+                auto item = t.item;
+                WorkList list;
+                if (item->is_default) {
+                    list.code(LABEL, item->label, NONE, NONE)
+                        .stmts(item->body)
+                        .code(GOTO, t.owner->end_label, NONE, NONE);
+                } else {
+                    list.code(COMPARE, t.owner->value->res, relOperand(REL_EQL), item->value)
+                        .code(BNZ, item->label, NONE, NONE);
+                }
+                list.cases(WORK_CASES, item->next, t.owner).push();
+                break;
+            }
+            case WORK_CASE_BODIES: {
+                if (t.item == NULL)
+                    break;
+                auto item = t.item;
+                WorkList list;
+                if (!item->is_default) {
+                    list.code(LABEL, item->label, NONE, NONE)
+                        .stmts(item->body)
+                        .code(GOTO, t.owner->end_label, NONE, NONE);
+                }
+                list.cases(WORK_CASE_BODIES, item->next, t.owner).push();
+                break;
+            }
+            case WORK_CODE:
+                genMidCode(t.code.op, t.code.a, t.code.b, t.code.res);
+                break;
+        }
+    }
+}
+
+static void lowerStmt(const Stmt *stmt)
+{
+    switch (stmt->kind) {
+        case STMT_BLOCK: {
+            WorkList().stmts(static_cast<const BlockStmt *>(stmt)->body).push();
+            break;
+        }
+        case STMT_IF: {
+            auto t = static_cast<const IfStmt *>(stmt);
+            WorkList().condition(t->cond)
+                // bz: brach if not satisfy
+                .code(BZ, t->else_label, NONE, NONE)
+                .code(LABEL, t->if_label, NONE, NONE)
+                .stmts(t->then_body)
+                .code(GOTO, t->end_label, NONE, NONE)
+                .code(LABEL, t->else_label, NONE, NONE)
+                .stmts(t->else_body)
+                .code(LABEL, t->end_label, NONE, NONE).push();
+            break;
+        }
+        case STMT_SWITCH: {
+            /**
+             * All comparisons (and default clause) come first,
+             * then bodies of cases, so that we get:
+             *
+             *      compare 1 and val, if equal goto label_1
+             *      compare 2 and val, if equal goto label_2
+             *   label_default:
+             *      default_statement;
+             *      goto_label_end
+             *   (or just goto label_end without default clause)
+             *   label_1:
+             *      statement1;
+             *      goto label_end
+             *   label_2:
+             *      statement2;
+             *      goto label_end
+             *   label_end:
+             */
+            auto t = static_cast<const SwitchStmt *>(stmt);
+            bool has_default = false;
+            for (const CaseItem *item = t->items; item != NULL; item = item->next)
+                has_default = has_default || item->is_default;
+            WorkList list;
+            list.expr(t->value).cases(WORK_CASES, t->items, t);
+            if (!has_default)
+                list.code(GOTO, t->end_label, NONE, NONE);
+            list.cases(WORK_CASE_BODIES, t->items, t)
+                .code(LABEL, t->end_label, NONE, NONE).push();
+            break;
+        }
+        case STMT_DO_WHILE: {
+            auto t = static_cast<const DoWhileStmt *>(stmt);
+            WorkList().code(LABEL, t->label, NONE, NONE)
+                .stmts(t->body)
+                .condition(t->cond)
+                // BNZ: branch if satisfy
+                .code(BNZ, t->label, NONE, NONE).push();
+            break;
+        }
+        case STMT_PRINTF: {
+            auto t = static_cast<const PrintfStmt *>(stmt);
+            if (t->str != NONE)
+                genMidCode(WRITE, typeOperand(DT_STR), t->str, NONE);
+            if (t->value != NULL) {
+                WorkList().expr(t->value)
+                    .code(WRITE, typeOperand(t->type), t->value->res, NONE).push();
+            }
+            break;
+        }
+        case STMT_SCANF: {
+            auto t = static_cast<const ScanfStmt *>(stmt);
+            for (auto item = t->items; item != NULL; item = item->next)
+                genMidCode(READ, typeOperand(item->type), item->id, NONE);
+            break;
+        }
+        case STMT_RETURN: {
+            auto t = static_cast<const ReturnStmt *>(stmt);
+            if (t->value != NULL) {
+                WorkList().expr(t->value)
+                    .code(RET, t->value->res, NONE, NONE).push();
+            } else {
+                genMidCode(RET, NONE, NONE, NONE);
+            }
+            break;
+        }
+        case STMT_ASSIGN: {
+            auto t = static_cast<const AssignStmt *>(stmt);
+            WorkList().expr(t->value)
+                .code(ASSIGN, t->value->res, NONE, t->id).push();
+            break;
+        }
+        case STMT_ARRAY_ASSIGN: {
+            auto t = static_cast<const ArrayAssignStmt *>(stmt);
+            WorkList().expr(t->index).expr(t->value)
+                .code(WARRAY, t->id, t->index->res, t->value->res).push();
+            break;
+        }
+        case STMT_CALL: {
+            // return value is not used
+            auto t = static_cast<const CallStmt *>(stmt);
+            WorkList().args(t->call->args).expr(t->call, WORK_EXPR_CODE).push();
+            break;
+        }
+    }
+}
+
+/* code of `expr` itself, its operands are already lowered */
+static void lowerExprCode(const Expr *expr)
+{
+    switch (expr->kind) {
+        case EXPR_VALUE:
+            break;
+        case EXPR_BINARY: {
+            auto t = static_cast<const BinaryExpr *>(expr);
+            genTemp(DT_INT, t->res);
+            genMidCode(t->op, t->left->res, t->right->res, t->res);
+            break;
+        }
+        case EXPR_NEG: {
+            auto t = static_cast<const NegExpr *>(expr);
+            genTemp(DT_INT, t->res);
+            genMidCode(SUB, intOperand(0), t->operand->res, t->res);
+            break;
+        }
+        case EXPR_ARRAY: {
+            auto t = static_cast<const ArrayExpr *>(expr);
+            genTemp(t->type, t->res);
+            genMidCode(RARRAY, t->array, t->index->res, t->res);
+            break;
+        }
+        case EXPR_CALL: {
+            auto t = static_cast<const CallExpr *>(expr);
+            lowerCall(t);
+            // a call statement doesn't keep the return value
+            if (t->res == NONE)
+                break;
+            genTemp(t->type, t->res);
+            // return value is always in $v0
+            genMidCode(GETRET, NONE, NONE, t->res);
+            break;
+        }
+    }
+}
+
+/**
+ * Arguments are all evaluated before the first push, so that
+ * function calls in arguments don't break pushed arguments.
+ */
+static void lowerCall(const CallExpr *call)
+{
+    for (auto arg = call->args; arg != NULL; arg = arg->next) {
+        DataType type = (arg->value->dtype == DT_INT ? DT_INT : DT_CHAR);
+        genMidCode(PUSH, typeOperand(type), arg->value->res, NONE);
+    }
+    genMidCode(CALL, call->func, call->argc, NONE);
+}
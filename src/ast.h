@@ -0,0 +1,212 @@
+/**
+ * This module defines the abstract syntax tree built by parser,
+ * and lowers it to quadruple mid-code.
+ *
+ * Nodes are allocated from `ast_arena` and freed in one go after
+ * lowering, each thread has its own arena. Lists (statements, arguments, declarations, ...) are
+ * linked by `next` pointers, so building a tree needs no other
+ * heap allocation.
+ *
+ * Parser checks semantics, folds constant expressions and allocates
+ * temp variables and labels in source order, then stores them in
+ * nodes. Lowering only decides the order of mid-codes, e.g. case
+ * bodies of a switch are put after all comparisons.
+ */
+#ifndef AST_H_
+#define AST_H_
+
+#include "arena.h"
+#include "intern.h"
+#include "table.h"
+#include "midcode.h"
+
+
+/* expressions */
+enum ExprKind {
+    EXPR_VALUE,     // literal or variable, no code needed
+    EXPR_BINARY,    // left op right
+    EXPR_NEG,       // -operand
+    EXPR_ARRAY,     // array[index]
+    EXPR_CALL,      // call of non-void function
+};
+
+/**
+ * `res` holds value of the expression: literal or variable for
+ * EXPR_VALUE, and a temp variable for others.
+ */
+struct Expr {
+    ExprKind    kind;
+    DataType    dtype;
+    Operand     res;
+};
+
+struct BinaryExpr: Expr {
+    OpCode      op;         // ADD, SUB, MUL or DIV
+    Expr       *left;
+    Expr       *right;
+};
+
+struct NegExpr: Expr {
+    Expr       *operand;
+};
+
+struct ArrayExpr: Expr {
+    Operand     array;
+    DataType    type;       // type of temp var, DT_INT or DT_CHAR
+    Expr       *index;
+};
+
+struct Arg {
+    Expr       *value;
+    Arg        *next;
+};
+
+struct CallExpr: Expr {
+    Operand     func;
+    Operand     argc;       // number of parameters
+    DataType    type;       // type of temp var, DT_INT or DT_CHAR
+    Arg        *args;
+};
+
+/* `op` is NONE for a single expression condition */
+struct Condition {
+    Expr       *left;
+    Operand     op;         // relation
+    Expr       *right;
+};
+
+
+/* statements, empty statements are not kept */
+enum StmtKind {
+    STMT_BLOCK,
+    STMT_IF,
+    STMT_SWITCH,
+    STMT_DO_WHILE,
+    STMT_PRINTF,
+    STMT_SCANF,
+    STMT_RETURN,
+    STMT_ASSIGN,
+    STMT_ARRAY_ASSIGN,
+    STMT_CALL,
+};
+
+struct Stmt {
+    StmtKind    kind;
+    Stmt       *next;
+};
+
+struct BlockStmt: Stmt {
+    Stmt       *body;
+};
+
+struct IfStmt: Stmt {
+    Condition   cond;
+    Stmt       *then_body;
+    Stmt       *else_body;
+    Operand     if_label;
+    Operand     else_label;
+    Operand     end_label;
+};
+
+struct CaseItem {
+    bool        is_default;
+    Operand     value;      // cased value
+    Operand     label;
+    Stmt       *body;
+    CaseItem   *next;
+};
+
+struct SwitchStmt: Stmt {
+    Expr       *value;      // switched value
+    CaseItem   *items;      // in source order
+    Operand     end_label;
+};
+
+struct DoWhileStmt: Stmt {
+    Stmt       *body;
+    Condition   cond;
+    Operand     label;
+};
+
+struct PrintfStmt: Stmt {
+    Operand     str;        // label of string, NONE if no string
+    Expr       *value;      // NULL if no expression
+    DataType    type;       // type of value
+};
+
+struct ReadItem {
+    DataType    type;
+    Operand     id;
+    ReadItem   *next;
+};
+
+struct ScanfStmt: Stmt {
+    ReadItem   *items;
+};
+
+struct ReturnStmt: Stmt {
+    Expr       *value;      // NULL if no return value
+};
+
+struct AssignStmt: Stmt {
+    Operand     id;
+    Expr       *value;
+};
+
+struct ArrayAssignStmt: Stmt {
+    Operand     id;
+    Expr       *index;
+    Expr       *value;
+};
+
+struct CallStmt: Stmt {
+    CallExpr   *call;
+};
+
+
+/* declarations */
+enum DeclKind {
+    DECL_VAR,       // global var, local var or parameter
+    DECL_FUNCTION,
+};
+
+struct Decl {
+    DeclKind    kind;
+    Decl       *next;
+};
+
+struct VarDecl: Decl {
+    OpCode      op;         // GVAR, VAR or PARA
+    DataType    type;
+    Operand     id;
+    Operand     size;       // NONE if not an array
+};
+
+struct FunctionDecl: Decl {
+    DataType    type;
+    Operand     id;
+    Decl       *params;
+    Decl       *vars;
+    Stmt       *body;
+    SavedScope  scope;      // parameters, consts and variables
+    int         first_temp; // temp vars are numbered from it
+};
+
+/* global variables and functions in source order */
+struct Program {
+    Decl       *decls;
+};
+
+
+extern thread_local Arena ast_arena;
+
+/* generate mid-code for the whole program, and keep local scopes */
+void lowerProgram(const Program *program);
+/**
+ * Generate mid-code for a declaration, not those after it. Local
+ * scope of a function is left in use with its frame laid out,
+ * see tabTakeScope().
+ */
+void lowerDecl(const Decl *decl);
+
+#endif // AST_H_
@@ -0,0 +1,237 @@
+#include <vector>       // vector
+#include <utility>      // pair
+#include <algorithm>    // reverse, find
+#include <cassert>      // assert
+#include "cfg.h"
+#include "table.h"
+#include "dom.h"
+#include "dataflow.h"
+
+
+#define LABEL_KINDS     (OPD_IF_END - OPD_LABEL + 1)
+
+/**
+ * Block + 1 of each label in the function being built, indexed by
+ * label kind and number, 0 for labels of other functions. Entries
+ * are reset after a function is built, so they are not cleared.
+ */
+static std::vector<int> label_blocks[LABEL_KINDS];
+
+static int &labelBlock(const Operand &label);
+static void addBlock(FunctionCFG &cfg, size_t begin, size_t end);
+static void addEdge(FunctionCFG &cfg, int from, int to);
+
+
+size_t buildCFG(const MidCodes &codes, size_t begin, FunctionCFG &cfg)
+{
+    assert(codes.op(begin) == FUNC);
+    cfg.begin = begin;
+    cfg.blocks.clear();
+
+    // split codes into blocks, labels are found on the way
+    size_t first = begin;
+    size_t i;
+    for (i = begin + 1; codes.op(i) != END; i++) {
+        OpCode op = codes.op(i);
+        if (op == LABEL) {
+            if (i != first) {
+                addBlock(cfg, first, i);
+                first = i;
+            }
+            labelBlock(codes.operand(i, SLOT_A)) = cfg.blocks.size() + 1;
+        } else if (op == GOTO || op == BZ || op == BNZ || op == RET) {
+            addBlock(cfg, first, i + 1);
+            first = i + 1;
+        }
+    }
+    if (i != first)
+        addBlock(cfg, first, i);
+    cfg.entry = 0;
+    cfg.exit = cfg.blocks.size();
+    addBlock(cfg, i, i + 1);
+    cfg.end = i + 1;
+
+    for (int k = 0; k < cfg.exit; k++) {
+        size_t last = cfg.blocks[k].end - 1;
+        OpCode op = codes.op(last);
+        if (op == RET) {
+            addEdge(cfg, k, cfg.exit);
+            continue;
+        }
+        if (op != GOTO)
+            addEdge(cfg, k, k + 1);
+        if (op == GOTO || op == BZ || op == BNZ) {
+            int target = labelBlock(codes.operand(last, SLOT_A)) - 1;
+            assert(target >= 0);
+            addEdge(cfg, k, target);
+        }
+    }
+    for (const BasicBlock &block : cfg.blocks) {
+        if (codes.op(block.begin) == LABEL)
+            labelBlock(codes.operand(block.begin, SLOT_A)) = 0;
+    }
+    findReversePostorder(cfg);
+    return cfg.end;
+}
+
+static int &labelBlock(const Operand &label)
+{
+    assert(label.kind >= OPD_LABEL && label.kind <= OPD_IF_END);
+    std::vector<int> &blocks = label_blocks[label.kind - OPD_LABEL];
+    if ((size_t)label.value >= blocks.size())
+        blocks.resize(label.value + 1, 0);
+    return blocks[label.value];
+}
+
+static void addBlock(FunctionCFG &cfg, size_t begin, size_t end)
+{
+    BasicBlock block;
+    block.begin = begin;
+    block.end = end;
+    cfg.blocks.push_back(block);
+}
+
+static void addEdge(FunctionCFG &cfg, int from, int to)
+{
+    std::vector<int> &succs = cfg.blocks[from].succs;
+    // a branch to the next block is one edge
+    if (!succs.empty() && succs.back() == to)
+        return;
+    succs.push_back(to);
+    cfg.blocks[to].preds.push_back(from);
+}
+
+void removeEdge(FunctionCFG &cfg, int from, int to)
+{
+    std::vector<int> &succs = cfg.blocks[from].succs;
+    std::vector<int> &preds = cfg.blocks[to].preds;
+    succs.erase(std::find(succs.begin(), succs.end(), to));
+    preds.erase(std::find(preds.begin(), preds.end(), from));
+}
+
+int predIndex(const FunctionCFG &cfg, int from, int to)
+{
+    const std::vector<int> &preds = cfg.blocks[to].preds;
+    auto it = std::find(preds.begin(), preds.end(), from);
+    assert(it != preds.end());
+    return it - preds.begin();
+}
+
+/* depth first search with an explicit stack, see ast.cpp */
+void findReversePostorder(FunctionCFG &cfg)
+{
+    cfg.rpo.clear();
+    std::vector<bool> visited(cfg.blocks.size(), false);
+    // blocks on the path, with their next successor to visit
+    std::vector<std::pair<int, size_t> > path;
+    path.push_back(std::make_pair(cfg.entry, 0));
+    visited[cfg.entry] = true;
+    while (!path.empty()) {
+        std::pair<int, size_t> &top = path.back();
+        const std::vector<int> &succs = cfg.blocks[top.first].succs;
+        if (top.second < succs.size()) {
+            int next = succs[top.second++];
+            if (!visited[next]) {
+                visited[next] = true;
+                path.push_back(std::make_pair(next, 0));
+            }
+        } else {
+            cfg.rpo.push_back(top.first);
+            path.pop_back();
+        }
+    }
+    std::reverse(cfg.rpo.begin(), cfg.rpo.end());
+}
+
+
+static void dumpBlocks(std::ostream &os, const std::vector<int> &blocks)
+{
+    for (int k : blocks)
+        os << " B" << k;
+}
+
+/* print variables in `set`, `names` has an operand of each variable */
+static void dumpVariables(std::ostream &os, const BitSet &set,
+        const VariableBits &vars, const std::vector<Operand> &names)
+{
+    set.forEach([&](size_t k) { os << " " << names[vars.var[k]]; });
+}
+
+void dumpCFG(std::ostream &os, const MidCodes &codes)
+{
+    size_t begin = 0;
+    while (begin < codes.size() && codes.op(begin) != FUNC)
+        begin++;
+    FunctionCFG cfg;
+    DominatorTree dom;
+    LoopForest forest;
+    Liveness liveness;
+    std::vector<Operand> names;
+    while (begin < codes.size()) {
+        buildCFG(codes, begin, cfg);
+        buildDominators(cfg, dom);
+        findLoops(cfg, dom, forest);
+        Name func = tabName(codes.operand(begin, SLOT_B).value);
+        // variables are named by the function's scope
+        tabEnterFunction(func);
+        findLiveVariables(codes, cfg, liveness);
+        names.assign(liveness.vars.bit.size(), NONE);
+        for (size_t i = cfg.begin; i < cfg.end; i++) {
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = codes.operand(i, (OperandSlot)slot);
+                int v = flowVariable(t);
+                if (v >= 0 && (size_t)v < names.size())
+                    names[v] = t;
+            }
+        }
+        os << "function " << func << std::endl;
+        os << "rpo:";
+        dumpBlocks(os, cfg.rpo);
+        os << std::endl;
+        for (const Loop &loop : forest.loops) {
+            os << "loop B" << loop.header << ": depth " << loop.depth;
+            if (loop.parent >= 0)
+                os << ", in loop B" << forest.loops[loop.parent].header;
+            if (loop.preheader >= 0)
+                os << ", preheader B" << loop.preheader;
+            os << ", latches";
+            dumpBlocks(os, loop.latches);
+            os << ", blocks";
+            dumpBlocks(os, loop.blocks);
+            os << std::endl;
+        }
+        for (size_t k = 0; k < cfg.blocks.size(); k++) {
+            const BasicBlock &block = cfg.blocks[k];
+            os << "B" << k << ":" << (k == (size_t)cfg.entry ? " entry" :
+                    k == (size_t)cfg.exit ? " exit" : "") << " preds";
+            dumpBlocks(os, block.preds);
+            os << ", succs";
+            dumpBlocks(os, block.succs);
+            if (dom.idom[k] >= 0)
+                os << ", idom B" << dom.idom[k];
+            if (!dom.frontier[k].empty()) {
+                os << ", frontier";
+                dumpBlocks(os, dom.frontier[k]);
+            }
+            if (forest.depth(k) != 0)
+                os << ", loop depth " << forest.depth(k);
+            if (!dom.reachable(k))
+                os << ", unreachable";
+            os << std::endl;
+            if (dom.reachable(k) && liveness.live.in[k].count() != 0) {
+                os << "  live in:";
+                dumpVariables(os, liveness.live.in[k], liveness.vars, names);
+                os << std::endl;
+            }
+            if (dom.reachable(k) && liveness.live.out[k].count() != 0) {
+                os << "  live out:";
+                dumpVariables(os, liveness.live.out[k], liveness.vars, names);
+                os << std::endl;
+            }
+            for (size_t i = block.begin; i < block.end; i++)
+                os << "    " << codes[i] << std::endl;
+        }
+        os << std::endl;
+        begin = cfg.end;
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * This module builds control flow graphs of functions in mid-code.
+ *
+ * A function is the codes from its FUNC to its END. Blocks are
+ * ranges of codes, a block begins at FUNC, at a LABEL or after a
+ * jump (GOTO, BZ, BNZ, RET), and ends before the next one begins.
+ * A COMPARE is always followed by its BZ or BNZ, so the pair never
+ * crosses blocks. Declarations (PARA, VAR, TEMP) stay where they
+ * are, they generate no code.
+ *
+ * The entry block begins with FUNC and has no predecessors. The exit
+ * block is the END alone, returns and the last block go there.
+ */
+#ifndef CFG_H_
+#define CFG_H_
+
+#include <vector>       // vector
+#include <cstddef>      // size_t
+#include <iostream>     // ostream
+#include "midcode.h"
+
+struct BasicBlock {
+    size_t              begin;      // first code
+    size_t              end;        // one past the last code
+    std::vector<int>    preds;
+    std::vector<int>    succs;      // fall through first, then jump target
+};
+
+struct FunctionCFG {
+    size_t                      begin;      // FUNC
+    size_t                      end;        // one past END
+    std::vector<BasicBlock>     blocks;     // in code order
+    int                         entry;
+    int                         exit;
+    std::vector<int>            rpo;        // reachable blocks, reverse postorder
+};
+
+/**
+ * Build CFG of the function whose FUNC is `codes[begin]`, in time
+ * linear to its codes. Return `cfg.end`, where the next one begins.
+ */
+size_t buildCFG(const MidCodes &codes, size_t begin, FunctionCFG &cfg);
+/**
+ * Remove the edge from block `from` to `to`, after the jump making
+ * it is removed from codes. Find `cfg.rpo` again when done.
+ */
+void removeEdge(FunctionCFG &cfg, int from, int to);
+void findReversePostorder(FunctionCFG &cfg);
+/* index of `from` in predecessors of `to` */
+int predIndex(const FunctionCFG &cfg, int from, int to);
+
+/**
+ * Print blocks of all functions in `codes`, with their codes, edges,
+ * dominators and loops, for debugging (`--dump-cfg`).
+ */
+void dumpCFG(std::ostream &os, const MidCodes &codes);
+
+#endif // CFG_H_
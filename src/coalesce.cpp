@@ -0,0 +1,94 @@
+#include <vector>       // vector
+#include "coalesce.h"
+
+
+static bool touches(const SsaFunction &f, size_t i, const Operand &t);
+
+
+void coalesceCopies(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    std::vector<int> uses(f.names.size(), 0);
+    std::vector<int> versions(f.vars.size(), 0);
+    for (const SsaName &name : f.names) {
+        if (name.def != SSA_DEAD)
+            versions[name.var]++;
+    }
+    for (int b : cfg.rpo) {
+        for (const Phi &phi : f.phis[b]) {
+            for (const Operand &arg : phi.args) {
+                if (arg.kind == OPD_SSA)
+                    uses[arg.value]++;
+            }
+        }
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind == OPD_SSA && usesSlot(op, (OperandSlot)slot))
+                    uses[t.value]++;
+            }
+        }
+    }
+
+    std::vector<Operand> replaced(f.names.size(), NONE);
+    std::vector<bool> removed(f.codes.size(), false);
+    auto replace = [&](Operand t) {
+        return t.kind == OPD_SSA && replaced[t.value] != NONE ?
+            replaced[t.value] : t;
+    };
+    // a name is replaced before its uses, which it dominates
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (usesSlot(op, (OperandSlot)slot) && replace(t) != t)
+                    f.codes.setOperand(i, (OperandSlot)slot, replace(t));
+            }
+            Operand a = f.codes.operand(i, SLOT_A);
+            Operand res = f.codes.operand(i, SLOT_RES);
+            if (op != ASSIGN || a.kind != OPD_SSA)
+                continue;
+
+            int def = f.names[a.value].def;
+            bool coalesce = def >= (int)block.begin && uses[a.value] == 1;
+            for (int k = def + 1; coalesce && k < (int)i; k++)
+                coalesce = !touches(f, k, res);
+            if (coalesce) {
+                f.codes.setOperand(def, defSlot(f.codes.op(def)), res);
+                if (res.kind == OPD_SSA)
+                    f.names[res.value].def = def;
+                f.names[a.value].def = SSA_DEAD;
+                removed[i] = true;
+            } else if (res.kind == OPD_SSA &&
+                    versions[f.names[a.value].var] == 1) {
+                replaced[res.value] = a;
+                removed[i] = true;
+            }
+        }
+    }
+    for (int b : cfg.rpo) {
+        for (Phi &phi : f.phis[b]) {
+            for (Operand &arg : phi.args)
+                arg = replace(arg);
+        }
+    }
+    updateSSA(f, removed);
+}
+
+/* code `i` reads or writes where `t` is stored */
+static bool touches(const SsaFunction &f, size_t i, const Operand &t)
+{
+    if (t.kind != OPD_SSA && f.codes.op(i) == CALL)
+        return true;
+    for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+        Operand x = f.codes.operand(i, (OperandSlot)slot);
+        if (t.kind != OPD_SSA ? x == t : x.kind == OPD_SSA &&
+                f.names[x.value].var == f.names[t.value].var)
+            return true;
+    }
+    return false;
+}
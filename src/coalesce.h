@@ -0,0 +1,22 @@
+/**
+ * This module removes copies of a function in SSA form, the ASSIGNs
+ * from a name that lowering makes for nearly every assignment: `x =
+ * a + b` computes into a temp var, then copies it to `x`.
+ *
+ * A copy from a name used by nothing else, defined earlier in its
+ * block, is coalesced: the definition stores into the destination of
+ * the copy instead, if no code between them touches the destination
+ * (another version of its variable, or the global variable itself, or
+ * a call which may). Otherwise a copy to a name from a variable with
+ * a single version is propagated: uses of the destination take the
+ * source, which is never stored elsewhere while it's live, so it
+ * costs no temp var out of SSA.
+ */
+#ifndef COALESCE_H_
+#define COALESCE_H_
+
+#include "ssa.h"
+
+void coalesceCopies(SsaFunction &f);
+
+#endif // COALESCE_H_
@@ -0,0 +1,442 @@
+#include <vector>       // vector
+#include <map>          // map
+#include <utility>      // pair, swap
+#include <algorithm>    // reverse
+#include "dataflow.h"
+#include "table.h"
+
+
+static bool operandLess(const Operand &x, const Operand &y)
+{
+    return x.kind != y.kind ? x.kind < y.kind : x.value < y.value;
+}
+
+/* an expression, commutative operands in order */
+struct ExprKey {
+    int     op;
+    Operand a;
+    Operand b;
+    bool operator<(const ExprKey &t) const
+    {
+        if (op != t.op)
+            return op < t.op;
+        if (a != t.a)
+            return operandLess(a, t.a);
+        return operandLess(b, t.b);
+    }
+};
+
+static int definedVariable(const MidCodes &codes, size_t i);
+template <typename Visit>
+static void forEachUse(const MidCodes &codes, size_t i, Visit visit);
+static void findCrossBlockVariables(const MidCodes &codes,
+        const FunctionCFG &cfg, VariableBits &vars);
+static bool isExpression(OpCode op);
+static ExprKey expressionOf(const MidCodes &codes, size_t i);
+static bool isGlobal(const Operand &t);
+
+
+void BitSet::fill(bool value)
+{
+    uint64_t x = (value ? ~0ull : 0);
+    for (size_t w = 0; w < words.size(); w++)
+        words[w] = x;
+    // bits past the end stay 0, so sets compare equal
+    if (value && bits % 64 != 0)
+        words.back() &= (1ull << (bits % 64)) - 1;
+}
+
+bool BitSet::unionWith(const BitSet &t)
+{
+    uint64_t changed = 0;
+    for (size_t w = 0; w < words.size(); w++) {
+        uint64_t x = words[w] | t.words[w];
+        changed |= x ^ words[w];
+        words[w] = x;
+    }
+    return changed != 0;
+}
+
+bool BitSet::intersectWith(const BitSet &t)
+{
+    uint64_t changed = 0;
+    for (size_t w = 0; w < words.size(); w++) {
+        uint64_t x = words[w] & t.words[w];
+        changed |= x ^ words[w];
+        words[w] = x;
+    }
+    return changed != 0;
+}
+
+void BitSet::subtract(const BitSet &t)
+{
+    for (size_t w = 0; w < words.size(); w++)
+        words[w] &= ~t.words[w];
+}
+
+void BitSet::transfer(const BitSet &gen, const BitSet &kill)
+{
+    for (size_t w = 0; w < words.size(); w++)
+        words[w] = gen.words[w] | (words[w] & ~kill.words[w]);
+}
+
+size_t BitSet::count() const
+{
+    size_t n = 0;
+    for (size_t w = 0; w < words.size(); w++)
+        n += __builtin_popcountll(words[w]);
+    return n;
+}
+
+
+void DataflowProblem::init(const FunctionCFG &cfg, FlowDirection direction,
+        FlowMeet meet, size_t bits)
+{
+    this->direction = direction;
+    this->meet = meet;
+    this->bits = bits;
+    gen.assign(cfg.blocks.size(), BitSet(bits));
+    kill.assign(cfg.blocks.size(), BitSet(bits));
+    edge_gen.clear();
+    boundary = BitSet(bits);
+}
+
+/**
+ * Blocks are visited in order over and over, a block only when a
+ * neighbour's set has changed since it's visited, until none has.
+ */
+void solveDataflow(const FunctionCFG &cfg, const DataflowProblem &problem,
+        DataflowResult &result)
+{
+    size_t n = cfg.blocks.size();
+    bool forward = (problem.direction == FLOW_FORWARD);
+    result.in.assign(n, BitSet(problem.bits));
+    result.out.assign(n, BitSet(problem.bits));
+    std::vector<BitSet> &before = (forward ? result.in : result.out);
+    std::vector<BitSet> &after = (forward ? result.out : result.in);
+
+    std::vector<int> order(cfg.rpo.begin(), cfg.rpo.end());
+    if (!forward)
+        std::reverse(order.begin(), order.end());
+    std::vector<bool> reachable(n, false), pending(n, false);
+    for (int b : order) {
+        reachable[b] = pending[b] = true;
+        if (problem.meet == FLOW_INTERSECT)
+            after[b].fill(true);
+    }
+    int boundary = (forward ? cfg.entry : cfg.exit);
+
+    BitSet set(problem.bits);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int b : order) {
+            if (!pending[b])
+                continue;
+            pending[b] = false;
+            const BasicBlock &block = cfg.blocks[b];
+            const std::vector<int> &from = (forward ? block.preds : block.succs);
+            const std::vector<int> &to = (forward ? block.succs : block.preds);
+            BitSet &meet = before[b];
+            if (b == boundary) {
+                meet = problem.boundary;
+            } else {
+                meet.fill(problem.meet == FLOW_INTERSECT);
+                bool any = false;
+                for (int x : from) {
+                    if (!reachable[x])
+                        continue;
+                    if (problem.meet == FLOW_UNION)
+                        meet.unionWith(after[x]);
+                    else
+                        meet.intersectWith(after[x]);
+                    any = true;
+                }
+                if (!any)
+                    meet.fill(false);
+            }
+            if (!problem.edge_gen.empty())
+                meet.unionWith(problem.edge_gen[b]);
+
+            set = meet;
+            set.transfer(problem.gen[b], problem.kill[b]);
+            if (set == after[b])
+                continue;
+            std::swap(set, after[b]);
+            for (int x : to) {
+                if (reachable[x] && !pending[x]) {
+                    pending[x] = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+
+int flowVariable(const Operand &t)
+{
+    return t.kind == OPD_SSA ? t.value : localVariable(t);
+}
+
+static int definedVariable(const MidCodes &codes, size_t i)
+{
+    OperandSlot slot = defSlot(codes.op(i));
+    return slot == SLOT_COUNT ? -1 : flowVariable(codes.operand(i, slot));
+}
+
+/* call `visit` with each variable read by `codes[i]` */
+template <typename Visit>
+static void forEachUse(const MidCodes &codes, size_t i, Visit visit)
+{
+    OpCode op = codes.op(i);
+    for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+        if (!usesSlot(op, (OperandSlot)slot))
+            continue;
+        int v = flowVariable(codes.operand(i, (OperandSlot)slot));
+        if (v >= 0)
+            visit(v);
+    }
+}
+
+/* give bits to variables used in a block before they are defined there */
+static void findCrossBlockVariables(const MidCodes &codes,
+        const FunctionCFG &cfg, VariableBits &vars)
+{
+    vars.bit.clear();
+    vars.var.clear();
+    std::vector<int> defined_in;        // last block defining each
+    auto grow = [&](int v) {
+        if ((size_t)v >= vars.bit.size()) {
+            vars.bit.resize(v + 1, -1);
+            defined_in.resize(v + 1, -1);
+        }
+    };
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            forEachUse(codes, i, [&](int v) {
+                grow(v);
+                if (defined_in[v] != b && vars.bit[v] < 0) {
+                    vars.bit[v] = vars.var.size();
+                    vars.var.push_back(v);
+                }
+            });
+            int v = definedVariable(codes, i);
+            if (v >= 0) {
+                grow(v);
+                defined_in[v] = b;
+            }
+        }
+    }
+}
+
+
+void findLiveVariables(const MidCodes &codes, const FunctionCFG &cfg,
+        Liveness &result)
+{
+    findCrossBlockVariables(codes, cfg, result.vars);
+    const VariableBits &vars = result.vars;
+    DataflowProblem problem;
+    problem.init(cfg, FLOW_BACKWARD, FLOW_UNION, vars.var.size());
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        BitSet &uses = problem.gen[b];
+        BitSet &defs = problem.kill[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            forEachUse(codes, i, [&](int v) {
+                int k = vars.bit[v];
+                if (k >= 0 && !defs.test(k))
+                    uses.set(k);
+            });
+            int v = definedVariable(codes, i);
+            if (v >= 0 && vars.bit[v] >= 0)
+                defs.set(vars.bit[v]);
+        }
+    }
+    solveDataflow(cfg, problem, result.live);
+}
+
+
+void findReachingDefinitions(const MidCodes &codes, const FunctionCFG &cfg,
+        ReachingDefinitions &result)
+{
+    findCrossBlockVariables(codes, cfg, result.vars);
+    const VariableBits &vars = result.vars;
+    result.defs.clear();
+    std::vector<std::vector<int> > defs_of(vars.var.size());
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            int v = definedVariable(codes, i);
+            if (v >= 0 && vars.bit[v] >= 0) {
+                defs_of[vars.bit[v]].push_back(result.defs.size());
+                result.defs.push_back(i);
+            }
+        }
+    }
+
+    DataflowProblem problem;
+    problem.init(cfg, FLOW_FORWARD, FLOW_UNION, result.defs.size());
+    std::vector<int> last(vars.var.size(), -1);     // def in the block
+    std::vector<int> touched;
+    size_t d = 0;
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        // definitions are numbered in the same order as found above
+        for (size_t i = block.begin; i < block.end; i++) {
+            int v = definedVariable(codes, i);
+            if (v < 0 || vars.bit[v] < 0)
+                continue;
+            int k = vars.bit[v];
+            if (last[k] < 0)
+                touched.push_back(k);
+            last[k] = d++;
+        }
+        for (int k : touched) {
+            for (int def : defs_of[k])
+                problem.kill[b].set(def);
+            problem.gen[b].set(last[k]);
+            last[k] = -1;
+        }
+        touched.clear();
+    }
+    solveDataflow(cfg, problem, result.reach);
+}
+
+
+/**
+ * Expressions are numbered first, each with the operands it reads,
+ * then those surviving to the end of a block get bits. Writing an
+ * operand (a variable or an array) kills expressions reading it.
+ */
+void findAvailableExpressions(const MidCodes &codes, const FunctionCFG &cfg,
+        AvailableExpressions &result)
+{
+    std::map<ExprKey, int> ids;
+    std::vector<size_t> first;                  // first code of each id
+    std::map<std::pair<int, int>, std::vector<int> > readers;
+    std::vector<int> global_readers;            // ids reading globals
+    std::vector<int> code_ids(codes.size(), -1);
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            if (!isExpression(codes.op(i)))
+                continue;
+            ExprKey key = expressionOf(codes, i);
+            auto it = ids.find(key);
+            if (it == ids.end()) {
+                int id = first.size();
+                it = ids.insert(std::make_pair(key, id)).first;
+                first.push_back(i);
+                bool global = false;
+                for (const Operand &t : { key.a, key.b }) {
+                    int value;
+                    if (t.kind == OPD_NONE || isConstValue(t, value))
+                        continue;
+                    std::vector<int> &r = readers[
+                            std::make_pair((int)t.kind, t.value)];
+                    if (r.empty() || r.back() != id)
+                        r.push_back(id);
+                    global = global || isGlobal(t);
+                }
+                if (global)
+                    global_readers.push_back(id);
+            }
+            code_ids[i] = it->second;
+        }
+    }
+
+    // expressions available at the end of each block, and killed in it
+    size_t n = cfg.blocks.size();
+    std::vector<int> made_in(first.size(), -1);
+    std::vector<std::vector<int> > gen(n), kill(n);
+    std::vector<int> killed_in(first.size(), -1);
+    std::vector<bool> has_bit(first.size(), false);
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        std::vector<int> made;
+        auto killAll = [&](const std::vector<int> &ids) {
+            for (int id : ids) {
+                made_in[id] = -1;
+                if (killed_in[id] != b) {
+                    killed_in[id] = b;
+                    kill[b].push_back(id);
+                }
+            }
+        };
+        auto killReaders = [&](const Operand &t) {
+            auto it = readers.find(std::make_pair((int)t.kind, t.value));
+            if (it != readers.end())
+                killAll(it->second);
+        };
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = codes.op(i);
+            int id = code_ids[i];
+            if (id >= 0 && made_in[id] != b) {
+                made_in[id] = b;
+                made.push_back(id);
+            }
+            OperandSlot slot = defSlot(op);
+            if (slot != SLOT_COUNT)
+                killReaders(codes.operand(i, slot));
+            else if (op == WARRAY)
+                killReaders(codes.operand(i, SLOT_A));
+            else if (op == CALL)
+                killAll(global_readers);
+        }
+        for (int id : made) {
+            if (made_in[id] == b) {
+                gen[b].push_back(id);
+                has_bit[id] = true;
+                made_in[id] = -1;
+            }
+        }
+    }
+
+    std::vector<int> bit_of(first.size(), -1);
+    result.exprs.clear();
+    for (size_t id = 0; id < first.size(); id++) {
+        if (has_bit[id]) {
+            bit_of[id] = result.exprs.size();
+            result.exprs.push_back(first[id]);
+        }
+    }
+    result.code_bits.assign(codes.size(), -1);
+    for (size_t i = 0; i < codes.size(); i++) {
+        if (code_ids[i] >= 0)
+            result.code_bits[i] = bit_of[code_ids[i]];
+    }
+
+    DataflowProblem problem;
+    problem.init(cfg, FLOW_FORWARD, FLOW_INTERSECT, result.exprs.size());
+    for (int b : cfg.rpo) {
+        for (int id : gen[b])
+            problem.gen[b].set(bit_of[id]);
+        for (int id : kill[b]) {
+            if (bit_of[id] >= 0)
+                problem.kill[b].set(bit_of[id]);
+        }
+    }
+    solveDataflow(cfg, problem, result.avail);
+}
+
+static bool isExpression(OpCode op)
+{
+    return op == ADD || op == SUB || op == MUL || op == DIV || op == RARRAY;
+}
+
+static ExprKey expressionOf(const MidCodes &codes, size_t i)
+{
+    ExprKey key = { codes.op(i), codes.operand(i, SLOT_A),
+        codes.operand(i, SLOT_B) };
+    if ((key.op == ADD || key.op == MUL) && operandLess(key.b, key.a))
+        std::swap(key.a, key.b);
+    return key;
+}
+
+/* a global variable or array, a call may change it */
+static bool isGlobal(const Operand &t)
+{
+    return t.kind == OPD_VAR && !((TabHandle)t.value & TAB_LOCAL);
+}
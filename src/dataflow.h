@@ -0,0 +1,160 @@
+/**
+ * This module solves bit vector dataflow problems over the blocks of
+ * a function's CFG, and has the classic ones built on it: liveness,
+ * reaching definitions and available expressions.
+ *
+ * Sets are dense arrays of 64-bit words, set operations are plain
+ * loops over words which compilers turn into SIMD instructions. The
+ * solver is a worklist over reachable blocks, seeded in reverse
+ * postorder (forward problems) or postorder (backward problems), so
+ * a problem on a structured CFG settles in a few passes.
+ *
+ * Only what can flow between blocks gets a bit: a variable used only
+ * in the block defining it is never live across blocks, so a function
+ * of thousands of temp vars gets bit sets of its few real variables.
+ *
+ * Variables are local variables, parameters and temp vars, or SSA
+ * names in SSA form, whose phis are not seen here, see ssa.h.
+ */
+#ifndef DATAFLOW_H_
+#define DATAFLOW_H_
+
+#include <vector>       // vector
+#include <cstdint>      // uint64_t
+#include <cstddef>      // size_t
+#include "midcode.h"
+#include "cfg.h"
+
+class BitSet {
+public:
+    BitSet(): bits(0) {}
+    explicit BitSet(size_t bits, bool value = false)
+        : words((bits + 63) / 64, 0), bits(bits) { fill(value); }
+
+    size_t size() const { return bits; }
+    bool test(size_t i) const { return (words[i / 64] >> (i % 64)) & 1; }
+    void set(size_t i) { words[i / 64] |= 1ull << (i % 64); }
+    void reset(size_t i) { words[i / 64] &= ~(1ull << (i % 64)); }
+    void fill(bool value);
+
+    /* these return true if this set is changed */
+    bool unionWith(const BitSet &t);
+    bool intersectWith(const BitSet &t);
+    void subtract(const BitSet &t);
+    /* this = gen | (this & ~kill) */
+    void transfer(const BitSet &gen, const BitSet &kill);
+
+    bool operator==(const BitSet &t) const { return words == t.words; }
+    bool operator!=(const BitSet &t) const { return words != t.words; }
+    size_t count() const;
+
+    /* call `visit` with each bit set, in order */
+    template <typename Visit>
+    void forEach(Visit visit) const
+    {
+        for (size_t w = 0; w < words.size(); w++) {
+            for (uint64_t x = words[w]; x != 0; x &= x - 1)
+                visit(w * 64 + __builtin_ctzll(x));
+        }
+    }
+
+private:
+    std::vector<uint64_t>   words;
+    size_t                  bits;
+};
+
+enum FlowDirection { FLOW_FORWARD, FLOW_BACKWARD };
+enum FlowMeet { FLOW_UNION, FLOW_INTERSECT };
+
+/**
+ * The transfer function of a block is `after = gen | (before & ~kill)`,
+ * where `before` is the block's in set for a forward problem, and its
+ * out set for a backward one. `before` is the meet of neighbours'
+ * `after` sets, plus `edge_gen` of the block if it's not empty (e.g.
+ * phi arguments read at the end of a predecessor). `boundary` is the
+ * in set of the entry, or the out set of the exit.
+ */
+struct DataflowProblem {
+    FlowDirection           direction;
+    FlowMeet                meet;
+    size_t                  bits;
+    std::vector<BitSet>     gen;        // of each block
+    std::vector<BitSet>     kill;
+    std::vector<BitSet>     edge_gen;
+    BitSet                  boundary;
+
+    /* empty gen and kill sets for each block of `cfg` */
+    void init(const FunctionCFG &cfg, FlowDirection direction,
+            FlowMeet meet, size_t bits);
+};
+
+/* sets of each block, those of unreachable blocks are left empty */
+struct DataflowResult {
+    std::vector<BitSet>     in;
+    std::vector<BitSet>     out;
+};
+
+void solveDataflow(const FunctionCFG &cfg, const DataflowProblem &problem,
+        DataflowResult &result);
+
+/**
+ * Variable of an operand: an SSA name, or the local entry of a local
+ * variable (see localVariable()), -1 for other operands. Variables
+ * read or written by reachable codes are all renamed in SSA form, so
+ * the two never mix.
+ */
+int flowVariable(const Operand &t);
+
+struct VariableBits {
+    std::vector<int>        bit;        // of each variable, -1 if none
+    std::vector<int>        var;        // variable of each bit
+
+    /* bit of the variable of `t`, -1 if none */
+    int bitOf(const Operand &t) const
+    {
+        int v = flowVariable(t);
+        return v < 0 || (size_t)v >= bit.size() ? -1 : bit[v];
+    }
+};
+
+/**
+ * Variables live in and out of each block, a variable has a bit if
+ * it's used in a block before it's defined there.
+ */
+struct Liveness {
+    VariableBits            vars;
+    DataflowResult          live;
+};
+void findLiveVariables(const MidCodes &codes, const FunctionCFG &cfg,
+        Liveness &result);
+
+/**
+ * Definitions reaching the beginning and end of each block. Only
+ * definitions of variables which have bits (see Liveness) get bits,
+ * others can't reach a use in another block.
+ */
+struct ReachingDefinitions {
+    VariableBits            vars;
+    std::vector<size_t>     defs;       // defining code of each bit
+    DataflowResult          reach;
+};
+void findReachingDefinitions(const MidCodes &codes, const FunctionCFG &cfg,
+        ReachingDefinitions &result);
+
+/**
+ * Expressions available at the beginning and end of each block: an
+ * arithmetic code, or an array read, computed on every path with no
+ * change to its operands since. A call changes global variables and
+ * global arrays, a WARRAY changes its array. Expressions are told
+ * apart by opcode and operands, `a + b` and `b + a` are the same.
+ * Only expressions available at the end of a block get bits.
+ */
+struct AvailableExpressions {
+    std::vector<size_t>     exprs;      // a code computing each bit
+    std::vector<int>        code_bits;  // computed by each code, -1 if none
+    DataflowResult          avail;
+};
+void findAvailableExpressions(const MidCodes &codes, const FunctionCFG &cfg,
+        AvailableExpressions &result);
+
+#endif // DATAFLOW_H_
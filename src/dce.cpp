@@ -0,0 +1,214 @@
+#include <vector>           // vector
+#include <utility>          // pair
+#include <unordered_map>    // unordered_map
+#include <algorithm>        // sort
+#include "dce.h"
+#include "table.h"
+#include "intern.h"
+
+
+static bool hasEffect(const MidCodes &codes, size_t i);
+static bool isDeclaration(OpCode op);
+
+
+void removeDeadCode(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    std::vector<bool> live(f.codes.size(), false);
+    std::vector<bool> live_names(f.names.size(), false);
+    std::vector<int> work;
+    // block and index of the phi defining a name
+    std::vector<std::pair<int, int> > phi_of(f.names.size());
+    for (int b : cfg.rpo) {
+        for (size_t k = 0; k < f.phis[b].size(); k++)
+            phi_of[f.phis[b][k].name] = std::make_pair(b, k);
+    }
+    auto use = [&](const Operand &t) {
+        if (t.kind == OPD_SSA && !live_names[t.value]) {
+            live_names[t.value] = true;
+            work.push_back(t.value);
+        }
+    };
+    auto mark = [&](size_t i) {
+        if (live[i])
+            return;
+        live[i] = true;
+        OpCode op = f.codes.op(i);
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            if (usesSlot(op, (OperandSlot)slot))
+                use(f.codes.operand(i, (OperandSlot)slot));
+        }
+    };
+
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            if (hasEffect(f.codes, i))
+                mark(i);
+        }
+    }
+    while (!work.empty()) {
+        int name = work.back();
+        work.pop_back();
+        if (f.names[name].def >= 0) {
+            mark(f.names[name].def);
+        } else if (f.names[name].def == SSA_PHI) {
+            const std::pair<int, int> &at = phi_of[name];
+            for (const Operand &arg : f.phis[at.first][at.second].args)
+                use(arg);
+        }
+    }
+
+    std::vector<bool> removed(f.codes.size(), false);
+    for (size_t k = 0; k < cfg.blocks.size(); k++) {
+        const BasicBlock &block = cfg.blocks[k];
+        bool reachable = f.dom.reachable(k);
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            // labels and declarations are kept, they make no code
+            if (reachable)
+                removed[i] = !live[i];
+            else
+                removed[i] = op != LABEL && !isDeclaration(op);
+        }
+        std::vector<Phi> &phis = f.phis[k];
+        size_t n = 0;
+        for (size_t j = 0; j < phis.size(); j++) {
+            if (live_names[phis[j].name])
+                phis[n++] = phis[j];
+        }
+        phis.resize(n);
+    }
+    updateSSA(f, removed);
+}
+
+/**
+ * A code defining a name has no effect but the name, unless it may
+ * trap: a division by a variable, by 0, or by -1 (INT_MIN / -1).
+ */
+static bool hasEffect(const MidCodes &codes, size_t i)
+{
+    OpCode op = codes.op(i);
+    int divisor;
+    switch (op) {
+        case ASSIGN:
+        case ADD: case SUB: case MUL:
+        case RARRAY:
+        case GETRET:
+            return codes.operand(i, SLOT_RES).kind != OPD_SSA;
+        case DIV:
+            return codes.operand(i, SLOT_RES).kind != OPD_SSA ||
+                !isConstValue(codes.operand(i, SLOT_B), divisor) ||
+                divisor == 0 || divisor == -1;
+        default:
+            return true;
+    }
+}
+
+static bool isDeclaration(OpCode op)
+{
+    return op == PARA || op == VAR || op == TEMP;
+}
+
+
+/**
+ * Code after a GOTO or RET up to a label never runs. These are done
+ * over and over, removing one may let the others remove more.
+ */
+void removeJumps(MidCodes &codes)
+{
+    size_t n = codes.size();
+    std::vector<bool> removed(n, false);
+    std::unordered_map<int, int> jumps;     // to each label
+    auto key = [](const Operand &label) {
+        return (label.kind - OPD_LABEL) | (label.value << 3);
+    };
+    for (size_t i = 0; i < n; i++) {
+        OpCode op = codes.op(i);
+        if (op == GOTO || op == BZ || op == BNZ)
+            jumps[key(codes.operand(i, SLOT_A))]++;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        bool dead = false;      // after a GOTO or RET
+        for (size_t i = 0; i < n; i++) {
+            if (removed[i])
+                continue;
+            OpCode op = codes.op(i);
+            if (op == LABEL) {
+                dead = false;
+                if (jumps[key(codes.operand(i, SLOT_A))] == 0) {
+                    removed[i] = changed = true;
+                    continue;
+                }
+            } else if (dead && op != END && !isDeclaration(op)) {
+                if (op == GOTO || op == BZ || op == BNZ)
+                    jumps[key(codes.operand(i, SLOT_A))]--;
+                removed[i] = changed = true;
+                continue;
+            }
+            if (op != GOTO && op != BZ && op != BNZ) {
+                dead = dead || op == RET;
+                continue;
+            }
+            // does the jump go to the code right after it
+            Operand target = codes.operand(i, SLOT_A);
+            bool next = false;
+            for (size_t j = i + 1; j < n && !next; j++) {
+                OpCode x = codes.op(j);
+                if (x == LABEL && !removed[j])
+                    next = (codes.operand(j, SLOT_A) == target);
+                else if (!removed[j] && !isDeclaration(x) && x != LABEL)
+                    break;
+            }
+            if (next) {
+                jumps[key(target)]--;
+                removed[i] = changed = true;
+                if (op != GOTO)
+                    removed[i - 1] = true;      // its COMPARE
+                continue;
+            }
+            dead = (op == GOTO);
+        }
+    }
+    codes.remove(removed);
+}
+
+
+void findCalledFunctions(const MidCodes &codes, std::vector<size_t> &funcs)
+{
+    std::unordered_map<Name, size_t> func_at;
+    for (size_t i = 0; i < codes.size(); i++) {
+        if (codes.op(i) == FUNC)
+            func_at[tabName(codes.operand(i, SLOT_B).value)] = i;
+    }
+    funcs.clear();
+    auto it = func_at.find(NAME_MAIN);
+    if (it == func_at.end()) {
+        for (auto &t : func_at)
+            funcs.push_back(t.second);
+        std::sort(funcs.begin(), funcs.end());
+        return;
+    }
+
+    std::vector<bool> called(codes.size(), false);
+    std::vector<size_t> work(1, it->second);
+    called[it->second] = true;
+    while (!work.empty()) {
+        size_t i = work.back();
+        work.pop_back();
+        funcs.push_back(i);
+        for (i++; codes.op(i) != END; i++) {
+            if (codes.op(i) != CALL)
+                continue;
+            size_t callee = func_at[tabName(codes.operand(i, SLOT_A).value)];
+            if (!called[callee]) {
+                called[callee] = true;
+                work.push_back(callee);
+            }
+        }
+    }
+    std::sort(funcs.begin(), funcs.end());
+}
@@ -0,0 +1,35 @@
+/**
+ * This module removes dead code: codes of a function whose results
+ * are never used, blocks never run, jumps to the next code, and
+ * functions never called.
+ *
+ * In SSA form a code is live if it has an effect (output, input, a
+ * call, a store to memory, a jump), or it defines a name a live code
+ * or phi uses; the rest is removed, so a chain of temps feeding only
+ * dead stores goes at once. A division is kept unless its divisor is
+ * a literal it can't trap on.
+ */
+#ifndef DCE_H_
+#define DCE_H_
+
+#include <vector>       // vector
+#include <cstddef>      // size_t
+#include "midcode.h"
+#include "ssa.h"
+
+/* remove dead codes, phis and unreachable blocks of `f` */
+void removeDeadCode(SsaFunction &f);
+
+/**
+ * Remove jumps to the code after them, then labels no jump goes to,
+ * from codes of a function out of SSA form.
+ */
+void removeJumps(MidCodes &codes);
+
+/**
+ * FUNC of main, and of each function called from it directly or
+ * not, in code order, others never run.
+ */
+void findCalledFunctions(const MidCodes &codes, std::vector<size_t> &funcs);
+
+#endif // DCE_H_
@@ -0,0 +1,187 @@
+#include <vector>       // vector
+#include <utility>      // pair
+#include <algorithm>    // sort
+#include <cassert>      // assert
+#include "dom.h"
+
+
+static int intersect(const std::vector<int> &idom,
+        const std::vector<int> &order, int a, int b);
+static void numberTree(DominatorTree &dom, int root);
+static void addFrontier(std::vector<int> &frontier, int block);
+static void collectLoop(const FunctionCFG &cfg, const DominatorTree &dom,
+        Loop &loop, int latch, std::vector<int> &mark, int stamp);
+
+
+void buildDominators(const FunctionCFG &cfg, DominatorTree &dom)
+{
+    size_t n = cfg.blocks.size();
+    std::vector<int> order(n, -1);      // index in reverse postorder
+    for (size_t i = 0; i < cfg.rpo.size(); i++)
+        order[cfg.rpo[i]] = i;
+
+    dom.idom.assign(n, -1);
+    dom.idom[cfg.entry] = cfg.entry;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 1; i < cfg.rpo.size(); i++) {
+            int b = cfg.rpo[i];
+            int new_idom = -1;
+            for (int p : cfg.blocks[b].preds) {
+                if (dom.idom[p] < 0)    // not processed, or unreachable
+                    continue;
+                new_idom = (new_idom < 0 ? p :
+                        intersect(dom.idom, order, p, new_idom));
+            }
+            if (dom.idom[b] != new_idom) {
+                dom.idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    dom.idom[cfg.entry] = -1;
+
+    dom.children.assign(n, std::vector<int>());
+    for (int b : cfg.rpo) {
+        if (dom.idom[b] >= 0)
+            dom.children[dom.idom[b]].push_back(b);
+    }
+    numberTree(dom, cfg.entry);
+
+    // a join point is in the frontier of blocks from each predecessor
+    // up to its immediate dominator
+    dom.frontier.assign(n, std::vector<int>());
+    for (int b : cfg.rpo) {
+        if (cfg.blocks[b].preds.size() < 2)
+            continue;
+        for (int p : cfg.blocks[b].preds) {
+            if (!dom.reachable(p))
+                continue;
+            for (int runner = p; runner != dom.idom[b];
+                    runner = dom.idom[runner])
+                addFrontier(dom.frontier[runner], b);
+        }
+    }
+}
+
+static int intersect(const std::vector<int> &idom,
+        const std::vector<int> &order, int a, int b)
+{
+    while (a != b) {
+        while (order[a] > order[b])
+            a = idom[a];
+        while (order[b] > order[a])
+            b = idom[b];
+    }
+    return a;
+}
+
+/* number the dominator tree with an explicit stack, see ast.cpp */
+static void numberTree(DominatorTree &dom, int root)
+{
+    dom.pre.assign(dom.idom.size(), -1);
+    dom.post.assign(dom.idom.size(), -1);
+    int pre = 0, post = 0;
+    std::vector<std::pair<int, size_t> > path;
+    path.push_back(std::make_pair(root, 0));
+    dom.pre[root] = pre++;
+    while (!path.empty()) {
+        std::pair<int, size_t> &top = path.back();
+        const std::vector<int> &children = dom.children[top.first];
+        if (top.second < children.size()) {
+            int next = children[top.second++];
+            dom.pre[next] = pre++;
+            path.push_back(std::make_pair(next, 0));
+        } else {
+            dom.post[top.first] = post++;
+            path.pop_back();
+        }
+    }
+}
+
+static void addFrontier(std::vector<int> &frontier, int block)
+{
+    // the same join point is added by its predecessors in a row
+    if (frontier.empty() || frontier.back() != block)
+        frontier.push_back(block);
+}
+
+
+void findLoops(const FunctionCFG &cfg, const DominatorTree &dom,
+        LoopForest &forest)
+{
+    size_t n = cfg.blocks.size();
+    forest.loops.clear();
+    forest.loop_of.assign(n, -1);
+
+    // a loop for each header, found in reverse postorder
+    std::vector<int> loop_at(n, -1);
+    std::vector<int> mark(n, -1);
+    for (int b : cfg.rpo) {
+        for (int h : cfg.blocks[b].succs) {
+            if (!dom.dominates(h, b))
+                continue;
+            if (loop_at[h] < 0) {
+                loop_at[h] = forest.loops.size();
+                Loop loop;
+                loop.header = h;
+                loop.blocks.push_back(h);
+                mark[h] = loop_at[h];
+                forest.loops.push_back(loop);
+            }
+            Loop &loop = forest.loops[loop_at[h]];
+            loop.latches.push_back(b);
+            collectLoop(cfg, dom, loop, b, mark, loop_at[h]);
+        }
+    }
+
+    // an inner loop is smaller than loops around it, so loops are
+    // sorted by size, and each block ends up in its innermost loop
+    std::stable_sort(forest.loops.begin(), forest.loops.end(),
+            [](const Loop &a, const Loop &b) {
+                return a.blocks.size() > b.blocks.size();
+            });
+    for (size_t k = 0; k < forest.loops.size(); k++) {
+        Loop &loop = forest.loops[k];
+        loop.parent = forest.loop_of[loop.header];
+        loop.depth = (loop.parent < 0 ? 1 :
+                forest.loops[loop.parent].depth + 1);
+        for (int b : loop.blocks)
+            forest.loop_of[b] = k;
+
+        loop.preheader = -1;
+        for (int p : cfg.blocks[loop.header].preds) {
+            if (forest.loop_of[p] == (int)k || !dom.reachable(p))
+                continue;
+            bool only_entry = (loop.preheader == -1 &&
+                    cfg.blocks[p].succs.size() == 1);
+            loop.preheader = (only_entry ? p : -2);
+        }
+        if (loop.preheader < 0)
+            loop.preheader = -1;
+    }
+}
+
+/* add blocks reaching `latch` without passing the header */
+static void collectLoop(const FunctionCFG &cfg, const DominatorTree &dom,
+        Loop &loop, int latch, std::vector<int> &mark, int stamp)
+{
+    std::vector<int> work;
+    if (mark[latch] != stamp) {
+        mark[latch] = stamp;
+        loop.blocks.push_back(latch);
+        work.push_back(latch);
+    }
+    while (!work.empty()) {
+        int b = work.back();
+        work.pop_back();
+        for (int p : cfg.blocks[b].preds) {
+            if (mark[p] != stamp && dom.reachable(p)) {
+                mark[p] = stamp;
+                loop.blocks.push_back(p);
+                work.push_back(p);
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/**
+ * This module finds dominators and loops of a function's CFG.
+ *
+ * Dominators are found by the iterative algorithm of Cooper, Harvey
+ * and Kennedy over reverse postorder, which is fast on CFGs of
+ * structured programs like ours. Unreachable blocks are left out:
+ * they have no dominator and dominate nothing.
+ *
+ * Loops are natural loops of back edges, i.e. edges to a block which
+ * dominates the source. Back edges to one header make one loop.
+ * Loops of C0 are do-while loops, CFGs are always reducible, so
+ * loops are either nested or disjoint.
+ */
+#ifndef DOM_H_
+#define DOM_H_
+
+#include <vector>       // vector
+#include "cfg.h"
+
+struct DominatorTree {
+    std::vector<int>                idom;       // -1 for entry, unreachable
+    std::vector<std::vector<int> >  children;
+    std::vector<std::vector<int> >  frontier;   // dominance frontier
+    std::vector<int>                pre;        // dominator tree preorder
+    std::vector<int>                post;       // and postorder numbers
+
+    bool reachable(int block) const { return pre[block] >= 0; }
+    /* `a` dominates `b`, a block dominates itself */
+    bool dominates(int a, int b) const
+    {
+        return pre[a] >= 0 && pre[a] <= pre[b] && post[b] <= post[a];
+    }
+};
+
+void buildDominators(const FunctionCFG &cfg, DominatorTree &dom);
+
+struct Loop {
+    int                 header;
+    int                 parent;     // enclosing loop, -1 if outermost
+    int                 depth;      // 1 for an outermost loop
+    /**
+     * The only predecessor of header out of the loop, if it has no
+     * other successor, so code put at its end runs once before the
+     * loop is entered. -1 if there's no such block.
+     */
+    int                 preheader;
+    std::vector<int>    blocks;     // header first
+    std::vector<int>    latches;    // sources of back edges
+};
+
+struct LoopForest {
+    std::vector<Loop>   loops;      // outer loops before inner loops
+    std::vector<int>    loop_of;    // innermost loop of a block, -1 if none
+
+    int depth(int block) const
+    {
+        return loop_of[block] < 0 ? 0 : loops[loop_of[block]].depth;
+    }
+};
+
+void findLoops(const FunctionCFG &cfg, const DominatorTree &dom,
+        LoopForest &forest);
+
+#endif // DOM_H_
@@ -0,0 +1,90 @@
+#include <vector>       // vector
+#include <algorithm>    // find, remove
+#include "frame.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "table.h"
+
+
+int shareFrameSlots(const MidCodes &codes)
+{
+    FunctionCFG cfg;
+    Liveness liveness;
+    buildCFG(codes, 0, cfg);
+    findLiveVariables(codes, cfg, liveness);
+    const VariableBits &vars = liveness.vars;
+    const DataflowResult &flow = liveness.live;
+
+    // variables which may share slots, in order of definition
+    std::vector<int> shared;
+    size_t count = 0;
+    for (size_t i = 0; i < codes.size(); i++) {
+        OpCode op = codes.op(i);
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            int v = localVariable(codes.operand(i, (OperandSlot)slot));
+            if (v >= (int)count)
+                count = v + 1;
+        }
+        if (op == VAR || op == TEMP) {
+            int v = localVariable(codes.operand(i, SLOT_B));
+            if (v >= 0)
+                shared.push_back(v);
+        }
+    }
+    std::vector<bool> fixed(count, false);
+    flow.in[cfg.entry].forEach([&](size_t k) { fixed[vars.var[k]] = true; });
+
+    std::vector<std::vector<int> > conflicts(count);
+    std::vector<int> live;
+    auto define = [&](int v, int copied) {
+        for (int x : live) {
+            if (x != v && x != copied) {
+                conflicts[v].push_back(x);
+                conflicts[x].push_back(v);
+            }
+        }
+        live.erase(std::remove(live.begin(), live.end(), v), live.end());
+    };
+    auto use = [&](int v) {
+        if (std::find(live.begin(), live.end(), v) == live.end())
+            live.push_back(v);
+    };
+    for (int b : cfg.rpo) {
+        live.clear();
+        flow.out[b].forEach([&](size_t k) { live.push_back(vars.var[k]); });
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.end; i-- > block.begin; ) {
+            OpCode op = codes.op(i);
+            OperandSlot slot = defSlot(op);
+            int def = (slot == SLOT_COUNT ? -1 :
+                    localVariable(codes.operand(i, slot)));
+            if (def >= 0) {
+                int copied = (op == ASSIGN ?
+                        localVariable(codes.operand(i, SLOT_A)) : -1);
+                define(def, copied);
+            }
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                int v = localVariable(codes.operand(i, (OperandSlot)slot));
+                if (v >= 0 && usesSlot(op, (OperandSlot)slot))
+                    use(v);
+            }
+        }
+    }
+
+    // slot of each variable, -1 for its own
+    std::vector<int> slots(count, -1);
+    std::vector<bool> taken;
+    for (int v : shared) {
+        if (fixed[v])
+            continue;
+        taken.assign(shared.size(), false);
+        for (int x : conflicts[v]) {
+            if (slots[x] >= 0)
+                taken[slots[x]] = true;
+        }
+        slots[v] = std::find(taken.begin(), taken.end(), false) - taken.begin();
+    }
+    Name func = tabName(codes.operand(0, SLOT_B).value);
+    tabLayoutFrame(func, slots);
+    return tabEnterFunction(func);
+}
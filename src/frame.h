@@ -0,0 +1,25 @@
+/**
+ * This module shares frame slots between local variables and temp
+ * vars of a function whose lifetimes don't overlap.
+ *
+ * Each variable and temp var has its own slot when the function is
+ * lowered, so a long function with many temp vars gets a big frame,
+ * and deep recursion runs out of stack early. Two variables conflict
+ * if one is live where the other is defined (a copy's source doesn't
+ * conflict with its destination); those not conflicting are given
+ * slots greedily in order of definition, the first slot free of
+ * their conflicts. Parameters keep their slots, the caller stores
+ * them, and so do variables read before they are ever written.
+ */
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include "midcode.h"
+
+/**
+ * Lay out the frame of the function in `codes` (FUNC to END) with
+ * slots shared, its scope must be in use. Return the frame size.
+ */
+int shareFrameSlots(const MidCodes &codes);
+
+#endif // FRAME_H_
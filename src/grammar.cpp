@@ -1,996 +1,1528 @@
-#include <iostream>     // cout
-#include <cstdio>       // printf
-#include <cassert>      // assert
-#include <sstream>      // stingstream
-#include "symbol.h"    
-#include "grammar.h"
-#include "table.h"
-#include "error.h"
-#include "common.h"
-#include "midcode.h"
-
-
-/**
- * This module does:
- *  1.syntax checking
- *  2.semantics checking
- *  3.mid-code generating
- */
-
-#define NU "     "
-
-static void pConstDefinitions(IdentScope scope);    // <常量说明>
-static void pConstDefinition(IdentScope scope);     // <常量定义>
-static void pLocalVariableDefinitions();      
-static void pGlobalVariableDefinitionItem(
-        DataType dtype, std::string identifier);
-static void pFunctionDefinition(const DataType &dtype, const std::string &id);
-static void pMainFunctionDefinition();
-static void pParametersList(const std::string &id); // 形参<参数表>
-static void pArgumentsList(const std::vector<DataType> &params);    // 实参<值参数表>
-static void pStatementsList();                      // 语句列
-static void pStatement();
-static void pIfElseStatement(); 
-static void pSwitchCaseStatement();
-static void pCaseItem(const std::string &switched_val, const DataType &dtype, 
-    const std::string &end_label);
-static void pDoWhileStatement();
-static void pPrintfStatement();
-static void pScanfStatement();
-static void pReturnStatement();
-static void pEmptyStatement();
-static void pAssignmentStatement(const std::string &id);
-static void pArrayRead(std::string &res, DataType &res_dtype,
-        const std::string &id, const TabEntry &entry);
-static void pArrayAssignmentStatement(const std::string &id);
-static void pNonVoidFunctionCall(std::string &res, DataType &res_dtype, 
-        const std::string &id, const TabEntry &entry);// <有返回值函数调用语句>
-static void pFunctionCallStatement(const std::string &id);
-static void pCondition();
-static void pExpression(std::string &res, DataType &res_dtype);
-static void pTerm(std::string &res, DataType &res_dtype);
-static void pFactor(std::string &res, DataType &res_dtype);
-static void pSignedInteger();
-
-
-// file-scope global varaibles
-static TabEntry current_function_tabEntry;     // for check return statement's type
-
-void pProgram()
-{
-    readSymbol();
-    pConstDefinitions(GLOBAL);
-    while (true) {
-        test(Symset({INTSY, CHARSY, VOIDSY}), Symset({}));
-        DataType dtype = (g_sym == INTSY ? DT_INT:
-                g_sym == CHARSY ? DT_CHAR : DT_VOID);
-        readSymbol();
-        if (g_sym == MAINSY) {
-            if (dtype != DT_VOID) {
-                error(ERR_WRONG_TYPE_OF_MAIN);
-            }
-            pMainFunctionDefinition();
-            // this loop ends only when we found main
-            // function's definitions
-            break;
-        }
-        test(Symset({IDENTSY}), Symset({INTSY, CHARSY, VOIDSY}));
-        if (g_sym != IDENTSY)
-            continue;
-        std::string id = g_id;
-        readSymbol();
-        test(Symset({COMMA, SEMICOLON, LBRACK, LBRACE, LPARENT}), Symset({}));
-        if (g_sym == COMMA || g_sym == SEMICOLON || g_sym == LBRACK) {
-            // must be variable definition
-            pGlobalVariableDefinitionItem(dtype, id);
-        } else {
-            // must be function definition
-            pFunctionDefinition(dtype, id);
-            tabClear(LOCAL);    // clear local symbol table
-        }
-    }
-    extraCodeChecking();
-}
-
-static void pFunctionDefinition(const DataType &dtype, const std::string &id)
-{
-    TabEntry entry = { GLOBAL, IT_FUNCTION, dtype, -1, -1 };
-    tabInsert(id, entry);
-    current_function_tabEntry = entry;
-    std::string t = (dtype == DT_INT ? "int" :
-            dtype == DT_CHAR ? "char" : "void");
-    genMidCode(FUNC, t, id, NONE);
-
-    if (g_sym == LPARENT) {
-        pParametersList(id);
-    }
-    test(Symset({LBRACE}), Symset({}));
-    readSymbol();
-    pConstDefinitions(LOCAL);
-    pLocalVariableDefinitions();
-    pStatementsList();
-    genMidCode(END, NONE, NONE, NONE);
-}
-
-/**
- * If we don't meet main function's definition in source code,
- * then a PROGRAM_INCOMPLETE error will terminate compiling
- */
-static void pMainFunctionDefinition()
-{
-    assert(g_sym == MAINSY);
-    TabEntry entry = { GLOBAL, IT_FUNCTION, DT_VOID, -1, -1 };
-    tabInsert("main", entry);
-    genMidCode(FUNC, "void", "main", NONE);
-
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    test3(Symset({RPARENT}));
-    readSymbol();
-    test3(Symset({LBRACE}));
-    readSymbol();
-    pConstDefinitions(LOCAL);
-    pLocalVariableDefinitions();
-    // process statements list
-    while (g_sym != RBRACE) {
-        pStatement();
-    }
-    assert(g_sym == RBRACE);
-    // NOTE: don't call readSymbol() here because 
-    // source program might have no more words
-    genMidCode(END, NONE, NONE, NONE);
-}
-
-static void pStatementsList()
-{
-    while (g_sym != RBRACE) {
-        pStatement();
-    }
-    readSymbol();
-}
-
-static void pStatement()
-{
-    std::string id;
-    switch (g_sym) {
-        case SEMICOLON: pEmptyStatement(); break;
-        case LBRACE:    readSymbol(); pStatementsList(); break;
-        case IFSY:      pIfElseStatement(); break;
-        case DOSY:      pDoWhileStatement(); break;
-        case SWITCHSY:  pSwitchCaseStatement(); break;
-        case PRINTFSY:  pPrintfStatement(); break;
-        case SCANFSY:   pScanfStatement(); break;
-        case RETURNSY:  pReturnStatement(); break;
-        case IDENTSY:
-            // must be function call statement or assignment statement
-            // should be determined from symbol table
-            id = g_id;
-            readSymbol();
-            switch (g_sym) {
-                case LBRACK:    pArrayAssignmentStatement(id); break;
-                case BECOMES:   pAssignmentStatement(id); break;
-                case LPARENT:   
-                case SEMICOLON: pFunctionCallStatement(id); break;
-                default:        error(ERR_WRONG_STATEMENT); break;
-            }
-            break;
-        default:
-            test(Symset({SEMICOLON, LBRACE, IFSY, DOSY, SWITCHSY,
-                PRINTFSY, SCANFSY, RETURNSY, IDENTSY}), Symset({}));
-            break;
-    }
-}
-
-static void pIfElseStatement()
-{
-    std::string if_label = genLabelIf();
-    std::string else_label = genLabelElse();
-    std::string end_label  = genLabelIfEnd();
-
-    assert(g_sym == IFSY);
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    pCondition();
-    test3(Symset({RPARENT}));
-    readSymbol();
-    // bz: brach if not satisfy
-    genMidCode(BZ, else_label, NONE, NONE);
-    // if body
-    genMidCode(LABEL, if_label, NONE, NONE);
-    pStatement();
-    genMidCode(GOTO, end_label, NONE, NONE);
-    test3(Symset({ELSESY}));
-    readSymbol();
-    // else body
-    genMidCode(LABEL, else_label, NONE, NONE);
-    pStatement();
-    genMidCode(LABEL, end_label, NONE, NONE);
-}
-
-/**
- * don't return value, because we will use $v0 register
- * to store result.
- */
-static void pCondition()
-{
-    std::string left_val, right_val;
-    DataType left_dtype, right_dtype;
-    pExpression(left_val, left_dtype);
-    if ( g_sym == EQL || g_sym == NEQ || g_sym == LSS ||
-         g_sym == LEQ || g_sym == GTR || g_sym == GEQ) {
-        std::string op = tokens[g_sym];
-        readSymbol();
-        pExpression(right_val, right_dtype);
-        if (left_dtype != right_dtype) {
-            error(ERR_COMPARE_TYPE_NOT_MATCH);
-        }
-        genMidCode(COMPARE, left_val, op, right_val);
-    } else {
-        // must be DT_INT
-        if (left_dtype != DT_INT) {
-            error(ERR_EXPECT_INT_TYPE_SINGLE_CONDITION);
-        }
-        genMidCode(COMPARE, left_val, NONE, NONE);
-    }
-}
-
-/**
- * TODO: check duplicate cased-values
- */
-static void pSwitchCaseStatement()
-{
-    std::string switched_val;
-    DataType switched_dtype;
-    std::string end_label = genLabel(); // switch end label
-
-    assert(g_sym == SWITCHSY);
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    pExpression(switched_val, switched_dtype);
-    test3(Symset({RPARENT}));
-    readSymbol();
-    test3(Symset({LBRACE}));
-    readSymbol(); // skip LBRACE
-    pushMidCodeCacheStack();
-    do {
-        pCaseItem(switched_val, switched_dtype, end_label);
-    } while (g_sym != RBRACE);
-    // flush cached mid code here
-    flushCachedMidCode();
-    genMidCode(LABEL, end_label, NONE, NONE);
-    readSymbol(); // skip RBRACE
-}
-
-static void pCaseItem(const std::string &switched_val, 
-        const DataType &switched_dtype,
-        const std::string &end_label)
-{
-    // TODO: default clause must be behind of case clause, 
-    // which is prescribed by C0 grammar rules.
-    // TODO: values in cases can't be equal
-    // TODO: might sort case item's and apply binary search
-    // to improve switch-case's performance.
-    std::string cased_val;
-    DataType cased_dtype;
-    std::string case_label = genLabel();
-
-    test3(Symset({CASESY, DEFAULTSY}));
-    if (g_sym == CASESY) {
-        readSymbol();
-        // cased-value must be int or char literal, can't be 
-        // const identifier
-        test3(Symset({CHARVALUE, MINUS, PLUS, INTVALUE}));
-        if (g_sym == CHARVALUE) {
-            std::stringstream ss;
-            ss << "\'" << g_char << "\'";
-            cased_val = ss.str();
-            cased_dtype = DT_CHAR;
-            readSymbol();
-        } else { // g_sym == INTVALUE
-            pSignedInteger();
-            cased_val = std::to_string(g_num);
-            cased_dtype = DT_INT;
-        }
-        if (switched_dtype != cased_dtype) {
-            error(ERR_SWITCH_TYPE_NOT_MATCH);
-            std::stringstream ss;
-            ss << "$witched=" << switched_val << "(" << dtype2str[switched_dtype]
-               << ") $cased=" << cased_val << "(" << dtype2str[cased_dtype]
-               << ")" << std::endl;
-            error(ss.str());
-            return;
-        }
-        test3(Symset({COLON}));
-        readSymbol();
-        case_label = genLabel();
-        // generate if...goto... without cache
-        // TODO: optimize switch, we don't have to load
-        // switched_val every time when compare 
-        genMidCode(COMPARE, switched_val, tokens[EQL], cased_val);
-        genMidCode(BNZ, case_label, NONE, NONE);
-        // generate labels and statements body in cache stack
-        startCachingMidCode();
-        genMidCode(LABEL, case_label, NONE, NONE); 
-        pStatement();
-        genMidCode(GOTO, end_label, NONE, NONE);
-        // stop cache
-        pauseCachingMidCode();
-
-    } else {
-        // default:
-        readSymbol();
-        test3(Symset({COLON}));
-        readSymbol();
-        // this label is not necessary, but it improves
-        // readability of generated mid code and final 
-        // mips code.
-        case_label = genLabel();
-        genMidCode(LABEL, case_label, NONE, NONE);
-        // no cache for default clause
-        pStatement();
-        genMidCode(GOTO, end_label, NONE, NONE);
-    }
-
-}
-
-static void pDoWhileStatement()
-{
-    std::string begin_label = genLabel();
-
-    assert(g_sym == DOSY);
-    readSymbol();
-    genMidCode(LABEL, begin_label, NONE, NONE);
-    pStatement();
-    test3(Symset({WHILESY}));
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    pCondition();
-    // BNZ: branch if satisfy
-    genMidCode(BNZ, begin_label, NONE, NONE);
-    test3(Symset({RPARENT}));
-    readSymbol();
-}
-
-static void pPrintfStatement()
-{
-    std::string arg1, arg2;
-    DataType temp_dtype;
-    std::stringstream ss;
-    assert(g_sym == PRINTFSY);
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    if (g_sym == STRVALUE) {
-        // insert string to strings table and get a
-        // label for this string.
-        arg1 = string2label(g_str);
-        genMidCode(WRITE, "str", arg1, NONE);
-        readSymbol();
-        if (g_sym == COMMA) {
-            readSymbol();
-            pExpression(arg2, temp_dtype);
-            std::string t = (temp_dtype == DT_INT ? "int" : "char");
-            genMidCode(WRITE, t, arg2, NONE);
-        }
-    } else {
-        pExpression(arg1, temp_dtype);
-        std::string t = (temp_dtype == DT_INT ? "int" : "char");
-        genMidCode(WRITE, t, arg1, NONE);
-    }
-    // break line for each printf
-    //std::string newline = string2label("\\n");
-    //genMidCode(WRITE, "str", newline, NONE);
-    test3(Symset({RPARENT}));
-    readSymbol();
-    test3(Symset({SEMICOLON}));
-    readSymbol();
-}
-
-static void pScanfStatement()
-{
-    TabEntry entry;
-
-    assert(g_sym == SCANFSY);
-    readSymbol();
-    test3(Symset({LPARENT}));
-    readSymbol();
-    int count = 0;
-    while (true) {
-        count++;
-        test3(Symset({IDENTSY}));
-        readSymbol();
-        if (!tabFind(g_id, entry)) {
-            error(ERR_UNDEFINED_IDENTIFIER);
-        } 
-        else if (entry.itype != IT_VARIABLE || (
-                 entry.dtype != DT_INT &&
-                 entry.dtype != DT_CHAR)) {
-            error(ERR_WRONG_TYPE_OF_SCANF);
-        }
-        genMidCode(READ, entry.dtype == DT_INT ? "int" : "char", g_id, NONE);
-        if (g_sym != COMMA) {
-            break;
-        }
-        readSymbol();
-    }
-    if (count == 0) {
-        error(ERR_SCANF_NO_ARGUMENTS);
-    }
-    test3(Symset({RPARENT}));
-    readSymbol();
-    test3(Symset({SEMICOLON}));
-    readSymbol();
-}
-
-static void pReturnStatement()
-{
-    std::string ret_val;
-    DataType ret_dtype;
-
-    assert(g_sym == RETURNSY);
-    readSymbol();
-    test3(Symset({LPARENT, SEMICOLON}));
-    if (g_sym == LPARENT) {
-        readSymbol();
-        pExpression(ret_val, ret_dtype);
-        genMidCode(RET, ret_val, NONE, NONE);
-        test3(Symset({RPARENT}));
-        readSymbol();
-    } else {
-        ret_dtype = DT_VOID;
-        genMidCode(RET, NONE, NONE, NONE);
-    }
-    if (ret_dtype != current_function_tabEntry.dtype) {
-        error(ERR_WRONG_RETURN_TYPE);
-    }
-    test3(Symset({SEMICOLON}));
-    readSymbol();
-}
-
-static void pEmptyStatement()
-{
-    assert(g_sym == SEMICOLON);
-    readSymbol();
-}
-
-static void pAssignmentStatement(const std::string &id)
-{
-    TabEntry entry;
-
-    assert(g_sym == BECOMES);
-    readSymbol();
-    if (!tabFind(id, entry)) {
-        error(ERR_UNDEFINED_IDENTIFIER);
-        return;
-    }
-    if (entry.itype != IT_VARIABLE) {
-        // entry.itype might be IT_ARRAY
-        error(ERR_LEFT_VALUE_NOT_VARIABLE);
-        return;
-    }
-    std::string rvalue;     // right value
-    DataType rvalue_dtype;  // right value's data type
-    pExpression(rvalue, rvalue_dtype);
-    if (rvalue_dtype != entry.dtype) {
-        error(ERR_TYPE_NOT_MATCH);
-        return;
-    }
-    genMidCode(ASSIGN, rvalue, NONE, id);
-    test3(Symset({ SEMICOLON }));
-    readSymbol();
-}
-
-static void pArrayAssignmentStatement(const std::string &id)
-{
-    TabEntry entry;
-
-    assert(g_sym == LBRACK);
-    if (!tabFind(id, entry)) {
-        error(ERR_UNDEFINED_IDENTIFIER);
-        return;
-    }
-    if (entry.itype != IT_ARRAY) {
-        error(ERR_NOT_AN_ARRAY);
-        return;
-    }
-    readSymbol(); // skip left bracket
-    // handle index
-    std::string index;    // index
-    DataType index_dtype; // index's data type
-    pExpression(index, index_dtype);
-    if (index_dtype != DT_INT) {
-        // array's index must be int type
-        error(ERR_EXPECT_INT_ARRAY_INDEX);
-    }
-    // overflow check for const indexes
-    int val;
-    if (isConstValue(index, val) &&
-        (val < 0 || val >= entry.value)) {
-        error(ERR_ARRAY_INDEX_OVERFLOW);
-    }
-    readSymbol(); // skip right bracket
-    test3(Symset({ BECOMES }));
-    readSymbol(); // skip = 
-    // handle right value
-    std::string rvalue;
-    DataType rvalue_dtype;
-    pExpression(rvalue, rvalue_dtype);
-    if (rvalue_dtype != entry.dtype) {
-        error(ERR_TYPE_NOT_MATCH);
-    }
-    // generate middle code
-    genMidCode(WARRAY, id, index, rvalue);
-    test3(Symset({ SEMICOLON }));
-    readSymbol();
-}
-
-static void pArrayRead(std::string &res, DataType &res_dtype,
-        const std::string &id, const TabEntry &entry)
-{
-    if (g_sym != LBRACK) {
-        error(ERR_EXPECT_ARRAY_ELEMENT);
-    }
-    test3(Symset({LBRACK}));
-    readSymbol();  // skip left bracket
-    // handle index
-    std::string index;    // index
-    DataType index_dtype; // index's data type
-    pExpression(index, index_dtype);
-    if (index_dtype != DT_INT) {
-        // array's index must be int type
-        error(ERR_EXPECT_INT_ARRAY_INDEX);
-    }
-    // overflow check for const indexes
-    int val;
-    if (isConstValue(index, val) &&
-        (val < 0 || val >= entry.value)) {
-        error(ERR_ARRAY_INDEX_OVERFLOW);
-    }
-    res = genTempVar();
-    res_dtype = entry.dtype;
-    genMidCode(TEMP, (res_dtype == DT_INT ? "int": "char"), res, NONE);
-    genMidCode(RARRAY, id, index, res);
-    test3(Symset({RBRACK}));
-    readSymbol();
-}
-
-/**
- * This function handles single function call statement,
- * regardless of void or non-void functions.
- */
-static void pFunctionCallStatement(const std::string &id)
-{
-    TabEntry entry;
-    if (!tabFind(id, entry)) {
-        error(ERR_UNDEFINED_IDENTIFIER);
-        return;
-    }
-    if (entry.itype != IT_FUNCTION) {
-        error(ERR_NOT_A_FUNCTION);
-        return;
-    }
-    const std::vector<DataType> &params = tabGetParams(id);
-    if (g_sym == LPARENT) {
-        pArgumentsList(params);
-    } else if (params.size() != 0) {
-        error(ERR_EXPECT_ARGUMENTS);
-        return;
-    }
-    genMidCode(CALL, id, std::to_string(params.size()), NONE);
-    // as we don't call about return value, so we don't 
-    // need to copy return value from $RET to some varaible
-    test2(Symset({SEMICOLON}), Symset({}));
-    readSymbol();
-}
-
-/**
- * Non-void function call is only used in <expression>.
- * Functions called in expressions must be non-void function.
- * :res         containing return value of function call
- * :res_dtype   containing value's data type
- * :id          current function's identifier 
- * :entry       symbol table entry of current function
- */
-static void pNonVoidFunctionCall(std::string &res, DataType &res_dtype, 
-        const std::string &id, const TabEntry &entry)
-{
-    assert(entry.itype == IT_FUNCTION);
-    if (entry.dtype == DT_VOID) {
-        error(ERR_EXPECT_NON_VOID_FUNCTION);
-        return;
-    }
-    const std::vector<DataType> &params = tabGetParams(id);
-
-    if (g_sym == LPARENT) {
-        pArgumentsList(params);
-    } else if (params.size() != 0) {
-        error(ERR_EXPECT_ARGUMENTS);
-        return;
-    }
-    genMidCode(CALL, id, std::to_string(params.size()), NONE);
-    // create a temp variable for holding return value
-    res = genTempVar(); 
-    res_dtype = entry.dtype;
-    genMidCode(TEMP, (res_dtype == DT_INT ? "int": "char"), res, NONE);
-    // return statement in non-void functions will always
-    // write return value to a fixed register $v0
-    // get return value from $t0 and save it to a temp variable
-    genMidCode(GETRET, NONE, NONE, res);
-}
-
-/**
- * pParametersList is used for function's definition
- * pArgumentsList is used for function call
- * id: function's identifier
- */
-static void pArgumentsList(const std::vector<DataType> &params)
-{
-    std::string temp_var;
-    DataType temp_dtype;
-    unsigned int args_count = 0;
-    std::vector<FourTuple> to_be_pushed;
-
-    assert(g_sym == LPARENT);
-    readSymbol();
-    while (true) {
-        pExpression(temp_var, temp_dtype);
-        if (++args_count > params.size()) {
-            error(ERR_MORE_ARGUMENTS);
-            return;
-        }
-        // check argument's data type
-        if (params[args_count - 1] != temp_dtype) {
-            error(ERR_WRONG_TYPE_OF_ARGUMENT);
-            return;
-        }
-        std::string type = (temp_dtype == DT_INT ? "int" : "char");
-        startCachingMidCode();
-        to_be_pushed.push_back(FourTuple({PUSH, type, temp_var, NONE}));
-        pauseCachingMidCode();
-        if (g_sym != COMMA) {
-            break;
-        }
-        readSymbol();
-    }
-    for (const auto &ft: to_be_pushed) {
-        genMidCode(ft.op, ft.a, ft.b, ft.res);
-    }
-    if (args_count < params.size()) {
-        error(ERR_LESS_ARGUMENTS);
-        return;
-    }
-    test3(Symset({RPARENT}));
-    readSymbol();
-}
-
-/**
- * pParametersList is used for function's definition
- * pArgumentsList is used for function call
- * id: function's identifier
- */
-static void pParametersList(const std::string &id)
-{
-    int count = 0;
-
-    assert(g_sym == LPARENT);
-    while (g_sym != RPARENT) { 
-        count++;
-
-        readSymbol(); // g_sym==COMMA or LPARENT
-        test2(Symset({INTSY, CHARSY}), Symset({RPARENT}));
-        DataType dtype = g_sym == INTSY ? DT_INT: DT_CHAR;
-
-        readSymbol(); // identifier
-        test2(Symset({IDENTSY}), Symset({RPARENT}));
-        TabEntry entry = { LOCAL, IT_VARIABLE, dtype, -1, -1 };
-        tabInsert(g_id, entry);
-        tabInsertParam(id, dtype);
-        genMidCode(PARA, dtype == DT_INT ? "int" : "char", g_id, NONE);
-
-        readSymbol();
-        test3(Symset({COMMA, RPARENT}));
-        if (g_sym != COMMA) 
-            break;
-    }
-    if (count == 0) {
-        error(ERR_MISSING_PARAMETERS);
-    }
-    readSymbol();
-}
-
-static void pGlobalVariableDefinitionItem(DataType dtype, std::string id) 
-{
-    if (dtype == DT_VOID) {
-        error(ERR_WRONG_VARIABLE_TYPE);
-    }
-    std::string type_str = (dtype == DT_INT ? "int": "char");
-    while (true) {
-        // g_sym always points to the one after identifier
-        if (g_sym == LBRACK) {       // array definition
-            readSymbol(); // skip left bracket
-            test3(Symset({INTVALUE}));
-            int array_size = g_num;
-            assert(g_num >= 0);
-            if (array_size == 0) {
-                error(ERR_ARRAY_SIZE_ZERO);
-            }
-            TabEntry entry = { GLOBAL, IT_ARRAY, dtype, array_size, -1 };
-            tabInsert(id, entry);
-            genMidCode(GVAR, type_str, id, std::to_string(array_size));
-            readSymbol(); // skip size number
-            test3(Symset({RBRACK}));
-            readSymbol(); 
-        } else {                    // normal variable definition
-            TabEntry entry = { GLOBAL, IT_VARIABLE, dtype, -1, -1 };
-            tabInsert(id, entry);
-            genMidCode(GVAR, type_str, id, NONE);
-        }
-        if (g_sym != COMMA) {
-            break;
-        }
-        readSymbol();
-        test3(Symset({IDENTSY}));
-        id = g_id;
-        readSymbol();
-    }
-    test3(Symset({SEMICOLON}));
-    readSymbol();
-}
-
-static void pLocalVariableDefinitions()
-{
-    while (g_sym == INTSY || g_sym == CHARSY) {
-        DataType dtype = (g_sym == INTSY ? DT_INT : DT_CHAR);
-        std::string type_str = (dtype == DT_INT ? "int" : "char");
-        while (true) {
-            // g_sym always points to the one before idnetifier
-            readSymbol(); // skip comma or INTSY or CHARSY
-            test3(Symset({IDENTSY}));
-            std::string id = g_id;
-            readSymbol(); // skip identifier
-            if (g_sym == LBRACK) {      // array definition
-                readSymbol(); // skip left bracket
-                test3(Symset({INTVALUE}));
-                int array_size = g_num;
-                TabEntry entry = { LOCAL, IT_ARRAY, dtype, array_size, -1 };
-                tabInsert(id, entry);
-                genMidCode(VAR, type_str, id, std::to_string(array_size));
-                readSymbol(); // skip size number
-                test3(Symset({RBRACK}));
-                readSymbol();
-            } else {                    // normal variable definition
-                TabEntry entry = { LOCAL, IT_VARIABLE, dtype, -1, -1 };
-                tabInsert(id, entry);
-                genMidCode(VAR, type_str, id, NONE);
-            }
-            if (g_sym != COMMA) {
-                break;
-            }
-        }
-        test3(Symset({SEMICOLON}));
-        readSymbol();
-    }
-}
-
-/* process one const definition */
-static void pConstDefinition(IdentScope scope)
-{
-    assert(g_sym == CONSTSY);
-    readSymbol();
-    test3(Symset({INTSY, CHARSY}));
-    DataType dtype = g_sym == INTSY ? DT_INT : DT_CHAR;
-    TabEntry entry;
-    while (true) {
-        readSymbol(); // skip INTSY, CHARSY or COMMA
-        test3(Symset({IDENTSY}));
-        std::string id = g_id;
-        readSymbol();
-        test3(Symset({BECOMES}));
-        readSymbol();
-        if (dtype == DT_INT) {
-            pSignedInteger();
-            entry = { scope, IT_CONST, DT_INT, g_num, -1 };
-        } else { // DT_CHAR
-            test3(Symset({CHARVALUE}));
-            entry = { scope, IT_CONST, DT_CHAR, g_char, -1 };
-            readSymbol();
-        }
-        tabInsert(id, entry);
-        if (g_sym != COMMA) {
-            break;
-        }
-    }
-    test(Symset({SEMICOLON}), Symset({SEMICOLON, RBRACE, CONSTSY}));
-    if (g_sym == CONSTSY)
-        return;
-    test3(Symset({SEMICOLON}));
-    readSymbol();
-}
-
-static void pConstDefinitions(IdentScope scope)
-{
-    // g_sym always points to the first word after semicolon
-    while (g_sym == CONSTSY) {
-        pConstDefinition(scope);
-    }
-}
-
-
-/**
- * Process signed integer
- *
- * g_num is an unsigned integer read in by readSymbol()
- * there might be '+' or '-' in front of it.
- * if so, we combile they together and get a singed integer
- * literal. Store it back to g_num
- */
-static void pSignedInteger() 
-{
-    int negtive = 1;
-    if (g_sym == PLUS || g_sym == MINUS) {
-        negtive = g_sym == MINUS ? -1 : 1;
-        readSymbol();
-    }
-    test3(Symset({INTVALUE}));
-    g_num *= negtive;
-    readSymbol();
-}
-
-/**
- * res and res_dtype is used to return
- * code became so ugly because we need to 
- */
-static void pExpression(std::string &res, DataType &res_dtype)
-{
-    std::string temp_var;
-    DataType temp_dtype;
-    if (g_sym == PLUS || g_sym == MINUS) {
-        bool isMinus = (g_sym == MINUS);
-        readSymbol();
-        if (isMinus) {
-            pTerm(temp_var, temp_dtype); // no use of tempvar_dtype
-            int val;
-            if (isConstValue(temp_var, val)) {
-                res = std::to_string(-val);
-                res_dtype = DT_INT;
-            } else {
-                res = genTempVar();
-                res_dtype = DT_INT;
-                genMidCode(TEMP, "int", res, NONE);
-                genMidCode(SUB, "0", temp_var, res);
-            }
-        } else {
-            // no need to generate code for '+'
-            pTerm(res, res_dtype);
-            int t;
-            if (isConstValue(res, t)) {
-                res = std::to_string(t);
-            }
-            res_dtype = DT_INT;
-        }
-    } else {
-        pTerm(res, res_dtype);
-    }
-    while (g_sym == PLUS || g_sym == MINUS) {
-        OpCode op = (g_sym == PLUS ? ADD : SUB);
-        readSymbol();
-        pTerm(temp_var, temp_dtype); // no use of tempvar_dtype
-        int t1, t2;
-        if (isConstValue(res, t1) && isConstValue(temp_var, t2)) {
-            // if both operands ares const value, we can calculate it
-            res = std::to_string( op == ADD ? t1 + t2 : t1 - t2 );
-            res_dtype = DT_INT;
-        }
-        else {
-            std::string new_res = genTempVar();
-            genMidCode(TEMP, "int", new_res, NONE);
-            genMidCode(op, res, temp_var, new_res);
-            res = new_res;
-            res_dtype = DT_INT;
-        }
-    }
-}
-
-/* Note that res and res_dtype are reference */
-static void pTerm(std::string &res, DataType &res_dtype)
-{
-    std::string temp_var;
-    DataType temp_dtype;
-    pFactor(res, res_dtype);
-    while (g_sym == STAR || g_sym == SLASH) {
-        OpCode op = (g_sym == STAR ? MUL : DIV);
-        readSymbol();
-        pFactor(temp_var, temp_dtype);
-        int t1, t2;
-        if (isConstValue(res, t1) && isConstValue(temp_var, t2)) {
-            res = std::to_string( op == MUL ? t1 * t2 : t1 / t2 );
-            res_dtype = DT_INT;
-        }
-        else {
-            std::string new_res = genTempVar();
-            genMidCode(TEMP, "int", new_res, NONE);
-            genMidCode(op, res, temp_var, new_res);
-            res = new_res;
-            res_dtype = DT_INT;
-        }
-    }
-}
-
-/* Note that res and res_dtype are reference */
-static void pFactor(std::string &res, DataType &res_dtype)
-{
-    std::string id, temp_var;
-    std::stringstream ss;
-    TabEntry entry;
-    DataType temp_dtype;
-    // For conveniency, we assume all identifiers here are non-void-function-call
-    test3(Symset({IDENTSY, CHARVALUE, LPARENT, PLUS, MINUS, INTVALUE}));
-    switch (g_sym) {
-        case IDENTSY:   id = g_id;
-                        readSymbol(); 
-                        if (!tabFind(id, entry)) {
-                            // undefined identifier
-                            error(ERR_UNDEFINED_IDENTIFIER);
-                            return;
-                        }
-                        // entry.itype might be:
-                        // IT_FUNCTION, IT_ARRAY, IT_VARIABLE, IT_CONST
-
-                        // 1. handle functions
-                        if (entry.itype == IT_FUNCTION) {
-                            pNonVoidFunctionCall(res, res_dtype, id, entry);
-                            return;
-                        } else if (g_sym == LPARENT) { 
-                            // use function call on a not-a-function identifier
-                            error(ERR_NOT_A_FUNCTION);
-                            return;
-                        }
-                        // 2. handle arrays
-                        if (entry.itype == IT_ARRAY) {
-                            pArrayRead(res, res_dtype, id, entry);
-                            return;
-                        }
-                        assert(entry.itype == IT_CONST || entry.itype == IT_VARIABLE);
-                        assert(entry.dtype == DT_CHAR || entry.dtype == DT_INT);
-                        // 3. handle consts variable
-                        if (entry.itype == IT_CONST) {
-                            // return consts' character directly
-                            if (entry.dtype == DT_CHAR) {
-                                res_dtype = DT_CHAR;
-                                ss << '\'' << (char)entry.value << '\'';
-                            } else {
-                                res_dtype = DT_INT;
-                                ss << entry.value;
-                            }
-                            res = ss.str();
-                        } 
-                        // 4. handle normal variable (int or char)
-                        else {
-                            // return identifier directly
-                            res = id;
-                            res_dtype = entry.dtype;
-                        }
-                        break;
-        case CHARVALUE: readSymbol();
-                        ss << '\'' << g_char << '\'';
-                        res = ss.str();
-                        res_dtype = DT_CHAR;
-                        break;
-        case LPARENT:   readSymbol();
-                        pExpression(res, temp_dtype);
-                        res_dtype = DT_INT;           // ('p') should be convert to int
-                        test3(Symset({RPARENT}));
-                        readSymbol();
-                        break;
-        default:        pSignedInteger();  // a signed integer is stored at g_num
-                        ss << g_num;
-                        res = ss.str();
-                        res_dtype = DT_INT;
-                        break;
-    }
-}
-
+#include <iostream>     // cout
+#include <cstdio>       // printf
+#include <cassert>      // assert
+#include <sstream>      // stingstream
+#include <algorithm>    // lower_bound
+#include "symbol.h"
+#include "grammar.h"
+#include "table.h"
+#include "error.h"
+#include "common.h"
+#include "midcode.h"
+#include "ast.h"
+
+
+/**
+ * This module does:
+ *  1.syntax checking
+ *  2.semantics checking
+ *  3.abstract syntax tree building(mid-code is generated from it)
+ */
+
+#define NU "     "
+
+static void pConstDefinitions(IdentScope scope);    // <常量说明>
+static void pConstDefinition(IdentScope scope);     // <常量定义>
+static void pLocalVariableDefinitions(Decl *&vars);
+static void pGlobalVariableDefinitionItem(Decl **&tail,
+        DataType dtype, Name identifier);
+static void pFunctionDefinition(FunctionDecl *&res,
+        const DataType &dtype, Name id);
+static void pMainFunctionDefinition(FunctionDecl *&res);
+static void pParametersList(Decl *&params, Name id); // 形参<参数表>
+static void pArgumentsList(CallExpr *call,
+        const std::vector<DataType> &params);       // 实参<值参数表>
+static void pStatementsList(Stmt *&stmts, bool read_rbrace); // 语句列
+static void pPrintfStatement(Stmt *&res);
+static void pScanfStatement(Stmt *&res);
+static void pReturnStatement(Stmt *&res);
+static void pEmptyStatement();
+static void pAssignmentStatement(Stmt *&res, Name id);
+static void pArrayAssignmentStatement(Stmt *&res, Name id);
+static void pFunctionCallStatement(Stmt *&res, Name id);
+static void pCondition(Condition &cond);
+static void pExpression(Expr *&res);
+static void pSignedInteger();
+static Expr *binaryExpr(OpCode op, Expr *left, Expr *right);
+static Operand charLiteral(char c);
+static Program *pProgramSkipping(const std::vector<BodyBraces> *bodies);
+static bool pDefinition(Decl **&tail);
+static bool skipBody(bool read_next);
+static void insertFunction(Name id, const TabEntry &entry);
+static void endFunctionSpan();
+static void clearStacks();
+
+
+// file-scope global varaibles, functions may be parsed on several threads
+static thread_local TabEntry current_function_tabEntry; // for check return statement's type
+static std::vector<FunctionSpan> function_spans;
+static thread_local bool reparsing = false; // in pFunctionAgain(), global table is read only
+static const std::vector<BodyBraces> *skipped_bodies = NULL;   // see pProgramHeaders()
+
+/**
+ * Symbol sets for test(), as named constants they are built at
+ * compile time even without optimization, so a check costs a
+ * single AND.
+ */
+// FIRST sets
+static constexpr Symset FIRST_DEFINITION(INTSY, CHARSY, VOIDSY);
+static constexpr Symset FIRST_TYPE_IDENTIFIER(INTSY, CHARSY);  // <类型标识符>
+static constexpr Symset FIRST_STATEMENT(SEMICOLON, LBRACE, IFSY, DOSY,
+        SWITCHSY, PRINTFSY, SCANFSY, RETURNSY, IDENTSY);
+static constexpr Symset FIRST_CASE_ITEM(CASESY, DEFAULTSY);
+static constexpr Symset FIRST_CONSTANT(CHARVALUE, MINUS, PLUS, INTVALUE);
+static constexpr Symset FIRST_FACTOR(IDENTSY, CHARVALUE, LPARENT,
+        PLUS, MINUS, INTVALUE);
+// FOLLOW sets
+static constexpr Symset FOLLOW_DEFINITION_IDENTIFIER(COMMA, SEMICOLON,
+        LBRACK, LBRACE, LPARENT);
+static constexpr Symset FOLLOW_RETURN(LPARENT, SEMICOLON);
+static constexpr Symset FOLLOW_PARAMETER(COMMA, RPARENT);
+static constexpr Symset FOLLOW_CONST_DEFINITION(SEMICOLON, RBRACE, CONSTSY);
+// single symbols
+static constexpr Symset ONLY_IDENTSY(IDENTSY);
+static constexpr Symset ONLY_CHARVALUE(CHARVALUE);
+static constexpr Symset ONLY_INTVALUE(INTVALUE);
+static constexpr Symset ONLY_ELSESY(ELSESY);
+static constexpr Symset ONLY_WHILESY(WHILESY);
+static constexpr Symset ONLY_LPARENT(LPARENT);
+static constexpr Symset ONLY_RPARENT(RPARENT);
+static constexpr Symset ONLY_LBRACK(LBRACK);
+static constexpr Symset ONLY_RBRACK(RBRACK);
+static constexpr Symset ONLY_LBRACE(LBRACE);
+static constexpr Symset ONLY_BECOMES(BECOMES);
+static constexpr Symset ONLY_COLON(COLON);
+static constexpr Symset ONLY_SEMICOLON(SEMICOLON);
+// skip() stops only at symbols in the first set
+static constexpr Symset NO_SYMBOLS;
+
+
+/**
+ * Helpers for building syntax tree, nodes are
+ * allocated from `ast_arena` with all fields zeroed.
+ */
+template <typename T>
+static T *newNode()
+{
+    return ast_arena.make<T>();
+}
+
+template <typename T>
+static T *newStmt(StmtKind kind)
+{
+    T *t = newNode<T>();
+    t->kind = kind;
+    return t;
+}
+
+template <typename T>
+static T *newExpr(ExprKind kind, DataType dtype, Operand res)
+{
+    T *t = newNode<T>();
+    t->kind = kind;
+    t->dtype = dtype;
+    t->res = res;
+    return t;
+}
+
+template <typename T>
+static T *newDecl(DeclKind kind)
+{
+    T *t = newNode<T>();
+    t->kind = kind;
+    return t;
+}
+
+/* append `node` to a list, `tail` points to `next` of the last node */
+template <typename T, typename U>
+static void append(T **&tail, U *node)
+{
+    if (node == NULL)
+        return;
+    *tail = node;
+    tail = &node->next;
+}
+
+
+Program *pProgram()
+{
+    return pProgramSkipping(NULL);
+}
+
+Program *pProgramHeaders(const std::vector<BodyBraces> &bodies)
+{
+    // a body not in `bodies` stops compiling, see skipBody()
+    assert(serverMode());
+    return pProgramSkipping(&bodies);
+}
+
+static Program *pProgramSkipping(const std::vector<BodyBraces> *bodies)
+{
+    skipped_bodies = bodies;
+    Program *program = newNode<Program>();
+    Decl **tail = &program->decls;
+    function_spans.clear();
+    reparsing = false;
+    tabLimitGlobals(TAB_NO_LIMIT);
+    clearStacks();
+    readSymbol();
+    pConstDefinitions(GLOBAL);
+    // this loop ends only when we found main
+    // function's definitions
+    while (!pDefinition(tail))
+        ;
+    extraCodeChecking();
+    skipped_bodies = NULL;
+    return program;
+}
+
+const std::vector<FunctionSpan> &functionSpans()
+{
+    return function_spans;
+}
+
+Decl *pFunctionAgain(const FunctionSpan &span)
+{
+    Decl *decls = NULL;
+    Decl **tail = &decls;
+    clearStacks();
+    tabClear(LOCAL);
+    tabLimitGlobals(span.stamp);
+    setNameCounters(span.counters);
+    reparsing = true;
+    skipped_bodies = NULL;
+    seekSource(span.line_no, span.word_pos);
+    readSymbol();
+    pDefinition(tail);
+    reparsing = false;
+    tabLimitGlobals(TAB_NO_LIMIT);
+    return decls;
+}
+
+/**
+ * Process a global variable definition or a function definition,
+ * return true if it's main function.
+ */
+static bool pDefinition(Decl **&tail)
+{
+    test(FIRST_DEFINITION, NO_SYMBOLS);
+    FunctionSpan span = { g_line_no, g_word_pos, 0, 0, 0, false, false,
+        nameCounters(), NameCounters() };
+    DataType dtype = (g_sym == INTSY ? DT_INT:
+            g_sym == CHARSY ? DT_CHAR : DT_VOID);
+    readSymbol();
+    if (g_sym == MAINSY) {
+        if (dtype != DT_VOID) {
+            error(ERR_WRONG_TYPE_OF_MAIN);
+        }
+        span.is_main = true;
+        if (!reparsing)
+            function_spans.push_back(span);
+        FunctionDecl *func = NULL;
+        pMainFunctionDefinition(func);
+        func->scope = tabSaveScope(ast_arena);
+        append(tail, func);
+        endFunctionSpan();
+        return true;
+    }
+    test(ONLY_IDENTSY, FIRST_DEFINITION);
+    if (g_sym != IDENTSY)
+        return false;
+    Name id = g_id;
+    readSymbol();
+    test(FOLLOW_DEFINITION_IDENTIFIER, NO_SYMBOLS);
+    if (g_sym == COMMA || g_sym == SEMICOLON || g_sym == LBRACK) {
+        // must be variable definition
+        pGlobalVariableDefinitionItem(tail, dtype, id);
+    } else {
+        // must be function definition
+        if (!reparsing)
+            function_spans.push_back(span);
+        FunctionDecl *func = NULL;
+        pFunctionDefinition(func, dtype, id);
+        // local symbol table is cleared, and kept for lowering
+        func->scope = tabSaveScope(ast_arena);
+        append(tail, func);
+        endFunctionSpan();
+    }
+    return false;
+}
+
+/* insert a function to global table, and record it in its span */
+static void insertFunction(Name id, const TabEntry &entry)
+{
+    if (reparsing)
+        return;
+    FunctionSpan &span = function_spans.back();
+    span.inserted = (tabInsert(id, entry) != TAB_NONE);
+    span.stamp = tabGlobalStamp();
+}
+
+/**
+ * In pProgramHeaders(), skip the function body from '{' to the
+ * matching '}', and read the word after '}' if `read_next`.
+ */
+static bool skipBody(bool read_next)
+{
+    if (skipped_bodies == NULL || g_sym != LBRACE)
+        return false;
+    BodyBraces key = { g_line_no, g_word_pos, 0, 0 };
+    auto found = std::lower_bound(skipped_bodies->begin(),
+            skipped_bodies->end(), key,
+            [](const BodyBraces &a, const BodyBraces &b) {
+                return a.line_no < b.line_no ||
+                    (a.line_no == b.line_no && a.pos < b.pos);
+            });
+    if (found == skipped_bodies->end() || found->line_no != g_line_no ||
+            found->pos != g_word_pos) {
+        // braces are not matched as the pre-scan did, which
+        // happens only with errors, let the caller start over
+        stopCompiling();
+    }
+    seekSource(found->end_line_no, found->end_pos);
+    readSymbol();
+    assert(g_sym == RBRACE);
+    if (read_next)
+        readSymbol();
+    return true;
+}
+
+static void endFunctionSpan()
+{
+    if (reparsing)
+        return;
+    function_spans.back().end_line_no = g_line_no;
+    function_spans.back().end_word_pos = g_word_pos;
+    function_spans.back().end_counters = nameCounters();
+}
+
+static void pFunctionDefinition(FunctionDecl *&res,
+        const DataType &dtype, Name id)
+{
+    TabEntry entry = { GLOBAL, IT_FUNCTION, dtype, -1, -1 };
+    insertFunction(id, entry);
+    current_function_tabEntry = entry;
+    res = newDecl<FunctionDecl>(DECL_FUNCTION);
+    res->type = dtype;
+    res->id = varOperand(tabLookup(id));
+    res->first_temp = nameCounters().temps;
+
+    if (g_sym == LPARENT) {
+        pParametersList(res->params, id);
+    }
+    test(ONLY_LBRACE, NO_SYMBOLS);
+    if (skipBody(true))
+        return;
+    readSymbol();
+    pConstDefinitions(LOCAL);
+    pLocalVariableDefinitions(res->vars);
+    pStatementsList(res->body, true);
+}
+
+/**
+ * If we don't meet main function's definition in source code,
+ * then a PROGRAM_INCOMPLETE error will terminate compiling
+ */
+static void pMainFunctionDefinition(FunctionDecl *&res)
+{
+    assert(g_sym == MAINSY);
+    TabEntry entry = { GLOBAL, IT_FUNCTION, DT_VOID, -1, -1 };
+    insertFunction(NAME_MAIN, entry);
+    // return statements of main are checked against this, not
+    // the function before it
+    current_function_tabEntry = entry;
+    res = newDecl<FunctionDecl>(DECL_FUNCTION);
+    res->type = DT_VOID;
+    res->id = varOperand(tabLookup(NAME_MAIN));
+    res->first_temp = nameCounters().temps;
+
+    readSymbol();
+    test3(ONLY_LPARENT);
+    readSymbol();
+    test3(ONLY_RPARENT);
+    readSymbol();
+    test3(ONLY_LBRACE);
+    if (skipBody(false))
+        return;
+    readSymbol();
+    pConstDefinitions(LOCAL);
+    pLocalVariableDefinitions(res->vars);
+    // NOTE: don't read the word after '}' because
+    // source program might have no more words
+    pStatementsList(res->body, false);
+}
+
+/**
+ * Statements are parsed with an explicit stack instead of recursion,
+ * so nesting of blocks, if-else, do-while and switch-case is bounded
+ * only by heap memory. A compound statement pushes a frame while its
+ * sub-statements are parsed. Where recursive descent would `return`
+ * on an error (test3), the frame ends and its statement is done.
+ */
+enum StmtFrameKind {
+    FRAME_LIST,         // <语句列> of a block or function body
+    FRAME_IF,           // then or else body
+    FRAME_DO_WHILE,     // loop body
+    FRAME_SWITCH,       // body of a case item
+};
+
+struct StmtFrame {
+    StmtFrameKind   kind;
+    Stmt           *stmt;       // statement of this frame, NULL for function body
+    Stmt          **tail;       // FRAME_LIST: where the next statement goes
+    bool            read_rbrace;// FRAME_LIST: read the word after '}'
+    bool            in_else;    // FRAME_IF: parsing else body
+    CaseItem      **items_tail; // FRAME_SWITCH
+    CaseItem       *item;       // FRAME_SWITCH: item whose body is parsed
+};
+
+/* what statement parser does next */
+enum StmtAction {
+    NEXT_STATEMENT,     // continue <语句列> on top
+    BEGIN_STATEMENT,    // <语句>
+    END_STATEMENT,      // give `res` to frame on top
+    BEGIN_CASE,         // <情况子语句> or <缺省>
+    NEXT_CASE,          // a case item of switch on top is done
+};
+
+static thread_local std::vector<StmtFrame> stmt_stack;
+
+static StmtFrame &pushStmtFrame(StmtFrameKind kind, Stmt *stmt)
+{
+    StmtFrame f = StmtFrame();
+    f.kind = kind;
+    f.stmt = stmt;
+    stmt_stack.push_back(f);
+    return stmt_stack.back();
+}
+
+static StmtAction nextStatement(Stmt *&res);
+static StmtAction pStatement(Stmt *&res);
+static StmtAction endStatement(Stmt *&res);
+static StmtAction pIfElseStatement(Stmt *&res);
+static StmtAction pDoWhileStatement(Stmt *&res);
+static StmtAction pSwitchCaseStatement(Stmt *&res);
+static StmtAction pCaseItem(Stmt *&res);
+static StmtAction nextCaseItem(Stmt *&res);
+
+/**
+ * Process statements until '}' of the current block.
+ * :read_rbrace     whether to read the word after '}'
+ */
+static void pStatementsList(Stmt *&stmts, bool read_rbrace)
+{
+    assert(stmt_stack.empty());
+    StmtFrame &list = pushStmtFrame(FRAME_LIST, NULL);
+    list.tail = &stmts;
+    list.read_rbrace = read_rbrace;
+
+    Stmt *res = NULL;
+    StmtAction action = NEXT_STATEMENT;
+    do {
+        switch (action) {
+            case NEXT_STATEMENT:    action = nextStatement(res); break;
+            case BEGIN_STATEMENT:   action = pStatement(res); break;
+            case END_STATEMENT:     action = endStatement(res); break;
+            case BEGIN_CASE:        action = pCaseItem(res); break;
+            case NEXT_CASE:         action = nextCaseItem(res); break;
+        }
+    } while (!stmt_stack.empty());
+}
+
+static StmtAction nextStatement(Stmt *&res)
+{
+    StmtFrame &f = stmt_stack.back();
+    assert(f.kind == FRAME_LIST);
+    if (g_sym != RBRACE) {
+        return BEGIN_STATEMENT;
+    }
+    if (f.read_rbrace) {
+        readSymbol();
+    }
+    res = f.stmt;
+    stmt_stack.pop_back();
+    return END_STATEMENT;
+}
+
+/* `res` is NULL for empty statement or statement with errors */
+static StmtAction pStatement(Stmt *&res)
+{
+    Name id;
+    res = NULL;
+    switch (g_sym) {
+        case SEMICOLON: pEmptyStatement(); break;
+        case LBRACE: {
+            BlockStmt *t = newStmt<BlockStmt>(STMT_BLOCK);
+            readSymbol();
+            StmtFrame &f = pushStmtFrame(FRAME_LIST, t);
+            f.tail = &t->body;
+            f.read_rbrace = true;
+            return NEXT_STATEMENT;
+        }
+        case IFSY:      return pIfElseStatement(res);
+        case DOSY:      return pDoWhileStatement(res);
+        case SWITCHSY:  return pSwitchCaseStatement(res);
+        case PRINTFSY:  pPrintfStatement(res); break;
+        case SCANFSY:   pScanfStatement(res); break;
+        case RETURNSY:  pReturnStatement(res); break;
+        case IDENTSY:
+            // must be function call statement or assignment statement
+            // should be determined from symbol table
+            id = g_id;
+            readSymbol();
+            switch (g_sym) {
+                case LBRACK:    pArrayAssignmentStatement(res, id); break;
+                case BECOMES:   pAssignmentStatement(res, id); break;
+                case LPARENT:
+                case SEMICOLON: pFunctionCallStatement(res, id); break;
+                default:        error(ERR_WRONG_STATEMENT); break;
+            }
+            break;
+        default:
+            test(FIRST_STATEMENT, NO_SYMBOLS);
+            break;
+    }
+    return END_STATEMENT;
+}
+
+/* sub-statement `res` of the frame on top is done */
+static StmtAction endStatement(Stmt *&res)
+{
+    StmtFrame &f = stmt_stack.back();
+    switch (f.kind) {
+        case FRAME_LIST:
+            append(f.tail, res);
+            return NEXT_STATEMENT;
+        case FRAME_IF: {
+            IfStmt *t = static_cast<IfStmt *>(f.stmt);
+            if (f.in_else) {
+                t->else_body = res;
+                break;
+            }
+            t->then_body = res;
+            if (test3Failed(ONLY_ELSESY))
+                break;
+            readSymbol();
+            // else body
+            f.in_else = true;
+            return BEGIN_STATEMENT;
+        }
+        case FRAME_DO_WHILE: {
+            DoWhileStmt *t = static_cast<DoWhileStmt *>(f.stmt);
+            t->body = res;
+            if (test3Failed(ONLY_WHILESY))
+                break;
+            readSymbol();
+            if (test3Failed(ONLY_LPARENT))
+                break;
+            readSymbol();
+            pCondition(t->cond);
+            if (test3Failed(ONLY_RPARENT))
+                break;
+            readSymbol();
+            break;
+        }
+        case FRAME_SWITCH:
+            f.item->body = res;
+            return NEXT_CASE;
+    }
+    res = f.stmt;
+    stmt_stack.pop_back();
+    return END_STATEMENT;
+}
+
+static StmtAction pIfElseStatement(Stmt *&res)
+{
+    IfStmt *t = newStmt<IfStmt>(STMT_IF);
+    res = t;
+    t->if_label = genLabelIf();
+    t->else_label = genLabelElse();
+    t->end_label  = genLabelIfEnd();
+
+    assert(g_sym == IFSY);
+    readSymbol();
+    if (test3Failed(ONLY_LPARENT))
+        return END_STATEMENT;
+    readSymbol();
+    pCondition(t->cond);
+    if (test3Failed(ONLY_RPARENT))
+        return END_STATEMENT;
+    readSymbol();
+    // if body, else body follows in endStatement()
+    pushStmtFrame(FRAME_IF, t);
+    return BEGIN_STATEMENT;
+}
+
+/**
+ * don't return value, because we will use $v0 register
+ * to store result.
+ */
+static void pCondition(Condition &cond)
+{
+    pExpression(cond.left);
+    if ( g_sym == EQL || g_sym == NEQ || g_sym == LSS ||
+         g_sym == LEQ || g_sym == GTR || g_sym == GEQ) {
+        cond.op = relOperand((Relation)(g_sym - EQL));
+        readSymbol();
+        pExpression(cond.right);
+        if (cond.left->dtype != cond.right->dtype) {
+            error(ERR_COMPARE_TYPE_NOT_MATCH);
+        }
+    } else {
+        cond.op = NONE;
+        // must be DT_INT
+        if (cond.left->dtype != DT_INT) {
+            error(ERR_EXPECT_INT_TYPE_SINGLE_CONDITION);
+        }
+    }
+}
+
+/**
+ * TODO: check duplicate cased-values
+ */
+static StmtAction pSwitchCaseStatement(Stmt *&res)
+{
+    SwitchStmt *t = newStmt<SwitchStmt>(STMT_SWITCH);
+    res = t;
+    t->end_label = genLabel(); // switch end label
+
+    assert(g_sym == SWITCHSY);
+    readSymbol();
+    if (test3Failed(ONLY_LPARENT))
+        return END_STATEMENT;
+    readSymbol();
+    pExpression(t->value);
+    if (test3Failed(ONLY_RPARENT))
+        return END_STATEMENT;
+    readSymbol();
+    if (test3Failed(ONLY_LBRACE))
+        return END_STATEMENT;
+    readSymbol(); // skip LBRACE
+    StmtFrame &f = pushStmtFrame(FRAME_SWITCH, t);
+    f.items_tail = &t->items;
+    return BEGIN_CASE;
+}
+
+static StmtAction pCaseItem(Stmt *&res)
+{
+    // TODO: default clause must be behind of case clause,
+    // which is prescribed by C0 grammar rules.
+    // TODO: values in cases can't be equal
+    // TODO: might sort case item's and apply binary search
+    // to improve switch-case's performance.
+    StmtFrame &f = stmt_stack.back();
+    const Expr *switched = static_cast<SwitchStmt *>(f.stmt)->value;
+    Operand cased_val;
+    DataType cased_dtype;
+    Operand case_label = genLabel();
+    CaseItem *item;
+
+    res = NULL;
+    if (test3Failed(FIRST_CASE_ITEM))
+        return NEXT_CASE;
+    if (g_sym == CASESY) {
+        readSymbol();
+        // cased-value must be int or char literal, can't be
+        // const identifier
+        if (test3Failed(FIRST_CONSTANT))
+            return NEXT_CASE;
+        if (g_sym == CHARVALUE) {
+            cased_val = charLiteral(g_char);
+            cased_dtype = DT_CHAR;
+            readSymbol();
+        } else { // g_sym == INTVALUE
+            pSignedInteger();
+            cased_val = intOperand(g_num);
+            cased_dtype = DT_INT;
+        }
+        if (switched->dtype != cased_dtype) {
+            error(ERR_SWITCH_TYPE_NOT_MATCH);
+            std::stringstream ss;
+            ss << "$witched=" << switched->res << "(" << dtype2str[switched->dtype]
+               << ") $cased=" << cased_val << "(" << dtype2str[cased_dtype]
+               << ")" << std::endl;
+            error(ss.str());
+            return NEXT_CASE;
+        }
+        if (test3Failed(ONLY_COLON))
+            return NEXT_CASE;
+        readSymbol();
+        case_label = genLabel();
+        // the comparison is generated before all case bodies
+        // TODO: optimize switch, we don't have to load
+        // switched_val every time when compare
+        item = newNode<CaseItem>();
+        item->value = cased_val;
+        item->label = case_label;
+
+    } else {
+        // default:
+        readSymbol();
+        if (test3Failed(ONLY_COLON))
+            return NEXT_CASE;
+        readSymbol();
+        // this label is not necessary, but it improves
+        // readability of generated mid code and final
+        // mips code.
+        case_label = genLabel();
+        item = newNode<CaseItem>();
+        item->is_default = true;
+        item->label = case_label;
+    }
+    append(f.items_tail, item);
+    f.item = item;
+    return BEGIN_STATEMENT;
+}
+
+static StmtAction nextCaseItem(Stmt *&res)
+{
+    if (g_sym != RBRACE) {
+        return BEGIN_CASE;
+    }
+    readSymbol(); // skip RBRACE
+    res = stmt_stack.back().stmt;
+    stmt_stack.pop_back();
+    return END_STATEMENT;
+}
+
+static StmtAction pDoWhileStatement(Stmt *&res)
+{
+    DoWhileStmt *t = newStmt<DoWhileStmt>(STMT_DO_WHILE);
+    res = t;
+    t->label = genLabel();
+
+    assert(g_sym == DOSY);
+    readSymbol();
+    // loop body, condition follows in endStatement()
+    pushStmtFrame(FRAME_DO_WHILE, t);
+    return BEGIN_STATEMENT;
+}
+
+static void pPrintfStatement(Stmt *&res)
+{
+    PrintfStmt *t = newStmt<PrintfStmt>(STMT_PRINTF);
+    res = t;
+    assert(g_sym == PRINTFSY);
+    readSymbol();
+    test3(ONLY_LPARENT);
+    readSymbol();
+    if (g_sym == STRVALUE) {
+        // insert string to strings table and get a
+        // label for this string.
+        t->str = makeOperand(OPD_STRING, string2label(g_str));
+        readSymbol();
+        if (g_sym == COMMA) {
+            readSymbol();
+            pExpression(t->value);
+        }
+    } else {
+        pExpression(t->value);
+    }
+    if (t->value != NULL)
+        t->type = (t->value->dtype == DT_INT ? DT_INT : DT_CHAR);
+    test3(ONLY_RPARENT);
+    readSymbol();
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pScanfStatement(Stmt *&res)
+{
+    TabHandle handle;
+    const TabEntry *entry;
+    ScanfStmt *t = newStmt<ScanfStmt>(STMT_SCANF);
+    ReadItem **tail = &t->items;
+    res = t;
+
+    assert(g_sym == SCANFSY);
+    readSymbol();
+    test3(ONLY_LPARENT);
+    readSymbol();
+    int count = 0;
+    while (true) {
+        count++;
+        test3(ONLY_IDENTSY);
+        readSymbol();
+        handle = tabLookup(g_id);
+        entry = (handle == TAB_NONE ? NULL : &tabEntry(handle));
+        if (entry == NULL) {
+            error(ERR_UNDEFINED_IDENTIFIER);
+        }
+        else if (entry->itype != IT_VARIABLE || (
+                 entry->dtype != DT_INT &&
+                 entry->dtype != DT_CHAR)) {
+            error(ERR_WRONG_TYPE_OF_SCANF);
+        }
+        ReadItem *item = newNode<ReadItem>();
+        item->type = (entry != NULL && entry->dtype == DT_INT ?
+                DT_INT : DT_CHAR);
+        item->id = varOperand(handle);
+        append(tail, item);
+        if (g_sym != COMMA) {
+            break;
+        }
+        readSymbol();
+    }
+    if (count == 0) {
+        error(ERR_SCANF_NO_ARGUMENTS);
+    }
+    test3(ONLY_RPARENT);
+    readSymbol();
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pReturnStatement(Stmt *&res)
+{
+    DataType ret_dtype;
+    ReturnStmt *t = newStmt<ReturnStmt>(STMT_RETURN);
+    res = t;
+
+    assert(g_sym == RETURNSY);
+    readSymbol();
+    test3(FOLLOW_RETURN);
+    if (g_sym == LPARENT) {
+        readSymbol();
+        pExpression(t->value);
+        ret_dtype = t->value->dtype;
+        test3(ONLY_RPARENT);
+        readSymbol();
+    } else {
+        ret_dtype = DT_VOID;
+    }
+    if (ret_dtype != current_function_tabEntry.dtype) {
+        error(ERR_WRONG_RETURN_TYPE);
+    }
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pEmptyStatement()
+{
+    assert(g_sym == SEMICOLON);
+    readSymbol();
+}
+
+static void pAssignmentStatement(Stmt *&res, Name id)
+{
+    TabHandle handle;
+    const TabEntry *entry;
+
+    assert(g_sym == BECOMES);
+    readSymbol();
+    if ((handle = tabLookup(id)) == TAB_NONE) {
+        error(ERR_UNDEFINED_IDENTIFIER);
+        return;
+    }
+    entry = &tabEntry(handle);
+    if (entry->itype != IT_VARIABLE) {
+        // entry->itype might be IT_ARRAY
+        error(ERR_LEFT_VALUE_NOT_VARIABLE);
+        return;
+    }
+    Expr *rvalue;     // right value
+    pExpression(rvalue);
+    if (rvalue->dtype != entry->dtype) {
+        error(ERR_TYPE_NOT_MATCH);
+        return;
+    }
+    AssignStmt *t = newStmt<AssignStmt>(STMT_ASSIGN);
+    t->id = varOperand(handle);
+    t->value = rvalue;
+    res = t;
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pArrayAssignmentStatement(Stmt *&res, Name id)
+{
+    TabHandle handle;
+    const TabEntry *entry;
+
+    assert(g_sym == LBRACK);
+    if ((handle = tabLookup(id)) == TAB_NONE) {
+        error(ERR_UNDEFINED_IDENTIFIER);
+        return;
+    }
+    entry = &tabEntry(handle);
+    if (entry->itype != IT_ARRAY) {
+        error(ERR_NOT_AN_ARRAY);
+        return;
+    }
+    ArrayAssignStmt *t = newStmt<ArrayAssignStmt>(STMT_ARRAY_ASSIGN);
+    t->id = varOperand(handle);
+    res = t;
+    readSymbol(); // skip left bracket
+    // handle index
+    pExpression(t->index);
+    if (t->index->dtype != DT_INT) {
+        // array's index must be int type
+        error(ERR_EXPECT_INT_ARRAY_INDEX);
+    }
+    // overflow check for const indexes
+    int val;
+    if (isConstValue(t->index->res, val) &&
+        (val < 0 || val >= entry->value)) {
+        error(ERR_ARRAY_INDEX_OVERFLOW);
+    }
+    readSymbol(); // skip right bracket
+    test3(ONLY_BECOMES);
+    readSymbol(); // skip =
+    // handle right value
+    pExpression(t->value);
+    if (t->value->dtype != entry->dtype) {
+        error(ERR_TYPE_NOT_MATCH);
+    }
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+/**
+ * This function handles single function call statement,
+ * regardless of void or non-void functions.
+ */
+static void pFunctionCallStatement(Stmt *&res, Name id)
+{
+    TabHandle handle;
+    const TabEntry *entry;
+    if ((handle = tabLookup(id)) == TAB_NONE) {
+        error(ERR_UNDEFINED_IDENTIFIER);
+        return;
+    }
+    entry = &tabEntry(handle);
+    if (entry->itype != IT_FUNCTION) {
+        error(ERR_NOT_A_FUNCTION);
+        return;
+    }
+    const std::vector<DataType> &params = tabGetParams(id);
+    CallExpr *call = newExpr<CallExpr>(EXPR_CALL, entry->dtype, NONE);
+    call->func = varOperand(handle);
+    if (g_sym == LPARENT) {
+        pArgumentsList(call, params);
+    } else if (params.size() != 0) {
+        error(ERR_EXPECT_ARGUMENTS);
+        return;
+    }
+    call->argc = intOperand(params.size());
+    // as we don't call about return value, so we don't
+    // need to copy return value from $RET to some varaible
+    CallStmt *t = newStmt<CallStmt>(STMT_CALL);
+    t->call = call;
+    res = t;
+    test2(ONLY_SEMICOLON, NO_SYMBOLS);
+    readSymbol();
+}
+
+/**
+ * pParametersList is used for function's definition
+ * pArgumentsList is used for function call
+ * id: function's identifier
+ */
+static void pParametersList(Decl *&params, Name id)
+{
+    int count = 0;
+    Decl **tail = &params;
+
+    assert(g_sym == LPARENT);
+    while (g_sym != RPARENT) {
+        count++;
+
+        readSymbol(); // g_sym==COMMA or LPARENT
+        test2(FIRST_TYPE_IDENTIFIER, ONLY_RPARENT);
+        DataType dtype = g_sym == INTSY ? DT_INT: DT_CHAR;
+
+        readSymbol(); // identifier
+        test2(ONLY_IDENTSY, ONLY_RPARENT);
+        TabEntry entry = { LOCAL, IT_VARIABLE, dtype, -1, -1 };
+        TabHandle handle = tabInsert(g_id, entry);
+        if (!reparsing)
+            tabInsertParam(id, dtype);
+        VarDecl *param = newDecl<VarDecl>(DECL_VAR);
+        param->op = PARA;
+        param->type = dtype;
+        param->id = varOperand(handle);
+        append(tail, param);
+
+        readSymbol();
+        test3(FOLLOW_PARAMETER);
+        if (g_sym != COMMA)
+            break;
+    }
+    if (count == 0) {
+        error(ERR_MISSING_PARAMETERS);
+    }
+    readSymbol();
+}
+
+static void pGlobalVariableDefinitionItem(Decl **&tail,
+        DataType dtype, Name id)
+{
+    if (dtype == DT_VOID) {
+        error(ERR_WRONG_VARIABLE_TYPE);
+        // go on as a char variable, factors can't be void
+        dtype = DT_CHAR;
+    }
+    while (true) {
+        VarDecl *var = newDecl<VarDecl>(DECL_VAR);
+        var->op = GVAR;
+        var->type = dtype;
+        append(tail, var);
+        // g_sym always points to the one after identifier
+        if (g_sym == LBRACK) {       // array definition
+            readSymbol(); // skip left bracket
+            test3(ONLY_INTVALUE);
+            int array_size = g_num;
+            assert(g_num >= 0);
+            if (array_size == 0) {
+                error(ERR_ARRAY_SIZE_ZERO);
+            }
+            TabEntry entry = { GLOBAL, IT_ARRAY, dtype, array_size, -1 };
+            var->id = varOperand(tabInsert(id, entry));
+            var->size = intOperand(array_size);
+            readSymbol(); // skip size number
+            test3(ONLY_RBRACK);
+            readSymbol();
+        } else {                    // normal variable definition
+            TabEntry entry = { GLOBAL, IT_VARIABLE, dtype, -1, -1 };
+            var->id = varOperand(tabInsert(id, entry));
+        }
+        if (g_sym != COMMA) {
+            break;
+        }
+        readSymbol();
+        test3(ONLY_IDENTSY);
+        id = g_id;
+        readSymbol();
+    }
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pLocalVariableDefinitions(Decl *&vars)
+{
+    Decl **tail = &vars;
+    while (g_sym == INTSY || g_sym == CHARSY) {
+        DataType dtype = (g_sym == INTSY ? DT_INT : DT_CHAR);
+        while (true) {
+            // g_sym always points to the one before idnetifier
+            readSymbol(); // skip comma or INTSY or CHARSY
+            test3(ONLY_IDENTSY);
+            Name id = g_id;
+            readSymbol(); // skip identifier
+            VarDecl *var = newDecl<VarDecl>(DECL_VAR);
+            var->op = VAR;
+            var->type = dtype;
+            append(tail, var);
+            if (g_sym == LBRACK) {      // array definition
+                readSymbol(); // skip left bracket
+                test3(ONLY_INTVALUE);
+                int array_size = g_num;
+                TabEntry entry = { LOCAL, IT_ARRAY, dtype, array_size, -1 };
+                var->id = varOperand(tabInsert(id, entry));
+                var->size = intOperand(array_size);
+                readSymbol(); // skip size number
+                test3(ONLY_RBRACK);
+                readSymbol();
+            } else {                    // normal variable definition
+                TabEntry entry = { LOCAL, IT_VARIABLE, dtype, -1, -1 };
+                var->id = varOperand(tabInsert(id, entry));
+            }
+            if (g_sym != COMMA) {
+                break;
+            }
+        }
+        test3(ONLY_SEMICOLON);
+        readSymbol();
+    }
+}
+
+/* process one const definition */
+static void pConstDefinition(IdentScope scope)
+{
+    assert(g_sym == CONSTSY);
+    readSymbol();
+    test3(FIRST_TYPE_IDENTIFIER);
+    DataType dtype = g_sym == INTSY ? DT_INT : DT_CHAR;
+    TabEntry entry;
+    while (true) {
+        readSymbol(); // skip INTSY, CHARSY or COMMA
+        test3(ONLY_IDENTSY);
+        Name id = g_id;
+        readSymbol();
+        test3(ONLY_BECOMES);
+        readSymbol();
+        if (dtype == DT_INT) {
+            pSignedInteger();
+            entry = { scope, IT_CONST, DT_INT, g_num, -1 };
+        } else { // DT_CHAR
+            test3(ONLY_CHARVALUE);
+            entry = { scope, IT_CONST, DT_CHAR, g_char, -1 };
+            readSymbol();
+        }
+        tabInsert(id, entry);
+        if (g_sym != COMMA) {
+            break;
+        }
+    }
+    test(ONLY_SEMICOLON, FOLLOW_CONST_DEFINITION);
+    if (g_sym == CONSTSY)
+        return;
+    test3(ONLY_SEMICOLON);
+    readSymbol();
+}
+
+static void pConstDefinitions(IdentScope scope)
+{
+    // g_sym always points to the first word after semicolon
+    while (g_sym == CONSTSY) {
+        pConstDefinition(scope);
+    }
+}
+
+
+/**
+ * Process signed integer
+ *
+ * g_num is an unsigned integer read in by readSymbol()
+ * there might be '+' or '-' in front of it.
+ * if so, we combile they together and get a singed integer
+ * literal. Store it back to g_num
+ */
+static void pSignedInteger()
+{
+    int negtive = 1;
+    if (g_sym == PLUS || g_sym == MINUS) {
+        negtive = g_sym == MINUS ? -1 : 1;
+        readSymbol();
+    }
+    test3(ONLY_INTVALUE);
+    g_num *= negtive;
+    readSymbol();
+}
+
+/**
+ * Expressions are parsed with an explicit stack as well. Each frame
+ * is a <表达式> being parsed, holding terms and factors parsed so far.
+ * A factor containing an expression -- '('<表达式>')', index of an
+ * array or arguments of a call -- pushes a frame whose `kind` tells
+ * what to do when the expression is done.
+ */
+enum ExprFrameKind {
+    FRAME_EXPR,         // expression parsed by pExpression()
+    FRAME_PAREN,        // '('<表达式>')'
+    FRAME_INDEX,        // index of array read
+    FRAME_ARGS,         // <值参数表>, one expression after another
+};
+
+struct ExprFrame {
+    ExprFrameKind   kind;
+    int             sign;       // sign before first term: 1, -1, or 0 if none
+    Expr           *expr;       // terms before `add_op`, NULL for first term
+    OpCode          add_op;
+    Expr           *term;       // factors before `mul_op`, NULL for first factor
+    OpCode          mul_op;
+    // FRAME_INDEX
+    TabHandle       entry;
+    // FRAME_ARGS
+    CallExpr       *call;
+    const std::vector<DataType> *params;
+    unsigned int    args_count;
+    Arg           **tail;
+    bool            in_factor;  // call is a factor, not a statement
+};
+
+/* what expression parser does next */
+enum ExprAction {
+    BEGIN_EXPRESSION,   // <表达式> of the frame on top
+    BEGIN_FACTOR,       // <因子>
+    END_FACTOR,         // give factor `res` to the frame on top
+    END_EXPRESSION,     // expression `res` of the frame on top is done
+    END_ARGUMENTS,      // FRAME_ARGS on top is done
+};
+
+static thread_local std::vector<ExprFrame> expr_stack;
+
+/* stacks are left over when compiling stops in server mode */
+static void clearStacks()
+{
+    stmt_stack.clear();
+    expr_stack.clear();
+}
+
+static ExprFrame &pushExprFrame(ExprFrameKind kind)
+{
+    expr_stack.emplace_back();
+    ExprFrame &f = expr_stack.back();
+    f.kind = kind;
+    return f;
+}
+
+static void runExpressionParser(Expr *&res, ExprAction action);
+static ExprAction beginExpression();
+static ExprAction pFactor(Expr *&res);
+static ExprAction endFactor(Expr *&res);
+static ExprAction endExpression(Expr *&res);
+static ExprAction pArrayRead(TabHandle entry);
+static ExprAction endArrayRead(Expr *&res);
+static ExprAction pNonVoidFunctionCall(Expr *&res,
+        Name id, TabHandle handle);     // <有返回值函数调用语句>
+static ExprAction endNonVoidFunctionCall(Expr *&res);
+static void pushArguments(CallExpr *call,
+        const std::vector<DataType> &params, bool in_factor);
+static ExprAction nextArgument(Expr *&res);
+static Expr *signedTerm(int sign, Expr *term);
+static void setCallResult(CallExpr *call, size_t argc);
+
+static void pExpression(Expr *&res)
+{
+    assert(expr_stack.empty());
+    pushExprFrame(FRAME_EXPR);
+    runExpressionParser(res, BEGIN_EXPRESSION);
+}
+
+/* run until all frames are done */
+static void runExpressionParser(Expr *&res, ExprAction action)
+{
+    do {
+        switch (action) {
+            case BEGIN_EXPRESSION:  action = beginExpression(); break;
+            case BEGIN_FACTOR:      action = pFactor(res); break;
+            case END_FACTOR:        action = endFactor(res); break;
+            case END_EXPRESSION:    action = endExpression(res); break;
+            case END_ARGUMENTS:     action = endNonVoidFunctionCall(res); break;
+        }
+    } while (!expr_stack.empty());
+}
+
+/* <表达式> ::= [+|-]<项>{<加法运算符><项>} */
+static ExprAction beginExpression()
+{
+    ExprFrame &f = expr_stack.back();
+    f.sign = 0;
+    f.expr = NULL;
+    f.term = NULL;
+    if (g_sym == PLUS || g_sym == MINUS) {
+        f.sign = (g_sym == MINUS ? -1 : 1);
+        readSymbol();
+    }
+    return BEGIN_FACTOR;
+}
+
+/**
+ * Factor `res` is done, continue <项> ::= <因子>{<乘法运算符><因子>},
+ * and continue the expression if the term is done.
+ */
+static ExprAction endFactor(Expr *&res)
+{
+    ExprFrame &f = expr_stack.back();
+    f.term = (f.term == NULL ? res : binaryExpr(f.mul_op, f.term, res));
+    if (g_sym == STAR || g_sym == SLASH) {
+        f.mul_op = (g_sym == STAR ? MUL : DIV);
+        readSymbol();
+        return BEGIN_FACTOR;
+    }
+    if (f.expr == NULL) {
+        f.expr = signedTerm(f.sign, f.term);
+    } else {
+        f.expr = binaryExpr(f.add_op, f.expr, f.term);
+    }
+    f.term = NULL;
+    if (g_sym == PLUS || g_sym == MINUS) {
+        f.add_op = (g_sym == PLUS ? ADD : SUB);
+        readSymbol();
+        return BEGIN_FACTOR;
+    }
+    res = f.expr;
+    return END_EXPRESSION;
+}
+
+static ExprAction endExpression(Expr *&res)
+{
+    switch (expr_stack.back().kind) {
+        case FRAME_EXPR:
+            // pExpression() is done
+            expr_stack.pop_back();
+            return END_EXPRESSION;
+        case FRAME_INDEX:   return endArrayRead(res);
+        case FRAME_ARGS:    return nextArgument(res);
+        case FRAME_PAREN:   break;
+    }
+    expr_stack.pop_back();
+    res->dtype = DT_INT;           // ('p') should be convert to int
+    if (!test3Failed(ONLY_RPARENT)) {
+        readSymbol();
+    }
+    return END_FACTOR;
+}
+
+/* sign of the first term, no need to generate code for '+' */
+static Expr *signedTerm(int sign, Expr *term)
+{
+    int val;
+    if (sign < 0) {
+        if (isConstValue(term->res, val)) {
+            return newExpr<Expr>(EXPR_VALUE, DT_INT, intOperand(-val));
+        }
+        NegExpr *t = newExpr<NegExpr>(EXPR_NEG, DT_INT, genTempVar());
+        t->operand = term;
+        return t;
+    }
+    if (sign > 0) {
+        if (isConstValue(term->res, val)) {
+            term->res = intOperand(val);
+        }
+        term->dtype = DT_INT;
+    }
+    return term;
+}
+
+/**
+ * If both operands ares const value, we can calculate it,
+ * otherwise a temp variable holds the result.
+ */
+static Expr *binaryExpr(OpCode op, Expr *left, Expr *right)
+{
+    int t1, t2;
+    if (isConstValue(left->res, t1) && isConstValue(right->res, t2)) {
+        int val = (op == ADD ? t1 + t2 : op == SUB ? t1 - t2 :
+                   op == MUL ? t1 * t2 : t1 / t2);
+        return newExpr<Expr>(EXPR_VALUE, DT_INT, intOperand(val));
+    }
+    BinaryExpr *t = newExpr<BinaryExpr>(EXPR_BINARY, DT_INT, genTempVar());
+    t->op = op;
+    t->left = left;
+    t->right = right;
+    return t;
+}
+
+/* Note that res is reference */
+static ExprAction pFactor(Expr *&res)
+{
+    Name id;
+    TabHandle handle;
+    const TabEntry *entry;
+    // value of a wrong factor, it has no type
+    res = newExpr<Expr>(EXPR_VALUE, DT_VOID, NONE);
+    // For conveniency, we assume all identifiers here are non-void-function-call
+    if (test3Failed(FIRST_FACTOR))
+        return END_FACTOR;
+    switch (g_sym) {
+        case IDENTSY:   id = g_id;
+                        readSymbol();
+                        handle = tabLookup(id);
+                        if (handle == TAB_NONE) {
+                            // undefined identifier
+                            error(ERR_UNDEFINED_IDENTIFIER);
+                            break;
+                        }
+                        entry = &tabEntry(handle);
+                        // entry->itype might be:
+                        // IT_FUNCTION, IT_ARRAY, IT_VARIABLE, IT_CONST
+
+                        // 1. handle functions
+                        if (entry->itype == IT_FUNCTION) {
+                            return pNonVoidFunctionCall(res, id, handle);
+                        } else if (g_sym == LPARENT) {
+                            // use function call on a not-a-function identifier
+                            error(ERR_NOT_A_FUNCTION);
+                            break;
+                        }
+                        // 2. handle arrays
+                        if (entry->itype == IT_ARRAY) {
+                            return pArrayRead(handle);
+                        }
+                        assert(entry->itype == IT_CONST || entry->itype == IT_VARIABLE);
+                        assert(entry->dtype == DT_CHAR || entry->dtype == DT_INT);
+                        // 3. handle consts variable
+                        if (entry->itype == IT_CONST) {
+                            // return consts' character directly
+                            if (entry->dtype == DT_CHAR) {
+                                res->dtype = DT_CHAR;
+                                res->res = charLiteral((char)entry->value);
+                            } else {
+                                res->dtype = DT_INT;
+                                res->res = intOperand(entry->value);
+                            }
+                        }
+                        // 4. handle normal variable (int or char)
+                        else {
+                            // return identifier directly
+                            res->res = varOperand(handle);
+                            res->dtype = entry->dtype;
+                        }
+                        break;
+        case CHARVALUE: readSymbol();
+                        res->res = charLiteral(g_char);
+                        res->dtype = DT_CHAR;
+                        break;
+        case LPARENT:   readSymbol();
+                        pushExprFrame(FRAME_PAREN);
+                        return BEGIN_EXPRESSION;
+        default:        pSignedInteger();  // a signed integer is stored at g_num
+                        res->res = intOperand(g_num);
+                        res->dtype = DT_INT;
+                        break;
+    }
+    return END_FACTOR;
+}
+
+/* index is parsed after this, see endArrayRead() */
+static ExprAction pArrayRead(TabHandle entry)
+{
+    if (g_sym != LBRACK) {
+        error(ERR_EXPECT_ARRAY_ELEMENT);
+    }
+    if (test3Failed(ONLY_LBRACK))
+        return END_FACTOR;
+    readSymbol();  // skip left bracket
+    ExprFrame &f = pushExprFrame(FRAME_INDEX);
+    f.entry = entry;
+    return BEGIN_EXPRESSION;
+}
+
+/* index `res` of array read is done */
+static ExprAction endArrayRead(Expr *&res)
+{
+    TabHandle handle = expr_stack.back().entry;
+    const TabEntry &entry = tabEntry(handle);
+    expr_stack.pop_back();
+    Expr *index = res;
+    if (index->dtype != DT_INT) {
+        // array's index must be int type
+        error(ERR_EXPECT_INT_ARRAY_INDEX);
+    }
+    // overflow check for const indexes
+    int val;
+    if (isConstValue(index->res, val) &&
+        (val < 0 || val >= entry.value)) {
+        error(ERR_ARRAY_INDEX_OVERFLOW);
+    }
+    ArrayExpr *t = newExpr<ArrayExpr>(EXPR_ARRAY, entry.dtype, genTempVar());
+    t->array = varOperand(handle);
+    t->type = (entry.dtype == DT_INT ? DT_INT: DT_CHAR);
+    t->index = index;
+    res = t;
+    if (!test3Failed(ONLY_RBRACK)) {
+        readSymbol();
+    }
+    return END_FACTOR;
+}
+
+/**
+ * Non-void function call is only used in <expression>.
+ * Functions called in expressions must be non-void function.
+ * :res         containing function call with its return value
+ * :id          current function's identifier
+ * :handle      symbol table entry of current function
+ */
+static ExprAction pNonVoidFunctionCall(Expr *&res,
+        Name id, TabHandle handle)
+{
+    const TabEntry &entry = tabEntry(handle);
+    assert(entry.itype == IT_FUNCTION);
+    if (entry.dtype == DT_VOID) {
+        error(ERR_EXPECT_NON_VOID_FUNCTION);
+        return END_FACTOR;
+    }
+    const std::vector<DataType> &params = tabGetParams(id);
+    CallExpr *t = newExpr<CallExpr>(EXPR_CALL, entry.dtype, NONE);
+    t->func = varOperand(handle);
+
+    if (g_sym == LPARENT) {
+        // arguments are parsed after this
+        pushArguments(t, params, true);
+        return BEGIN_EXPRESSION;
+    } else if (params.size() != 0) {
+        error(ERR_EXPECT_ARGUMENTS);
+        return END_FACTOR;
+    }
+    setCallResult(t, params.size());
+    res = t;
+    return END_FACTOR;
+}
+
+/* arguments list on top is done */
+static ExprAction endNonVoidFunctionCall(Expr *&res)
+{
+    ExprFrame f = expr_stack.back();
+    expr_stack.pop_back();
+    if (!f.in_factor) {
+        // call statement, nothing left to parse
+        assert(expr_stack.empty());
+        return END_ARGUMENTS;
+    }
+    setCallResult(f.call, f.params->size());
+    res = f.call;
+    return END_FACTOR;
+}
+
+static void setCallResult(CallExpr *call, size_t argc)
+{
+    call->argc = intOperand(argc);
+    // create a temp variable for holding return value
+    call->res = genTempVar();
+    call->type = (call->dtype == DT_INT ? DT_INT: DT_CHAR);
+}
+
+/**
+ * pParametersList is used for function's definition
+ * pArgumentsList is used for function call
+ * This one is for call statements, arguments are put
+ * in `call`.
+ */
+static void pArgumentsList(CallExpr *call, const std::vector<DataType> &params)
+{
+    assert(expr_stack.empty());
+    Expr *res = NULL;
+    pushArguments(call, params, false);
+    runExpressionParser(res, BEGIN_EXPRESSION);
+}
+
+static void pushArguments(CallExpr *call,
+        const std::vector<DataType> &params, bool in_factor)
+{
+    assert(g_sym == LPARENT);
+    ExprFrame &f = pushExprFrame(FRAME_ARGS);
+    f.call = call;
+    f.params = &params;
+    f.tail = &call->args;
+    f.in_factor = in_factor;
+    readSymbol();
+}
+
+/* argument `res` is done, the next one reuses the frame */
+static ExprAction nextArgument(Expr *&res)
+{
+    ExprFrame &f = expr_stack.back();
+    if (++f.args_count > f.params->size()) {
+        error(ERR_MORE_ARGUMENTS);
+        return END_ARGUMENTS;
+    }
+    // check argument's data type
+    if ((*f.params)[f.args_count - 1] != res->dtype) {
+        error(ERR_WRONG_TYPE_OF_ARGUMENT);
+        return END_ARGUMENTS;
+    }
+    Arg *arg = newNode<Arg>();
+    arg->value = res;
+    append(f.tail, arg);
+    if (g_sym == COMMA) {
+        readSymbol();
+        return BEGIN_EXPRESSION;
+    }
+    if (f.args_count < f.params->size()) {
+        error(ERR_LESS_ARGUMENTS);
+        return END_ARGUMENTS;
+    }
+    if (!test3Failed(ONLY_RPARENT)) {
+        readSymbol();
+    }
+    return END_ARGUMENTS;
+}
+
+/* char literal is written with its quotation marks, like 'a' */
+static Operand charLiteral(char c)
+{
+    return makeOperand(OPD_CHAR, c);
+}
+
@@ -1,10 +1,66 @@
-#ifndef GRAMMAR_H_
-#define GRAMMAR_H_
-
-
-
-void pProgram();
-
-
-
-#endif // GRAMMAR_H_
+#ifndef GRAMMAR_H_
+#define GRAMMAR_H_
+
+#include <vector>
+#include "ast.h"
+
+/**
+ * Parse the whole program and build its syntax tree,
+ * nodes are allocated from `ast_arena`.
+ */
+Program *pProgram();
+
+/**
+ * A function body found before parsing by matching braces, its '{'
+ * is at column `pos` of line `line_no`, and the matching '}' at
+ * column `end_pos` of line `end_line_no`.
+ */
+struct BodyBraces {
+    unsigned int    line_no;
+    unsigned int    pos;
+    unsigned int    end_line_no;
+    unsigned int    end_pos;
+};
+
+/**
+ * Parse the program like pProgram(), but skip function bodies,
+ * which are in `bodies` in source order, so the tree has global
+ * variables and functions without bodies. Global table, parameter
+ * lists and function spans are filled as pProgram() does, then each
+ * function can be parsed on its own by pFunctionAgain(). Only in
+ * server mode, compiling stops if a body is not in `bodies`.
+ */
+Program *pProgramHeaders(const std::vector<BodyBraces> &bodies);
+
+/**
+ * A function definition found by pProgram(). Its body only sees
+ * globals defined before it, so after the body is edited, the
+ * function can be parsed again alone by pFunctionAgain().
+ */
+struct FunctionSpan {
+    unsigned int    line_no;    // position of its type word
+    unsigned int    word_pos;
+    unsigned int    end_line_no;    // where the lexer stops after it,
+    unsigned int    end_word_pos;   // 0 if compiling stops in it
+    unsigned int    stamp;      // tabGlobalStamp() after its header
+    bool            inserted;   // false if its name is a duplicate
+    bool            is_main;
+    NameCounters    counters;   // nameCounters() before it
+    NameCounters    end_counters;   // and after it
+};
+
+/* functions found by the last pProgram(), in source order */
+const std::vector<FunctionSpan> &functionSpans();
+
+/**
+ * Parse the function of `span` again without writing to the
+ * global table, its text may have moved to another position.
+ * The lexer stops at the word after the function, or at the
+ * last '}' for main function. Return declarations parsed, which
+ * is the function unless its text is changed.
+ */
+Decl *pFunctionAgain(const FunctionSpan &span);
+
+
+
+#endif // GRAMMAR_H_
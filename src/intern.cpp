@@ -0,0 +1,204 @@
+#include <string>       // string
+#include <vector>       // vector
+#include <cstring>      // memcmp, memcpy
+#include <cassert>      // assert
+#include <atomic>       // atomic
+#include <mutex>        // mutex, lock_guard
+#include "intern.h"
+#include "arena.h"
+
+
+/**
+ * Strings are copied into an arena which is never cleared,
+ * so text of a name is stable.
+ *
+ * Names are found by an open-addressing hash table of ids,
+ * the capacity of which is always a power of 2.
+ *
+ * Interning is done under a mutex so the lexer thread and the parser
+ * can both intern. Entries are stored in fixed-size chunks which are
+ * never moved, so nameText() reads them without locking: an id can
+ * only be known by a thread after the entry is written.
+ *
+ * For the same reason, each thread keeps a small cache of ids it has
+ * interned, indexed by hash, so a name seen before (most identifiers
+ * the lexer reads) is found without taking the mutex.
+ */
+#define EMPTY_SLOT          0xFFFFFFFFu
+#define NAME_CHUNK_BITS     12
+#define NAME_CHUNK_SIZE     (1u << NAME_CHUNK_BITS)
+#define MAX_NAME_CHUNKS     (1u << 16)
+#define NAME_CACHE_SIZE     1024
+
+struct NameEntry {
+    const char     *text;
+    unsigned int    length;
+    unsigned int    hash;
+};
+
+struct Interner {
+    NameEntry                  *chunks[MAX_NAME_CHUNKS];
+    std::atomic<unsigned int>   count;
+    std::vector<unsigned int>   slots;
+    Arena                       texts;
+    std::mutex                  mutex;
+
+    Interner();
+    ~Interner();
+    NameEntry &entry(unsigned int id) {
+        return chunks[id >> NAME_CHUNK_BITS][id & (NAME_CHUNK_SIZE - 1)];
+    }
+    void grow();
+};
+
+static const char *predefined_names[] = {
+    "", "int", "char", "void", "str", "main",
+    "EQL", "NEQ", "LSS", "LEQ", "GTR", "GEQ",
+};
+
+static unsigned int hashString(const char *str, size_t length);
+static Name internTo(Interner &t, const char *str, size_t length,
+                     unsigned int h);
+
+static Interner &interner()
+{
+    static Interner t;
+    return t;
+}
+
+static unsigned int hashString(const char *str, size_t length)
+{
+    // 8 characters at a time, ids don't depend on the hash
+    unsigned long long h = length * 0x9E3779B97F4A7C15ull;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned long long w;
+        std::memcpy(&w, str + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+    }
+    if (i < length) {
+        unsigned long long w = 0;
+        for (; i < length; i++)
+            w = (w << 8) | (unsigned char)str[i];
+        h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+    }
+    return (unsigned int)(h >> 32);
+}
+
+Interner::Interner(): chunks(), count(0)
+{
+    slots.assign(256, EMPTY_SLOT);
+    for (auto str : predefined_names) {
+        size_t length = std::strlen(str);
+        internTo(*this, str, length, hashString(str, length));
+    }
+}
+
+Interner::~Interner()
+{
+    for (auto chunk : chunks)
+        delete[] chunk;
+}
+
+void Interner::grow()
+{
+    std::vector<unsigned int> t(slots.size() * 2, EMPTY_SLOT);
+    size_t mask = t.size() - 1;
+    for (unsigned int id = 0; id < count; id++) {
+        size_t i = entry(id).hash & mask;
+        while (t[i] != EMPTY_SLOT)
+            i = (i + 1) & mask;
+        t[i] = id;
+    }
+    slots.swap(t);
+}
+
+/* caller must hold t.mutex, or be the constructor */
+static Name internTo(Interner &t, const char *str, size_t length,
+                     unsigned int h)
+{
+    size_t mask = t.slots.size() - 1;
+    size_t i = h & mask;
+    while (t.slots[i] != EMPTY_SLOT) {
+        const NameEntry &entry = t.entry(t.slots[i]);
+        if (entry.hash == h && entry.length == length &&
+                std::memcmp(entry.text, str, length) == 0) {
+            Name res(t.slots[i]);
+            return res;
+        }
+        i = (i + 1) & mask;
+    }
+    // not found, copy it into arena
+    char *text = (char *)t.texts.allocate(length + 1, 1);
+    std::memcpy(text, str, length);
+    text[length] = '\0';
+    Name res(t.count.load(std::memory_order_relaxed));
+    if ((res.id & (NAME_CHUNK_SIZE - 1)) == 0) {
+        assert((res.id >> NAME_CHUNK_BITS) < MAX_NAME_CHUNKS);
+        t.chunks[res.id >> NAME_CHUNK_BITS] = new NameEntry[NAME_CHUNK_SIZE];
+    }
+    NameEntry entry = { text, (unsigned int)length, h };
+    t.entry(res.id) = entry;
+    t.count.store(res.id + 1, std::memory_order_release);
+    t.slots[i] = res.id;
+    // keep load factor below 1/2
+    if (t.count * 2 > t.slots.size())
+        t.grow();
+    return res;
+}
+
+Name intern(const char *str, size_t length)
+{
+    // id 0 is "", which is never cached, marks an empty cache slot
+    static thread_local unsigned int cache[NAME_CACHE_SIZE];
+    unsigned int h = hashString(str, length);
+    unsigned int &id = cache[h & (NAME_CACHE_SIZE - 1)];
+    Interner &t = interner();
+    if (id != 0) {
+        const NameEntry &entry = t.entry(id);
+        if (entry.hash == h && entry.length == length &&
+                std::memcmp(entry.text, str, length) == 0)
+            return Name(id);
+    }
+    std::lock_guard<std::mutex> lock(t.mutex);
+    Name res = internTo(t, str, length, h);
+    id = res.id;
+    return res;
+}
+
+Name intern(const std::string &str)
+{
+    return intern(str.data(), str.size());
+}
+
+Name internInt(int value)
+{
+    return intern(std::to_string(value));
+}
+
+const char *nameText(Name name)
+{
+    assert(name.id < nameCount());
+    return interner().entry(name.id).text;
+}
+
+size_t nameLength(Name name)
+{
+    assert(name.id < nameCount());
+    return interner().entry(name.id).length;
+}
+
+std::string nameString(Name name)
+{
+    return std::string(nameText(name), nameLength(name));
+}
+
+size_t nameCount()
+{
+    return interner().count.load(std::memory_order_acquire);
+}
+
+std::ostream &operator<<(std::ostream &os, Name name)
+{
+    return os.write(nameText(name), nameLength(name));
+}
@@ -0,0 +1,68 @@
+/**
+ * This module is a string interner.
+ *
+ * Each distinct string is stored once in an arena and gets a 32-bit
+ * id which never changes. Identifiers, temp variables, labels and
+ * literals in mid-code are all interned, so symbol tables and
+ * mid-code hash and compare integers instead of strings.
+ * All functions may be called from more than one thread.
+ */
+#ifndef INTERN_H_
+#define INTERN_H_
+
+#include <string>
+#include <cstddef>          // size_t
+#include <iostream>         // ostream
+#include <functional>       // hash
+
+/**
+ * A `Name` is the id of an interned string, ids are given in
+ * order of interning, so they can be used as array indexes.
+ * A default constructed name is the empty string.
+ */
+struct Name {
+    unsigned int id;
+    constexpr Name(): id(0) {}
+    constexpr explicit Name(unsigned int t): id(t) {}
+    bool operator==(const Name &t) const { return id == t.id; }
+    bool operator!=(const Name &t) const { return id != t.id; }
+    bool operator<(const Name &t) const { return id < t.id; }
+};
+
+namespace std {
+template <> struct hash<Name> {
+    size_t operator()(const Name &t) const { return t.id; }
+};
+}
+
+/**
+ * Following names are interned before anything else, so that
+ * their ids are known at compile time.
+ */
+constexpr Name NAME_EMPTY(0);   // ""
+constexpr Name NAME_INT(1);     // "int"
+constexpr Name NAME_CHAR(2);    // "char"
+constexpr Name NAME_VOID(3);    // "void"
+constexpr Name NAME_STR(4);     // "str"
+constexpr Name NAME_MAIN(5);    // "main"
+constexpr Name NAME_EQL(6);     // "EQL"
+constexpr Name NAME_NEQ(7);     // "NEQ"
+constexpr Name NAME_LSS(8);     // "LSS"
+constexpr Name NAME_LEQ(9);     // "LEQ"
+constexpr Name NAME_GTR(10);    // "GTR"
+constexpr Name NAME_GEQ(11);    // "GEQ"
+
+Name intern(const char *str, size_t length);
+Name intern(const std::string &str);
+Name internInt(int value);
+
+/* NUL-terminated text of a name, the pointer never changes */
+const char *nameText(Name name);
+size_t nameLength(Name name);
+std::string nameString(Name name);
+/* number of names interned, all ids are less than it */
+size_t nameCount();
+
+std::ostream &operator<<(std::ostream &os, Name name);
+
+#endif // INTERN_H_
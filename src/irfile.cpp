@@ -0,0 +1,655 @@
+#include <iostream>     // cout
+#include <fstream>      // ofstream
+#include <vector>       // vector
+#include <string>       // string
+#include <cstring>      // memcpy, memcmp, strlen
+#include <cstdint>      // uint32_t
+#include <algorithm>    // max
+#include "irfile.h"
+#include "midcode.h"
+#include "table.h"
+#include "source.h"
+#include "intern.h"
+
+
+struct IrHeader {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    codes;
+    uint32_t    globals;
+    uint32_t    scopes;
+    uint32_t    locals;
+    uint32_t    temps;
+    uint32_t    names;
+    uint32_t    strings;
+    uint32_t    text_bytes;
+};
+
+struct IrEntry {
+    uint32_t    name;
+    uint8_t     scope;
+    uint8_t     itype;
+    uint8_t     dtype;
+    uint8_t     unused;
+    int32_t     value;
+    int32_t     addr;
+};
+
+struct IrScope {
+    uint32_t    func;
+    int32_t     frame_size;
+    int32_t     first_temp;
+    uint32_t    entries;
+    uint32_t    temps;
+};
+
+/* a field of a line in mid_code.txt, fields are split by ' ' */
+struct Field {
+    const char *text;
+    size_t      length;
+};
+#define MAX_FIELDS  6
+
+/* file-scope global variables */
+static std::vector<Name>        saved_names;    // names in a file, in order
+static std::vector<uint32_t>    name_index;     // index in file of name id
+static bool         in_function;    // reading codes of a function
+static Name         function;       // the function being read
+static int          first_temp;     // of the function being read
+static int          next_temp;      // after all temp vars read
+
+static uint32_t nameIndex(Name id);
+static IrEntry irEntry(Name id, const TabEntry &entry);
+static bool loadBinaryIR();
+static bool loadTextIR();
+static void restoreNameCounters();
+static bool readLine(const char *line, size_t length);
+static bool readString(const char *line, size_t length);
+static bool readAssign(const Field *f, size_t count);
+static bool readFunction(const Field *f);
+static bool readDefinition(OpCode op, const Field *f, size_t count);
+static bool splitFields(const char *line, size_t length, Field *f,
+        size_t &count);
+static bool parseOperand(const char *text, size_t length, Operand &t);
+static bool parseOperand(const Field &f, Operand &t);
+static bool parseValue(const Field &f, Operand &t);
+static bool parseSubscript(const Field &f, Operand &array, Operand &index);
+static bool parseNumber(const char *text, size_t length, int &value);
+static bool parseType(const Field &f, DataType &dtype);
+static bool parseRelation(const Field &f, Relation &rel);
+static bool isText(const Field &f, const char *text);
+
+
+template <typename T>
+static void writeArray(std::ofstream &out, const T *items, size_t count)
+{
+    if (count != 0)
+        out.write(reinterpret_cast<const char *>(items), count * sizeof(T));
+}
+
+bool saveBinaryIR(const std::string &filename)
+{
+    saved_names.assign(1, NAME_EMPTY);
+    name_index.clear();
+    std::vector<IrEntry> globals, locals;
+    std::vector<IrScope> scopes;
+    std::vector<uint32_t> temps;
+    for (TabHandle handle = 0; handle < tabGlobalStamp(); handle++)
+        globals.push_back(irEntry(tabName(handle), tabEntry(handle)));
+    for (const FunctionScope &scope : tabKeptScopes()) {
+        IrScope t = { nameIndex(scope.func), scope.frame_size,
+            scope.first_temp, (uint32_t)scope.entries.size(),
+            (uint32_t)scope.temps.size() };
+        scopes.push_back(t);
+        for (size_t i = 0; i < scope.entries.size(); i++)
+            locals.push_back(irEntry(scope.ids[i], scope.entries[i]));
+        temps.insert(temps.end(), scope.temps.begin(), scope.temps.end());
+    }
+    std::string text;
+    std::vector<uint32_t> name_ends, string_ends;
+    for (Name id : saved_names) {
+        text.append(nameText(id), nameLength(id));
+        name_ends.push_back(text.size());
+    }
+    for (const std::string &str : labeledStrings()) {
+        text += str;
+        string_ends.push_back(text.size());
+    }
+
+    IrHeader header;
+    memcpy(header.magic, IR_MAGIC, sizeof(header.magic));
+    header.version = IR_VERSION;
+    header.codes = mid_codes.size();
+    header.globals = globals.size();
+    header.scopes = scopes.size();
+    header.locals = locals.size();
+    header.temps = temps.size();
+    header.names = name_ends.size();
+    header.strings = string_ends.size();
+    header.text_bytes = text.size();
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out)
+        return false;
+    writeArray(out, &header, 1);
+    writeArray(out, mid_codes.valueArray(), mid_codes.size() * SLOT_COUNT);
+    writeArray(out, globals.data(), globals.size());
+    writeArray(out, scopes.data(), scopes.size());
+    writeArray(out, locals.data(), locals.size());
+    writeArray(out, temps.data(), temps.size());
+    writeArray(out, name_ends.data(), name_ends.size());
+    writeArray(out, string_ends.data(), string_ends.size());
+    writeArray(out, mid_codes.opArray(), mid_codes.size());
+    writeArray(out, mid_codes.kindArray(), mid_codes.size() * SLOT_COUNT);
+    writeArray(out, text.data(), text.size());
+    return (bool)out;
+}
+
+/* index of `id` in names of the file being saved */
+static uint32_t nameIndex(Name id)
+{
+    if (id == NAME_EMPTY)
+        return 0;
+    if (id.id >= name_index.size())
+        name_index.resize(nameCount(), 0);
+    if (name_index[id.id] == 0) {
+        name_index[id.id] = saved_names.size();
+        saved_names.push_back(id);
+    }
+    return name_index[id.id];
+}
+
+static IrEntry irEntry(Name id, const TabEntry &entry)
+{
+    IrEntry t = { nameIndex(id), (uint8_t)entry.scope, (uint8_t)entry.itype,
+        (uint8_t)entry.dtype, 0, entry.value, entry.addr };
+    return t;
+}
+
+
+bool loadIR()
+{
+    in_function = false;
+    next_temp = 0;
+    tabClear(GLOBAL);
+    mid_codes.clear();
+    bool ok;
+    if (sourceSize() >= sizeof(IrHeader) &&
+            memcmp(sourceText(), IR_MAGIC, strlen(IR_MAGIC)) == 0)
+        ok = loadBinaryIR();
+    else
+        ok = loadTextIR();
+    if (ok)
+        restoreNameCounters();
+    return ok;
+}
+
+/* new temp vars and labels, e.g. of the optimizer, follow those loaded */
+static void restoreNameCounters()
+{
+    NameCounters counters = { 0, 0, 0 };
+    for (size_t i = 0; i < mid_codes.size(); i++) {
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            Operand t = mid_codes.operand(i, (OperandSlot)slot);
+            if (t.kind == OPD_TEMP)
+                counters.temps = std::max(counters.temps, t.value + 1);
+            else if (t.kind == OPD_LABEL)
+                counters.labels = std::max(counters.labels, t.value + 1);
+            else if (t.kind >= OPD_IF && t.kind <= OPD_IF_END)
+                counters.if_statements =
+                    std::max(counters.if_statements, t.value);
+        }
+    }
+    setNameCounters(counters);
+}
+
+/* arrays of a binary IR file are taken one after another */
+class IrReader {
+public:
+    IrReader(const char *begin): next(begin) {}
+
+    template <typename T>
+    const T *take(size_t count)
+    {
+        const T *items = reinterpret_cast<const T *>(next);
+        next += count * sizeof(T);
+        return items;
+    }
+
+private:
+    const char *next;
+};
+
+static bool loadBinaryIR()
+{
+    IrHeader header;
+    memcpy(&header, sourceText(), sizeof(header));
+    if (header.version != IR_VERSION) {
+        std::cout << "IR version " << header.version << " is not supported, "
+            << "expected " << IR_VERSION << std::endl;
+        return false;
+    }
+    uint64_t size = sizeof(header) +
+        (uint64_t)header.codes * (SLOT_COUNT * 5 + 1) +
+        ((uint64_t)header.globals + header.locals) * sizeof(IrEntry) +
+        (uint64_t)header.scopes * sizeof(IrScope) +
+        ((uint64_t)header.temps + header.names + header.strings) * 4 +
+        header.text_bytes;
+    if (size != sourceSize() || header.names == 0) {
+        std::cout << "IR file is damaged" << std::endl;
+        return false;
+    }
+
+    IrReader reader(sourceText() + sizeof(header));
+    const int32_t *values = reader.take<int32_t>(header.codes * SLOT_COUNT);
+    const IrEntry *globals = reader.take<IrEntry>(header.globals);
+    const IrScope *scopes = reader.take<IrScope>(header.scopes);
+    const IrEntry *locals = reader.take<IrEntry>(header.locals);
+    const uint32_t *temps = reader.take<uint32_t>(header.temps);
+    const uint32_t *name_ends = reader.take<uint32_t>(header.names);
+    const uint32_t *string_ends = reader.take<uint32_t>(header.strings);
+    const uint8_t *ops = reader.take<uint8_t>(header.codes);
+    const uint8_t *kinds = reader.take<uint8_t>(header.codes * SLOT_COUNT);
+    const char *text = reader.take<char>(header.text_bytes);
+
+    bool ok = true;
+    std::vector<Name> names;
+    uint32_t begin = 0;
+    for (uint32_t i = 0; ok && i < header.names; i++) {
+        ok = (begin <= name_ends[i] && name_ends[i] <= header.text_bytes);
+        if (ok)
+            names.push_back(intern(text + begin, name_ends[i] - begin));
+        begin = name_ends[i];
+    }
+    for (uint32_t i = 0; ok && i < header.strings; i++) {
+        ok = (begin <= string_ends[i] && string_ends[i] <= header.text_bytes &&
+                string2label(std::string(text + begin,
+                        string_ends[i] - begin)) == (int)i);
+        begin = string_ends[i];
+    }
+    for (uint32_t i = 0; ok && i < header.globals; i++) {
+        const IrEntry &t = globals[i];
+        TabEntry entry = { (IdentScope)t.scope, (IdentType)t.itype,
+            (DataType)t.dtype, t.value, t.addr };
+        ok = (t.name < header.names && entry.scope == GLOBAL &&
+                tabInsert(names[t.name], entry) == i);
+    }
+    uint32_t local = 0, temp = 0;
+    for (uint32_t i = 0; ok && i < header.scopes; i++) {
+        const IrScope &t = scopes[i];
+        ok = (t.func < header.names && t.entries <= header.locals - local &&
+                t.temps <= header.temps - temp);
+        if (!ok)
+            break;
+        FunctionScope scope;
+        scope.func = names[t.func];
+        scope.frame_size = t.frame_size;
+        scope.first_temp = t.first_temp;
+        for (; ok && scope.entries.size() < t.entries; local++) {
+            ok = (locals[local].name < header.names);
+            TabEntry entry = { LOCAL, (IdentType)locals[local].itype,
+                (DataType)locals[local].dtype, locals[local].value,
+                locals[local].addr };
+            scope.ids.push_back(ok ? names[locals[local].name] : NAME_EMPTY);
+            scope.entries.push_back(entry);
+        }
+        scope.temps.assign(temps + temp, temps + temp + t.temps);
+        temp += t.temps;
+        tabKeepScope(scope);
+    }
+    for (uint32_t i = 0; ok && i < header.codes; i++) {
+        ok = (ops[i] <= TEMP);
+        for (int slot = 0; ok && slot < SLOT_COUNT; slot++)
+            ok = (kinds[i * SLOT_COUNT + slot] <= OPD_REL);
+    }
+    if (!ok) {
+        std::cout << "IR file is damaged" << std::endl;
+        return false;
+    }
+    mid_codes.append(ops, kinds, values, header.codes);
+    return true;
+}
+
+
+static bool loadTextIR()
+{
+    bool has_function = false;
+    for (unsigned int line_no = 1; line_no <= sourceLineCount(); line_no++) {
+        const char *line = sourceLineBegin(line_no);
+        size_t length = sourceLineLength(line_no);
+        if (length == 0)
+            continue;
+        if (!readLine(line, length)) {
+            std::cout << "can't read mid-code at line " << line_no << ": "
+                << std::string(line, length) << std::endl;
+            return false;
+        }
+        has_function = has_function || in_function;
+    }
+    if (in_function || !has_function) {
+        std::cout << "mid-code is incomplete" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/* read a line of mid-code, see convertFormat() in midcode.cpp */
+static bool readLine(const char *line, size_t length)
+{
+    static const char STRING_PREFIX[] = "string $STRING_";
+    if (length > strlen(STRING_PREFIX) &&
+            memcmp(line, STRING_PREFIX, strlen(STRING_PREFIX)) == 0)
+        return readString(line, length);
+
+    Field f[MAX_FIELDS];
+    size_t count;
+    if (!splitFields(line, length, f, count))
+        return false;
+    if (count >= 3 && isText(f[1], "="))
+        return readAssign(f, count);
+    if (count == 2 && f[1].length > 2 &&
+            memcmp(f[1].text + f[1].length - 2, "()", 2) == 0)
+        return readFunction(f);
+
+    FourTuple t = { END, NONE, NONE, NONE };
+    Relation rel;
+    if (count == 3 && parseRelation(f[1], rel)) {
+        t.op = COMPARE;
+        t.b = relOperand(rel);
+        if (!parseValue(f[0], t.a) || !parseValue(f[2], t.res))
+            return false;
+    } else if (count == 3 && f[1].length == 0 && f[2].length == 0) {
+        t.op = COMPARE;
+        if (!parseValue(f[0], t.a))
+            return false;
+    } else if (isText(f[0], "var")) {
+        return readDefinition(in_function ? VAR : GVAR, f, count);
+    } else if (isText(f[0], "para")) {
+        return readDefinition(PARA, f, count);
+    } else if (isText(f[0], "temp")) {
+        return readDefinition(TEMP, f, count);
+    } else if (count == 3 && (isText(f[0], "push") ||
+                isText(f[0], "printf") || isText(f[0], "scanf"))) {
+        DataType dtype;
+        t.op = isText(f[0], "push") ? PUSH : isText(f[0], "printf") ? WRITE : READ;
+        if (!parseType(f[1], dtype) || !parseValue(f[2], t.b))
+            return false;
+        t.a = typeOperand(dtype);
+    } else if (count == 2 && isText(f[0], "getret")) {
+        t.op = GETRET;
+        if (!parseValue(f[1], t.res))
+            return false;
+    } else if (count == 2 && (isText(f[0], "call") || isText(f[0], "ret") ||
+                isText(f[0], "label") || isText(f[0], "goto"))) {
+        t.op = isText(f[0], "call") ? CALL : isText(f[0], "ret") ? RET :
+            isText(f[0], "label") ? LABEL : GOTO;
+        // only a void function returns nothing
+        if (t.op == RET ? !parseOperand(f[1], t.a) : !parseValue(f[1], t.a))
+            return false;
+    } else if (count == 4 && (isText(f[0], "bz") || isText(f[0], "bnz"))) {
+        t.op = isText(f[0], "bz") ? BZ : BNZ;
+        if (!parseValue(f[1], t.a) || f[2].length != 0 || f[3].length != 0)
+            return false;
+    } else if (count == 1 && isText(f[0], "end")) {
+        if (!in_function)
+            return false;
+        mid_codes.push(t);
+        tabLayoutFrame(function);
+        FunctionScope scope = tabTakeScope();
+        tabKeepScope(scope);
+        in_function = false;
+        return true;
+    } else {
+        return false;
+    }
+    if (!in_function)
+        return false;
+    mid_codes.push(t);
+    return true;
+}
+
+/* string $STRING_n "text", strings are in order of labels */
+static bool readString(const char *line, size_t length)
+{
+    const char *end = line + length;
+    const char *quote = static_cast<const char *>(memchr(line, '\"', length));
+    Operand label;
+    // "string " is followed by the label
+    const char *begin = line + 7;
+    if (quote == NULL || quote <= begin || quote[-1] != ' ' ||
+            quote == end - 1 || end[-1] != '\"' ||
+            !parseOperand(begin, quote - 1 - begin, label) ||
+            label.kind != OPD_STRING)
+        return false;
+    return string2label(std::string(quote + 1, end - 1)) == label.value;
+}
+
+/* res = a, res = a op b, res = a[b] or a[b] = res */
+static bool readAssign(const Field *f, size_t count)
+{
+    FourTuple t = { ASSIGN, NONE, NONE, NONE };
+    if (count == 5) {
+        if (f[3].length != 1)
+            return false;
+        switch (f[3].text[0]) {
+            case '+':   t.op = ADD; break;
+            case '-':   t.op = SUB; break;
+            case '*':   t.op = MUL; break;
+            case '/':   t.op = DIV; break;
+            default:    return false;
+        }
+        if (!parseValue(f[0], t.res) || !parseValue(f[2], t.a) ||
+                !parseValue(f[4], t.b))
+            return false;
+    } else if (count != 3) {
+        return false;
+    } else if (memchr(f[0].text, '[', f[0].length) != NULL) {
+        t.op = WARRAY;
+        if (!parseSubscript(f[0], t.a, t.b) || !parseValue(f[2], t.res))
+            return false;
+    } else if (f[2].length != 0 && f[2].text[0] != '\'' &&
+            memchr(f[2].text, '[', f[2].length) != NULL) {
+        t.op = RARRAY;
+        if (!parseValue(f[0], t.res) || !parseSubscript(f[2], t.a, t.b))
+            return false;
+    } else {
+        if (!parseValue(f[0], t.res) || !parseValue(f[2], t.a))
+            return false;
+    }
+    if (!in_function)
+        return false;
+    mid_codes.push(t);
+    return true;
+}
+
+/* type name(), a new local scope begins */
+static bool readFunction(const Field *f)
+{
+    DataType dtype;
+    if (in_function || !parseType(f[0], dtype) || dtype == DT_STR)
+        return false;
+    Name id = intern(f[1].text, f[1].length - 2);
+    TabEntry entry = { GLOBAL, IT_FUNCTION, dtype, -1, -1 };
+    TabHandle handle = tabInsert(id, entry);
+    if (handle == TAB_NONE)
+        return false;
+    SavedScope empty = { NULL, NULL, 0 };
+    tabRestoreScope(empty, next_temp);
+    in_function = true;
+    function = id;
+    first_temp = next_temp;
+    FourTuple t = { FUNC, typeOperand(dtype), varOperand(handle), NONE };
+    mid_codes.push(t);
+    return true;
+}
+
+/* var type name [size], para type name or temp type $t_n */
+static bool readDefinition(OpCode op, const Field *f, size_t count)
+{
+    DataType dtype;
+    if (count != (op == GVAR || op == VAR ? 4u : 3u) ||
+            !parseType(f[1], dtype) || dtype == DT_VOID || dtype == DT_STR ||
+            f[2].length == 0 || (op != GVAR && !in_function))
+        return false;
+    FourTuple t = { op, typeOperand(dtype), NONE, NONE };
+    if (op == TEMP) {
+        if (!parseOperand(f[2], t.b) || t.b.kind != OPD_TEMP ||
+                t.b.value < first_temp)
+            return false;
+        tabInsertTemp(t.b.value, dtype);
+        next_temp = std::max(next_temp, t.b.value + 1);
+        mid_codes.push(t);
+        return true;
+    }
+    TabEntry entry = { op == GVAR ? GLOBAL : LOCAL, IT_VARIABLE, dtype, -1, -1 };
+    if (op != PARA && f[3].length != 0) {
+        if (!parseOperand(f[3], t.res) || t.res.kind != OPD_INT ||
+                t.res.value <= 0)
+            return false;
+        entry.itype = IT_ARRAY;
+        entry.value = t.res.value;
+    }
+    TabHandle handle = tabInsert(intern(f[2].text, f[2].length), entry);
+    if (handle == TAB_NONE)
+        return false;
+    t.b = varOperand(handle);
+    mid_codes.push(t);
+    return true;
+}
+
+/**
+ * Split `line` by ' ', empty fields are kept. A char literal is
+ * 3 characters, which may be ' '.
+ */
+static bool splitFields(const char *line, size_t length, Field *f,
+        size_t &count)
+{
+    size_t pos = 0;
+    count = 0;
+    for (;;) {
+        size_t begin = pos;
+        while (pos < length && line[pos] != ' ')
+            pos += (line[pos] == '\'' ? 3 : 1);
+        if (pos > length || count == MAX_FIELDS)
+            return false;
+        f[count].text = line + begin;
+        f[count].length = pos - begin;
+        count++;
+        if (pos == length)
+            return true;
+        pos++;      // skip ' '
+    }
+}
+
+static bool parseOperand(const Field &f, Operand &t)
+{
+    return parseOperand(f.text, f.length, t);
+}
+
+/* an operand which can't be left out, an empty field is NONE */
+static bool parseValue(const Field &f, Operand &t)
+{
+    return f.length != 0 && parseOperand(f, t);
+}
+
+static bool parseOperand(const char *text, size_t length, Operand &t)
+{
+    static const struct {
+        const char     *prefix;
+        OperandKind     kind;
+    } NUMBERED[] = {
+        { "$t_", OPD_TEMP }, { "$LABEL_", OPD_LABEL },
+        { "$STRING_", OPD_STRING }, { "$ELSE_", OPD_ELSE },
+        { "$IF_", OPD_IF },
+    };
+    if (length == 0) {
+        t = NONE;
+        return true;
+    }
+    if (text[0] == '\'') {
+        t = makeOperand(OPD_CHAR, (unsigned char)text[1]);
+        return length == 3 && text[2] == '\'';
+    }
+    if (text[0] == '-' || (text[0] >= '0' && text[0] <= '9')) {
+        t.kind = OPD_INT;
+        return parseNumber(text, length, t.value);
+    }
+    if (text[0] == '$') {
+        for (const auto &numbered : NUMBERED) {
+            size_t n = strlen(numbered.prefix);
+            if (length <= n || memcmp(text, numbered.prefix, n) != 0)
+                continue;
+            t.kind = numbered.kind;
+            if (t.kind == OPD_IF && length > n + 4 &&
+                    memcmp(text + length - 4, "_END", 4) == 0) {
+                t.kind = OPD_IF_END;
+                length -= 4;
+            }
+            return parseNumber(text + n, length - n, t.value) && t.value >= 0;
+        }
+        return false;
+    }
+    TabHandle handle = tabLookup(intern(text, length));
+    t = varOperand(handle);
+    return handle != TAB_NONE;
+}
+
+/* array[index] */
+static bool parseSubscript(const Field &f, Operand &array, Operand &index)
+{
+    const char *bracket = static_cast<const char *>(
+            memchr(f.text, '[', f.length));
+    size_t pos = bracket - f.text;
+    return pos != 0 && f.text[f.length - 1] == ']' &&
+        parseOperand(f.text, pos, array) && array.kind == OPD_VAR &&
+        parseOperand(bracket + 1, f.length - pos - 2, index) &&
+        index.kind != OPD_NONE;
+}
+
+static bool parseNumber(const char *text, size_t length, int &value)
+{
+    bool negative = (length != 0 && text[0] == '-');
+    size_t pos = negative ? 1 : 0;
+    if (pos == length)
+        return false;
+    long long n = 0;
+    for (; pos < length; pos++) {
+        if (text[pos] < '0' || text[pos] > '9')
+            return false;
+        n = n * 10 + (text[pos] - '0');
+        if (n > 0x80000000LL)
+            return false;
+    }
+    n = negative ? -n : n;
+    if (n > 0x7fffffffLL)
+        return false;
+    value = (int)n;
+    return true;
+}
+
+static bool parseType(const Field &f, DataType &dtype)
+{
+    for (int i = DT_VOID; i <= DT_STR; i++) {
+        if (isText(f, dtype2midtype[i].c_str())) {
+            dtype = (DataType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parseRelation(const Field &f, Relation &rel)
+{
+    for (int i = REL_EQL; i <= REL_GEQ; i++) {
+        if (isText(f, rel2str[i].c_str())) {
+            rel = (Relation)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isText(const Field &f, const char *text)
+{
+    return f.length == strlen(text) && memcmp(f.text, text, f.length) == 0;
+}
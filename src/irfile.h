@@ -0,0 +1,56 @@
+/**
+ * This module saves and loads mid-code, so that the code generator
+ * can run without the front end, e.g. on cached front end results.
+ *
+ * Two formats are loaded:
+ *  * binary IR written by saveBinaryIR() (`--emit-ir=bin`), which
+ *    holds mid-code arrays, symbol tables and strings as they are
+ *    in memory, so loading doesn't parse anything
+ *  * mid_code.txt, whose declarations (var, para, temp, functions
+ *    and strings) are defined again in the symbol tables in order,
+ *    which gives the same frame layout as the front end did
+ *
+ * Both are trusted to be written by this compiler: syntax and names
+ * are checked, but not whether codes are in an order code generator
+ * expects.
+ */
+#ifndef IRFILE_H_
+#define IRFILE_H_
+
+#include <string>
+
+/**
+ * Binary IR layout, all numbers in host byte order. Arrays of 4-byte
+ * items come first after the header and byte arrays come last, so
+ * every array is aligned when the file is mapped to memory:
+ *
+ *   IrHeader
+ *   int32   values[codes * 3]      operands, see MidCodes
+ *   IrEntry globals[globals]       global table in order of handles
+ *   IrScope scopes[scopes]         kept function scopes
+ *   IrEntry locals[locals]         entries of scopes one after another
+ *   uint32  temps[temps]           temp var handles of scopes
+ *   uint32  name_ends[names]       end of each name in `text`
+ *   uint32  string_ends[strings]   end of each string in `text`
+ *   uint8   ops[codes]
+ *   uint8   kinds[codes * 3]
+ *   char    text[text_bytes]       names, then strings
+ *
+ * Names in entries and scopes are indexes to names, name 0 is "".
+ */
+#define IR_MAGIC        "C0IR"
+#define IR_VERSION      1
+
+/**
+ * Write mid-codes with symbol tables and strings to `filename`,
+ * return false if it can't be written.
+ */
+bool saveBinaryIR(const std::string &filename);
+/**
+ * Load mid-codes, symbol tables and strings for convertToMIPS()
+ * from the loaded source, which is a binary IR file or mid_code.txt.
+ * Print what's wrong and return false if it can't be loaded.
+ */
+bool loadIR();
+
+#endif // IRFILE_H_
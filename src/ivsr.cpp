@@ -0,0 +1,277 @@
+#include <vector>       // vector
+#include <map>          // map
+#include <utility>      // swap
+#include <algorithm>    // max
+#include <climits>      // INT_MAX, INT_MIN
+#include <cstdlib>      // llabs
+#include "ivsr.h"
+#include "dom.h"
+#include "table.h"
+
+
+/* basic induction variable, of a phi */
+struct Induction {
+    Operand     init;       // value entering the loop
+    int         next;       // name from the latch
+    int         step;
+};
+
+/* variable s holding i * k */
+struct Product {
+    int         iv;         // phi of i
+    Operand     k;
+    int         phi;        // name of s in the loop
+    int         next;       // from the latch
+};
+
+static bool findStep(const SsaFunction &f, int phi, int next, int &step);
+static void replaceTest(SsaFunction &f, const Loop &loop,
+        const std::map<int, Induction> &ivs,
+        const std::vector<Product> &products);
+static int newVariable(SsaFunction &f, std::vector<FourTuple> &decls);
+static int newName(SsaFunction &f, int var, int block, int def);
+static int wrapMul(int x, int y);
+static Relation mirror(Relation rel);
+
+
+void reduceStrength(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    LoopForest forest;
+    findLoops(cfg, f.dom, forest);
+    std::vector<int> to(f.codes.size(), -1);
+    std::vector<std::vector<FourTuple> > added(cfg.blocks.size());
+    std::vector<Operand> replaced(f.names.size(), NONE);
+    std::vector<bool> in_loop;
+    std::map<int, Induction> ivs;
+    std::vector<Product> products;
+    bool changed = false;
+
+    for (const Loop &loop : forest.loops) {
+        if (loop.preheader < 0 || loop.latches.size() != 1)
+            continue;
+        int latch = loop.latches[0];
+        int from_pre = predIndex(cfg, loop.preheader, loop.header);
+        int from_latch = predIndex(cfg, latch, loop.header);
+        in_loop.assign(cfg.blocks.size(), false);
+        for (int b : loop.blocks)
+            in_loop[b] = true;
+        ivs.clear();
+        for (const Phi &phi : f.phis[loop.header]) {
+            Operand next = phi.args[from_latch];
+            int step;
+            if (next.kind == OPD_SSA && in_loop[f.names[next.value].block] &&
+                    findStep(f, phi.name, next.value, step))
+                ivs[phi.name] = Induction{ phi.args[from_pre], next.value, step };
+        }
+
+        products.clear();
+        for (int b : loop.blocks) {
+            // s is stepped every time around, so must its product be
+            if (!f.dom.dominates(b, latch))
+                continue;
+            const BasicBlock &block = cfg.blocks[b];
+            for (size_t i = block.begin; i < block.end; i++) {
+                Operand x = f.codes.operand(i, SLOT_A);
+                Operand k = f.codes.operand(i, SLOT_B);
+                Operand res = f.codes.operand(i, SLOT_RES);
+                if (f.codes.op(i) != MUL || to[i] >= 0 || res.kind != OPD_SSA)
+                    continue;
+                if (x.kind != OPD_SSA || ivs.count(x.value) == 0)
+                    std::swap(x, k);
+                if (x.kind != OPD_SSA || ivs.count(x.value) == 0)
+                    continue;
+                const Induction &iv = ivs[x.value];
+                int kv;
+                bool literal = isConstValue(k, kv);
+                if (!literal && (k.kind != OPD_SSA ||
+                        in_loop[f.names[k.value].block] ||
+                        (iv.step != 1 && iv.step != -1)))
+                    continue;
+                if (literal && kv == 1) {
+                    // i * 1 is i, the code is dead now
+                    replaced[res.value] = x;
+                    changed = true;
+                    continue;
+                }
+
+                size_t p = 0;
+                while (p < products.size() &&
+                        (products[p].iv != x.value || products[p].k != k))
+                    p++;
+                if (p < products.size()) {
+                    // the code is dead now
+                    replaced[res.value] = makeOperand(OPD_SSA, products[p].phi);
+                    changed = true;
+                    continue;
+                }
+                int var = newVariable(f, added[loop.preheader]);
+                int s0 = newName(f, var, loop.preheader, i);
+                int s1 = newName(f, var, loop.header, SSA_PHI);
+                int s2 = newName(f, var, latch, SSA_DEAD);
+                Phi phi = { s1, std::vector<Operand>(
+                        cfg.blocks[loop.header].preds.size(), NONE) };
+                phi.args[from_pre] = makeOperand(OPD_SSA, s0);
+                phi.args[from_latch] = makeOperand(OPD_SSA, s2);
+                f.phis[loop.header].push_back(phi);
+                products.push_back(Product{ x.value, k, s1, s2 });
+
+                // the code computes s entering the loop, in the preheader
+                f.names[res.value].def = SSA_DEAD;
+                int init;
+                if (literal && isConstValue(iv.init, init))
+                    f.codes.set(i, FourTuple{ ASSIGN,
+                            intOperand(wrapMul(init, kv)), NONE,
+                            makeOperand(OPD_SSA, s0) });
+                else
+                    f.codes.set(i, FourTuple{ MUL, iv.init, k,
+                            makeOperand(OPD_SSA, s0) });
+                to[i] = loop.preheader;
+                FourTuple step = { ADD, makeOperand(OPD_SSA, s1), k,
+                    makeOperand(OPD_SSA, s2) };
+                int by = wrapMul(iv.step, kv);
+                if (literal && by < 0 && by != INT_MIN)
+                    step = FourTuple{ SUB, step.a, intOperand(-by), step.res };
+                else if (literal)
+                    step.b = intOperand(by);
+                else if (iv.step == -1)
+                    step.op = SUB;
+                added[latch].push_back(step);
+                replaced.resize(f.names.size(), NONE);
+                replaced[res.value] = makeOperand(OPD_SSA, s1);
+                changed = true;
+            }
+        }
+        replaceTest(f, loop, ivs, products);
+    }
+    if (!changed)
+        return;
+
+    auto replace = [&](Operand t) {
+        return t.kind == OPD_SSA && replaced[t.value] != NONE ?
+            replaced[t.value] : t;
+    };
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (usesSlot(op, (OperandSlot)slot) && replace(t) != t)
+                    f.codes.setOperand(i, (OperandSlot)slot, replace(t));
+            }
+        }
+        for (Phi &phi : f.phis[b]) {
+            for (Operand &arg : phi.args)
+                arg = replace(arg);
+        }
+    }
+    moveCodes(f, to, added);
+}
+
+/**
+ * `next` is `phi` plus or minus a literal, the step. Copies are seen
+ * through, lowering assigns the sum to a temp var first.
+ */
+static bool findStep(const SsaFunction &f, int phi, int next, int &step)
+{
+    int i = f.names[next].def;
+    while (i >= 0 && f.codes.op(i) == ASSIGN &&
+            f.codes.operand(i, SLOT_A).kind == OPD_SSA)
+        i = f.names[f.codes.operand(i, SLOT_A).value].def;
+    if (i < 0)
+        return false;
+    Operand a = f.codes.operand(i, SLOT_A);
+    Operand b = f.codes.operand(i, SLOT_B);
+    Operand x = makeOperand(OPD_SSA, phi);
+    switch (f.codes.op(i)) {
+        case ADD:
+            if (a == x && isConstValue(b, step))
+                return step != 0;
+            return b == x && isConstValue(a, step) && step != 0;
+        case SUB:
+            if (a != x || !isConstValue(b, step) || step == INT_MIN)
+                return false;
+            step = -step;
+            return step != 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Rewrite the test of `i` at the end of the latch to test a product
+ * of it by a literal instead. It's the same if i goes from a literal
+ * toward the bound, and no i * k on the way overflows.
+ */
+static void replaceTest(SsaFunction &f, const Loop &loop,
+        const std::map<int, Induction> &ivs,
+        const std::vector<Product> &products)
+{
+    const BasicBlock &block = f.cfg.blocks[loop.latches[0]];
+    if (block.end - block.begin < 2 || f.codes.op(block.end - 1) != BNZ ||
+            block.succs.back() != loop.header)
+        return;
+    size_t i = block.end - 2;
+    Operand x = f.codes.operand(i, SLOT_A);
+    Operand bound = f.codes.operand(i, SLOT_RES);
+    Relation rel = (Relation)f.codes.operand(i, SLOT_B).value;
+    if (x.kind != OPD_SSA) {
+        std::swap(x, bound);
+        rel = mirror(rel);
+    }
+    int n, init;
+    if (x.kind != OPD_SSA || !isConstValue(bound, n))
+        return;
+    for (const Product &p : products) {
+        const Induction &iv = ivs.at(p.iv);
+        int k;
+        if (iv.next != x.value || !isConstValue(p.k, k) || k == 0 ||
+                !isConstValue(iv.init, init))
+            continue;
+        bool toward = (iv.step > 0 ? rel == REL_LSS || rel == REL_LEQ :
+                rel == REL_GTR || rel == REL_GEQ);
+        long long most = std::max(std::llabs(init), std::llabs(n)) +
+            std::llabs(iv.step);
+        if (!toward || most * std::llabs(k) > INT_MAX)
+            continue;
+        f.codes.set(i, FourTuple{ COMPARE, makeOperand(OPD_SSA, p.next),
+                relOperand(k > 0 ? rel : mirror(rel)), intOperand(n * k) });
+        return;
+    }
+}
+
+/* a new temp var for SSA names, declared by a code in `decls` */
+static int newVariable(SsaFunction &f, std::vector<FourTuple> &decls)
+{
+    Operand t = makeOperand(OPD_TEMP, tabNextTemp());
+    int var = tabInsertTemp(t.value, DT_INT) & ~TAB_LOCAL;
+    if ((size_t)var >= f.vars.size())
+        f.vars.resize(var + 1, NONE);
+    f.vars[var] = t;
+    decls.push_back(FourTuple{ TEMP, typeOperand(DT_INT), t, NONE });
+    return var;
+}
+
+static int newName(SsaFunction &f, int var, int block, int def)
+{
+    f.names.push_back(SsaName{ var, block, def });
+    return f.names.size() - 1;
+}
+
+static int wrapMul(int x, int y)
+{
+    return (int)((unsigned)x * (unsigned)y);
+}
+
+/* `a rel b` is `b mirror(rel) a` */
+static Relation mirror(Relation rel)
+{
+    switch (rel) {
+        case REL_LSS:   return REL_GTR;
+        case REL_LEQ:   return REL_GEQ;
+        case REL_GTR:   return REL_LSS;
+        case REL_GEQ:   return REL_LEQ;
+        default:        return rel;
+    }
+}
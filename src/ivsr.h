@@ -0,0 +1,32 @@
+/**
+ * This module reduces multiplications by induction variables of
+ * loops in a function in SSA form to additions.
+ *
+ * A basic induction variable is a phi of a loop header whose value
+ * from the latch is the phi plus or minus a literal c. A code run
+ * every time around the loop (its block dominates the latch) computing
+ * `i * k`, where k is a literal or a name defined out of the loop,
+ * gets a new variable s holding i * k: the code itself
+ * goes to the preheader computing s from the value i enters the loop
+ * with, a phi of s is added to the header, and the latch steps s by
+ * c * k (by k if c is 1 or -1 and k is a name). Products of the same
+ * i and k share one, i * 1 is just i. Values wrap at 32 bits, so s is always exactly
+ * i * k.
+ *
+ * The loop test `i rel N` in the latch, against a literal N, is then
+ * rewritten as `s rel N * k` (the relation flipped if k < 0), if i
+ * starts from a literal and moves toward N, so that no value of i *
+ * k may overflow. If nothing else uses i, dead code elimination
+ * removes it with its phi.
+ *
+ * Array indexes are element numbers here, they are multiplied by 4
+ * by the code generator with a shift, see mips.cpp.
+ */
+#ifndef IVSR_H_
+#define IVSR_H_
+
+#include "ssa.h"
+
+void reduceStrength(SsaFunction &f);
+
+#endif // IVSR_H_
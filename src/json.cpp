@@ -0,0 +1,305 @@
+#include <string>       // string
+#include <vector>       // vector
+#include <cstdio>       // snprintf()
+#include <cstdlib>      // strtod()
+#include <cmath>        // floor()
+#include <cctype>       // isdigit()
+#include "json.h"
+
+
+/**
+ * Nesting of values is bounded, so a bad message can't
+ * overflow the native stack of the recursive parser.
+ */
+#define JSON_MAX_DEPTH      256
+
+/* file-scope global variables, the text being parsed */
+static const char  *cur = NULL;
+static const char  *end = NULL;
+
+static bool parseValue(JsonValue &value, int depth);
+static bool parseString(std::string &s);
+static bool parseHex4(unsigned int &code);
+static bool parseNumber(double &number);
+static void skipBlanks();
+static bool skipWord(const char *word);
+static void appendUtf8(std::string &s, unsigned int code);
+
+
+const JsonValue &JsonValue::operator[](const char *key) const
+{
+    static const JsonValue NULL_VALUE;
+    for (const auto &member : members) {
+        if (member.first == key)
+            return member.second;
+    }
+    return NULL_VALUE;
+}
+
+bool parseJson(const std::string &text, JsonValue &value)
+{
+    cur = text.data();
+    end = cur + text.size();
+    value = JsonValue();
+    if (!parseValue(value, 0))
+        return false;
+    skipBlanks();
+    return cur == end;
+}
+
+static bool parseValue(JsonValue &value, int depth)
+{
+    if (depth == JSON_MAX_DEPTH)
+        return false;
+    skipBlanks();
+    if (cur == end)
+        return false;
+    switch (*cur) {
+        case '{':
+            value.type = JsonValue::JSON_OBJECT;
+            cur++;
+            skipBlanks();
+            if (cur != end && *cur == '}') {
+                cur++;
+                return true;
+            }
+            for (;;) {
+                std::pair<std::string, JsonValue> member;
+                skipBlanks();
+                if (!parseString(member.first))
+                    return false;
+                skipBlanks();
+                if (cur == end || *cur++ != ':')
+                    return false;
+                if (!parseValue(member.second, depth + 1))
+                    return false;
+                value.members.push_back(std::move(member));
+                skipBlanks();
+                if (cur == end)
+                    return false;
+                if (*cur == '}') {
+                    cur++;
+                    return true;
+                }
+                if (*cur++ != ',')
+                    return false;
+            }
+        case '[':
+            value.type = JsonValue::JSON_ARRAY;
+            cur++;
+            skipBlanks();
+            if (cur != end && *cur == ']') {
+                cur++;
+                return true;
+            }
+            for (;;) {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back(), depth + 1))
+                    return false;
+                skipBlanks();
+                if (cur == end)
+                    return false;
+                if (*cur == ']') {
+                    cur++;
+                    return true;
+                }
+                if (*cur++ != ',')
+                    return false;
+            }
+        case '\"':
+            value.type = JsonValue::JSON_STRING;
+            return parseString(value.str);
+        case 't':
+            value.type = JsonValue::JSON_BOOL;
+            value.boolean = true;
+            return skipWord("true");
+        case 'f':
+            value.type = JsonValue::JSON_BOOL;
+            return skipWord("false");
+        case 'n':
+            return skipWord("null");
+        default:
+            value.type = JsonValue::JSON_NUMBER;
+            return parseNumber(value.number);
+    }
+}
+
+static bool parseString(std::string &s)
+{
+    if (cur == end || *cur++ != '\"')
+        return false;
+    while (cur != end && *cur != '\"') {
+        if ((unsigned char)*cur < 0x20)
+            return false;
+        if (*cur != '\\') {
+            s.push_back(*cur++);
+            continue;
+        }
+        if (++cur == end)
+            return false;
+        char c = *cur++;
+        switch (c) {
+            case '\"': case '\\': case '/': s.push_back(c); break;
+            case 'b': s.push_back('\b'); break;
+            case 'f': s.push_back('\f'); break;
+            case 'n': s.push_back('\n'); break;
+            case 'r': s.push_back('\r'); break;
+            case 't': s.push_back('\t'); break;
+            case 'u': {
+                unsigned int code, low;
+                if (!parseHex4(code))
+                    return false;
+                // a surrogate pair is written as two escapes
+                const char *save = cur;
+                if (code >= 0xd800 && code < 0xdc00 && end - cur >= 6 &&
+                        cur[0] == '\\' && cur[1] == 'u') {
+                    cur += 2;
+                    if (parseHex4(low) && low >= 0xdc00 && low < 0xe000)
+                        code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                    else
+                        cur = save;
+                }
+                appendUtf8(s, code);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    if (cur == end)
+        return false;
+    cur++;
+    return true;
+}
+
+/* 4 hex digits of a "\uXXXX" escape */
+static bool parseHex4(unsigned int &code)
+{
+    code = 0;
+    for (int i = 0; i < 4; i++, cur++) {
+        if (cur == end)
+            return false;
+        char h = *cur;
+        int digit = (h >= '0' && h <= '9') ? h - '0' :
+            (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+            (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+        if (digit < 0)
+            return false;
+        code = code * 16 + digit;
+    }
+    return true;
+}
+
+static bool parseNumber(double &number)
+{
+    // strtod() accepts more than JSON does, which is harmless here,
+    // but it must not read past `end`
+    std::string text;
+    while (cur != end && (std::isdigit((unsigned char)*cur) ||
+                *cur == '-' || *cur == '+' || *cur == '.' ||
+                *cur == 'e' || *cur == 'E'))
+        text.push_back(*cur++);
+    if (text.empty())
+        return false;
+    char *stop = NULL;
+    number = std::strtod(text.c_str(), &stop);
+    return *stop == '\0';
+}
+
+static void skipBlanks()
+{
+    while (cur != end && (*cur == ' ' || *cur == '\t' ||
+                *cur == '\n' || *cur == '\r'))
+        cur++;
+}
+
+static bool skipWord(const char *word)
+{
+    for (; *word != '\0'; word++, cur++) {
+        if (cur == end || *cur != *word)
+            return false;
+    }
+    return true;
+}
+
+static void appendUtf8(std::string &s, unsigned int code)
+{
+    if (code < 0x80) {
+        s.push_back(code);
+    } else if (code < 0x800) {
+        s.push_back(0xc0 | (code >> 6));
+        s.push_back(0x80 | (code & 0x3f));
+    } else if (code < 0x10000) {
+        s.push_back(0xe0 | (code >> 12));
+        s.push_back(0x80 | ((code >> 6) & 0x3f));
+        s.push_back(0x80 | (code & 0x3f));
+    } else {
+        s.push_back(0xf0 | (code >> 18));
+        s.push_back(0x80 | ((code >> 12) & 0x3f));
+        s.push_back(0x80 | ((code >> 6) & 0x3f));
+        s.push_back(0x80 | (code & 0x3f));
+    }
+}
+
+
+std::string jsonText(const JsonValue &value)
+{
+    switch (value.type) {
+        case JsonValue::JSON_NULL:
+            return "null";
+        case JsonValue::JSON_BOOL:
+            return value.boolean ? "true" : "false";
+        case JsonValue::JSON_NUMBER: {
+            char buffer[32];
+            if (value.number == std::floor(value.number) &&
+                    value.number > -1e15 && value.number < 1e15)
+                std::snprintf(buffer, sizeof(buffer), "%.0f", value.number);
+            else
+                std::snprintf(buffer, sizeof(buffer), "%.17g", value.number);
+            return buffer;
+        }
+        case JsonValue::JSON_STRING:
+            return jsonQuote(value.str);
+        case JsonValue::JSON_ARRAY: {
+            std::string res = "[";
+            for (size_t i = 0; i < value.items.size(); i++) {
+                if (i != 0) res += ",";
+                res += jsonText(value.items[i]);
+            }
+            return res + "]";
+        }
+        case JsonValue::JSON_OBJECT: {
+            std::string res = "{";
+            for (size_t i = 0; i < value.members.size(); i++) {
+                if (i != 0) res += ",";
+                res += jsonQuote(value.members[i].first) + ":" +
+                    jsonText(value.members[i].second);
+            }
+            return res + "}";
+        }
+    }
+    return "null";
+}
+
+std::string jsonQuote(const std::string &s)
+{
+    std::string res = "\"";
+    for (char c : s) {
+        switch (c) {
+            case '\"': res += "\\\""; break;
+            case '\\': res += "\\\\"; break;
+            case '\n': res += "\\n"; break;
+            case '\r': res += "\\r"; break;
+            case '\t': res += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    res += buffer;
+                } else {
+                    res.push_back(c);
+                }
+        }
+    }
+    return res + "\"";
+}
@@ -0,0 +1,46 @@
+/**
+ * This is a minimal JSON reader and writer for the language server.
+ *
+ * Messages are parsed into a tree of JsonValue, replies are mostly
+ * written by hand with jsonQuote() for strings.
+ */
+#ifndef JSON_H_
+#define JSON_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+class JsonValue {
+public:
+    enum Type {
+        JSON_NULL,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    JsonValue(): type(JSON_NULL), boolean(false), number(0) {}
+
+    /* member `key` of an object, a null value if there is none */
+    const JsonValue &operator[](const char *key) const;
+    bool isNull() const { return type == JSON_NULL; }
+
+    Type        type;
+    bool        boolean;
+    double      number;
+    std::string str;
+    std::vector<JsonValue>  items;      // of an array
+    std::vector<std::pair<std::string, JsonValue>> members; // of an object
+};
+
+/* parse `text` as one JSON value, return false if it's not valid */
+bool parseJson(const std::string &text, JsonValue &value);
+/* write `value` back as JSON text */
+std::string jsonText(const JsonValue &value);
+/* `s` as a JSON string literal with quotes */
+std::string jsonQuote(const std::string &s);
+
+#endif // JSON_H_
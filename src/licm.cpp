@@ -0,0 +1,148 @@
+#include <vector>       // vector
+#include <map>          // map
+#include <set>          // set
+#include <utility>      // pair
+#include <cassert>      // assert
+#include "licm.h"
+#include "dom.h"
+#include "table.h"
+
+
+size_t insertPreheaders(const MidCodes &codes, size_t begin, MidCodes &out)
+{
+    assert(codes.op(begin) == FUNC);
+    size_t end = begin + 1;
+    while (codes.op(end) != END)
+        end++;
+    end++;
+    // last jump to each label, a loop's label is jumped back to
+    std::map<std::pair<int, int>, size_t> last_jump;
+    auto key = [&](size_t i) {
+        Operand label = codes.operand(i, SLOT_A);
+        return std::make_pair((int)label.kind, label.value);
+    };
+    for (size_t i = begin; i < end; i++) {
+        OpCode op = codes.op(i);
+        if (op == GOTO || op == BZ || op == BNZ)
+            last_jump[key(i)] = i;
+    }
+    for (size_t i = begin; i < end; i++) {
+        if (codes.op(i) == LABEL) {
+            auto it = last_jump.find(key(i));
+            if (it != last_jump.end() && it->second > i)
+                out.push(FourTuple{ LABEL, genLabel(), NONE, NONE });
+        }
+        out.push(codes[i]);
+    }
+    return end;
+}
+
+
+void hoistInvariants(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    LoopForest forest;
+    findLoops(cfg, f.dom, forest);
+    // block each code is moved to, and codes moved to each block
+    std::vector<int> to(f.codes.size(), -1);
+    std::vector<std::vector<size_t> > moved_in(cfg.blocks.size());
+    bool moved = false;
+
+    std::vector<bool> in_loop;
+    std::vector<size_t> codes;
+    std::vector<int> exits;
+    std::set<int> written;      // global variables and arrays
+    // inner loops first
+    for (size_t l = forest.loops.size(); l-- > 0; ) {
+        const Loop &loop = forest.loops[l];
+        if (loop.preheader < 0)
+            continue;
+        in_loop.assign(cfg.blocks.size(), false);
+        for (int b : loop.blocks)
+            in_loop[b] = true;
+        // codes of the loop in the order they run, and what they write
+        codes.clear();
+        exits.assign(loop.latches.begin(), loop.latches.end());
+        for (int b : cfg.rpo) {
+            if (!in_loop[b])
+                continue;
+            const BasicBlock &block = cfg.blocks[b];
+            for (size_t i = block.begin; i < block.end; i++) {
+                if (to[i] < 0)
+                    codes.push_back(i);
+            }
+            for (size_t i : moved_in[b]) {
+                if (to[i] == b)
+                    codes.push_back(i);
+            }
+            for (int s : block.succs) {
+                if (!in_loop[s])
+                    exits.push_back(b);
+            }
+        }
+        bool calls = false;
+        written.clear();
+        for (size_t i : codes) {
+            OpCode op = f.codes.op(i);
+            OperandSlot slot = defSlot(op);
+            if (op == CALL)
+                calls = true;
+            else if (op == WARRAY)
+                written.insert(f.codes.operand(i, SLOT_A).value);
+            else if (slot != SLOT_COUNT &&
+                    f.codes.operand(i, slot).kind == OPD_VAR)
+                written.insert(f.codes.operand(i, slot).value);
+        }
+
+        for (size_t i : codes) {
+            OpCode op = f.codes.op(i);
+            Operand res = f.codes.operand(i, SLOT_RES);
+            int divisor;
+            bool guarded = false;   // may read out of an array
+            switch (op) {
+                case ADD: case SUB: case MUL:
+                    break;
+                case DIV:
+                    if (!isConstValue(f.codes.operand(i, SLOT_B), divisor) ||
+                            divisor == 0 || divisor == -1)
+                        continue;
+                    break;
+                case RARRAY:
+                    guarded = true;
+                    break;
+                case ASSIGN:
+                    // copies of names are left to coalesceCopies()
+                    if (f.codes.operand(i, SLOT_A).kind != OPD_VAR)
+                        continue;
+                    break;
+                default:
+                    continue;
+            }
+            if (res.kind != OPD_SSA)
+                continue;
+            int block = f.names[res.value].block;
+            bool invariant = true;
+            for (int e : exits) {
+                if (guarded && !f.dom.dominates(block, e))
+                    invariant = false;
+            }
+            for (int slot = SLOT_A; slot <= SLOT_B; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind == OPD_SSA)
+                    invariant = invariant && !in_loop[f.names[t.value].block];
+                else if (t.kind == OPD_VAR)
+                    invariant = invariant && written.count(t.value) == 0 &&
+                        (((TabHandle)t.value & TAB_LOCAL) || !calls);
+            }
+            if (invariant) {
+                to[i] = loop.preheader;
+                f.names[res.value].block = loop.preheader;
+                moved_in[loop.preheader].push_back(i);
+                moved = true;
+            }
+        }
+    }
+    std::vector<std::vector<FourTuple> > added(cfg.blocks.size());
+    if (moved)
+        moveCodes(f, to, added);
+}
@@ -0,0 +1,35 @@
+/**
+ * This module hoists loop-invariant codes out of loops of a function
+ * in SSA form, to run once before the loop instead of each time.
+ *
+ * Before SSA form, each do-while loop gets a preheader: a new label
+ * just before the loop's label, so the block it begins falls through
+ * to the loop and is the only way in. A label no jump goes to is
+ * removed again by removeJumps() after the loop is optimized.
+ *
+ * An arithmetic code, a load of a global variable or an array read
+ * is invariant if its operands are: literals, names defined out of
+ * the loop or by invariant codes, and memory the loop doesn't write
+ * (no WARRAY to the array, no store to or READ of the global, and no
+ * call for globals). Its name is then defined in the preheader. The
+ * loop body runs at least once, but it may not run all of itself: a
+ * code that may trap or read out of an array is only hoisted if its
+ * block runs before any way out of the loop. Inner loops go first,
+ * so a code may go up through several preheaders.
+ */
+#ifndef LICM_H_
+#define LICM_H_
+
+#include <cstddef>      // size_t
+#include "midcode.h"
+#include "ssa.h"
+
+/**
+ * Copy the function whose FUNC is `codes[begin]` to the end of `out`,
+ * with a preheader for each loop. Return where the next one begins.
+ */
+size_t insertPreheaders(const MidCodes &codes, size_t begin, MidCodes &out);
+
+void hoistInvariants(SsaFunction &f);
+
+#endif // LICM_H_
@@ -0,0 +1,585 @@
+#include <iostream>     // cin, cout
+#include <string>       // string
+#include <vector>       // vector
+#include <map>          // map
+#include <algorithm>    // upper_bound(), stable_sort()
+#include <cstdlib>      // strtoul()
+#include "lsp.h"
+#include "json.h"
+#include "error.h"
+#include "grammar.h"
+#include "source.h"
+#include "symbol.h"
+#include "table.h"
+#include "midcode.h"
+#include "ast.h"
+
+
+#define NO_OFFSET   ((size_t)-1)
+
+/**
+ * A top-level definition found by splitItems(): global consts and
+ * variables end with ';' and a function ends with '}' of its body.
+ * Text is split by matching braces, skipping char and string
+ * literals the same way as lexer. It is only a guess of what parser
+ * sees, a function is parsed alone only if the guess agrees with
+ * where parser started and stopped on it.
+ */
+struct Item {
+    size_t          begin;      // first character
+    size_t          end;        // one past ';' or '}'
+    size_t          body;       // '{' of function body, or NO_OFFSET
+    bool            reparsable; // can be parsed again alone
+    size_t          stop;       // where lexer stops after the function
+    FunctionSpan    span;
+};
+
+/* a diagnostic with offsets in text of its document */
+struct Problem {
+    size_t          begin;
+    size_t          end;
+    bool            is_warning;
+    std::string     msg;
+};
+
+struct Document {
+    std::string             text;
+    int                     version;
+    std::vector<Item>       items;
+    std::vector<Problem>    problems;   // sorted by `begin`
+};
+
+static std::map<std::string, Document> documents;
+/* global symbol table and function spans are made from this one */
+static const Document *parsed_document = NULL;
+/* source code for lexer and line numbers, see loadDocument() */
+static const Document *loaded_document = NULL;
+static bool shutdown_requested = false;
+
+static bool readMessage(std::string &body);
+static void sendMessage(const std::string &body);
+static void sendResult(const JsonValue &id, const std::string &result);
+static void sendError(const JsonValue &id, int code, const std::string &msg);
+static void didOpen(const JsonValue &params);
+static void didChange(const JsonValue &params);
+static void didClose(const JsonValue &params);
+static void publishDiagnostics(const std::string &uri, const Document *doc);
+static void parseDocument(Document &doc);
+static bool parseFunction(Document &doc, size_t prefix, size_t suffix,
+        size_t old_length);
+static void shiftCounters(NameCounters &counters, const NameCounters &shift);
+static std::vector<Problem> takeProblems(const Document &doc);
+static void splitItems(const std::string &text, std::vector<Item> &items);
+static size_t matchBrace(const std::string &text, size_t body);
+static size_t skipLiteral(const std::string &text, size_t i);
+static void loadDocument(const Document &doc);
+static size_t offsetAt(const Document &doc,
+        unsigned int line_no, unsigned int pos);
+static size_t offsetOf(const Document &doc, const JsonValue &position);
+static std::string positionOf(const Document &doc, size_t offset);
+
+
+int runLanguageServer()
+{
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(NULL);
+    setServerMode(true);
+    std::string body;
+    while (readMessage(body)) {
+        JsonValue msg;
+        if (!parseJson(body, msg)) {
+            sendError(JsonValue(), -32700, "parse error");
+            continue;
+        }
+        const std::string &method = msg["method"].str;
+        const JsonValue &id = msg["id"];
+        const JsonValue &params = msg["params"];
+        if (method == "initialize") {
+            // documents are synchronized incrementally
+            sendResult(id, "{\"capabilities\":{\"textDocumentSync\":"
+                    "{\"openClose\":true,\"change\":2}},"
+                    "\"serverInfo\":{\"name\":\"c0-compiler\"}}");
+        } else if (method == "shutdown") {
+            shutdown_requested = true;
+            sendResult(id, "null");
+        } else if (method == "exit") {
+            return shutdown_requested ? 0 : 1;
+        } else if (method == "textDocument/didOpen") {
+            didOpen(params);
+        } else if (method == "textDocument/didChange") {
+            didChange(params);
+        } else if (method == "textDocument/didClose") {
+            didClose(params);
+        } else if (!id.isNull() && !method.empty()) {
+            sendError(id, -32601, "method not found: " + method);
+        }
+        // other notifications are ignored
+    }
+    return shutdown_requested ? 0 : 1;
+}
+
+
+/**
+ * A message is a header of "Content-Length: n" and other fields
+ * ended by an empty line, then n bytes of JSON.
+ */
+static bool readMessage(std::string &body)
+{
+    static const std::string LENGTH_FIELD = "Content-Length:";
+    std::string line;
+    size_t length = 0;
+    bool has_length = false;
+    for (;;) {
+        if (!std::getline(std::cin, line))
+            return false;
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty()) {
+            if (has_length)
+                break;
+            continue;
+        }
+        if (line.compare(0, LENGTH_FIELD.size(), LENGTH_FIELD) == 0) {
+            length = std::strtoul(line.c_str() + LENGTH_FIELD.size(), NULL, 10);
+            has_length = true;
+        }
+    }
+    body.resize(length);
+    if (length != 0)
+        std::cin.read(&body[0], length);
+    return (size_t)std::cin.gcount() == length || length == 0;
+}
+
+static void sendMessage(const std::string &body)
+{
+    std::cout << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+    std::cout.flush();
+}
+
+static void sendResult(const JsonValue &id, const std::string &result)
+{
+    sendMessage("{\"jsonrpc\":\"2.0\",\"id\":" + jsonText(id) +
+            ",\"result\":" + result + "}");
+}
+
+static void sendError(const JsonValue &id, int code, const std::string &msg)
+{
+    sendMessage("{\"jsonrpc\":\"2.0\",\"id\":" + jsonText(id) +
+            ",\"error\":{\"code\":" + std::to_string(code) +
+            ",\"message\":" + jsonQuote(msg) + "}}");
+}
+
+
+static void didOpen(const JsonValue &params)
+{
+    const JsonValue &item = params["textDocument"];
+    Document &doc = documents[item["uri"].str];
+    if (loaded_document == &doc)
+        loaded_document = NULL;
+    doc.text = item["text"].str;
+    doc.version = (int)item["version"].number;
+    parseDocument(doc);
+    publishDiagnostics(item["uri"].str, &doc);
+}
+
+/**
+ * Apply changes in order, each one replaces a range of text, or all
+ * text if there is no range. Text before `prefix` and the last
+ * `suffix` characters are the same as before.
+ */
+static void didChange(const JsonValue &params)
+{
+    const std::string &uri = params["textDocument"]["uri"].str;
+    auto it = documents.find(uri);
+    if (it == documents.end())
+        return;
+    Document &doc = it->second;
+    doc.version = (int)params["textDocument"]["version"].number;
+
+    size_t old_length = doc.text.size();
+    size_t prefix = NO_OFFSET;
+    size_t suffix = NO_OFFSET;
+    loadDocument(doc);
+    for (const JsonValue &change : params["contentChanges"].items) {
+        size_t begin = 0;
+        size_t end = doc.text.size();
+        if (!change["range"].isNull()) {
+            begin = offsetOf(doc, change["range"]["start"]);
+            end = std::max(begin, offsetOf(doc, change["range"]["end"]));
+        }
+        const std::string &text = change["text"].str;
+        prefix = std::min(prefix, begin);
+        suffix = std::min(suffix, doc.text.size() - end);
+        doc.text.replace(begin, end - begin, text);
+        editSourceText(doc.text.data(), doc.text.size(),
+                begin, end, begin + text.size());
+    }
+    if (prefix == NO_OFFSET) {
+        // nothing changed
+    } else if (!parseFunction(doc, prefix, suffix, old_length)) {
+        parseDocument(doc);
+    }
+    publishDiagnostics(uri, &doc);
+}
+
+static void didClose(const JsonValue &params)
+{
+    const std::string &uri = params["textDocument"]["uri"].str;
+    auto it = documents.find(uri);
+    if (it == documents.end())
+        return;
+    if (parsed_document == &it->second)
+        parsed_document = NULL;
+    if (loaded_document == &it->second) {
+        unloadSource();
+        loaded_document = NULL;
+    }
+    documents.erase(it);
+    publishDiagnostics(uri, NULL);
+}
+
+/* diagnostics of `doc`, or empty ones for a closed document */
+static void publishDiagnostics(const std::string &uri, const Document *doc)
+{
+    std::string body = "{\"jsonrpc\":\"2.0\","
+        "\"method\":\"textDocument/publishDiagnostics\","
+        "\"params\":{\"uri\":" + jsonQuote(uri);
+    if (doc != NULL)
+        body += ",\"version\":" + std::to_string(doc->version);
+    body += ",\"diagnostics\":[";
+    if (doc != NULL) {
+        loadDocument(*doc);
+        for (size_t i = 0; i < doc->problems.size(); i++) {
+            const Problem &p = doc->problems[i];
+            if (i != 0)
+                body += ",";
+            body += "{\"range\":{\"start\":" + positionOf(*doc, p.begin) +
+                ",\"end\":" + positionOf(*doc, p.end) + "},\"severity\":" +
+                (p.is_warning ? "2" : "1") + ",\"source\":\"c0\"," +
+                "\"message\":" + jsonQuote(p.msg) + "}";
+        }
+    }
+    body += "]}}";
+    sendMessage(body);
+}
+
+
+/* parse the whole document, as the compiler does */
+static void parseDocument(Document &doc)
+{
+    loadDocument(doc);
+    tabClear(GLOBAL);
+    NameCounters counters = { 0, 0, 0 };
+    setNameCounters(counters);
+    seekSource(0, 0);
+    takeDiagnostics();
+    try {
+        pProgram();
+    } catch (const CompileStop &) {
+        // errors after this point are not found by compiler either
+    }
+    ast_arena.clear();
+    doc.problems = takeProblems(doc);
+    splitItems(doc.text, doc.items);
+    parsed_document = &doc;
+
+    // a function can be parsed alone if parser started and stopped
+    // on it as expected, and no function names are duplicate, as
+    // parameters of a duplicate are added to the first one
+    const std::vector<FunctionSpan> &spans = functionSpans();
+    bool inserted = true;
+    for (const FunctionSpan &span : spans)
+        inserted = inserted && span.inserted;
+    size_t j = 0;
+    for (const FunctionSpan &span : spans) {
+        size_t begin = offsetAt(doc, span.line_no, span.word_pos);
+        while (j < doc.items.size() && doc.items[j].begin < begin)
+            j++;
+        if (j == doc.items.size())
+            break;
+        Item &item = doc.items[j];
+        if (item.begin != begin || item.body == NO_OFFSET ||
+                span.end_line_no == 0)
+            continue;
+        item.span = span;
+        item.stop = offsetAt(doc, span.end_line_no, span.end_word_pos);
+        size_t next = (j + 1 < doc.items.size() ?
+                doc.items[j + 1].begin : NO_OFFSET);
+        // lexer stops at '}' of main function, or the word after others
+        item.reparsable = inserted &&
+            item.stop == (span.is_main ? item.end - 1 : next);
+    }
+}
+
+/**
+ * Changes of text are between `prefix` and the last `suffix`
+ * characters. If they are all inside the body of one function,
+ * parse that function again and return true.
+ */
+static bool parseFunction(Document &doc, size_t prefix, size_t suffix,
+        size_t old_length)
+{
+    if (parsed_document != &doc || doc.items.empty())
+        return false;
+    // the last item beginning before the changes
+    auto found = std::upper_bound(doc.items.begin(), doc.items.end(), prefix,
+            [](size_t offset, const Item &item) {
+                return offset < item.begin;
+            });
+    if (found == doc.items.begin())
+        return false;
+    size_t k = found - doc.items.begin() - 1;
+    Item &item = doc.items[k];
+    // '{' and '}' of the body are not changed
+    if (!item.reparsable || item.body >= prefix ||
+            old_length - suffix > item.end - 1)
+        return false;
+    size_t delta = doc.text.size() - old_length;    // modulo 2^n
+    if (matchBrace(doc.text, item.body) != item.end + delta)
+        return false;
+
+    FunctionSpan span = item.span;
+    unsigned int line_no = sourceLineOf(item.begin);
+    span.line_no = line_no;
+    span.word_pos = item.begin - (sourceLineBegin(line_no) - doc.text.data());
+    takeDiagnostics();
+    size_t stop = NO_OFFSET;
+    try {
+        pFunctionAgain(span);
+        stop = offsetAt(doc, g_line_no, g_word_pos);
+        // as pProgram() does after main function
+        if (span.is_main)
+            extraCodeChecking();
+    } catch (const CompileStop &) {
+        // if it stops in the function, later ones are not parsed
+        // and `stop` is not set, so all is parsed again
+    }
+    ast_arena.clear();
+    std::vector<Problem> problems = takeProblems(doc);
+    if (stop != item.stop + delta)
+        return false;
+    // diagnostics between this item and the next one are replaced,
+    // those of later items are moved along with their text
+    size_t low = (k == 0 ? 0 : item.begin);
+    size_t high = (k + 1 < doc.items.size() ?
+            doc.items[k + 1].begin : NO_OFFSET);
+    for (const Problem &p : problems) {
+        if (p.begin < low || (high != NO_OFFSET && p.begin >= high + delta))
+            return false;
+    }
+    // temp vars of later functions are renumbered if this one has
+    // a different number of them, that's seen in a few messages
+    NameCounters counters = nameCounters();
+    NameCounters shift = {
+        counters.temps - item.span.end_counters.temps,
+        counters.labels - item.span.end_counters.labels,
+        counters.if_statements - item.span.end_counters.if_statements,
+    };
+    if (shift.temps != 0) {
+        for (const Problem &p : doc.problems) {
+            if (high != NO_OFFSET && p.begin >= high &&
+                    p.msg.find("$t_") != std::string::npos)
+                return false;
+        }
+    }
+    std::vector<Problem> res;
+    for (const Problem &p : doc.problems) {
+        if (p.begin < low)
+            res.push_back(p);
+    }
+    res.insert(res.end(), problems.begin(), problems.end());
+    for (const Problem &p : doc.problems) {
+        if (high != NO_OFFSET && p.begin >= high) {
+            res.push_back(p);
+            res.back().begin += delta;
+            res.back().end += delta;
+        }
+    }
+    doc.problems.swap(res);
+
+    item.end += delta;
+    item.stop += delta;
+    item.span.end_counters = counters;
+    for (size_t j = k + 1; j < doc.items.size(); j++) {
+        Item &t = doc.items[j];
+        t.begin += delta;
+        t.end += delta;
+        if (t.body != NO_OFFSET)
+            t.body += delta;
+        t.stop += delta;
+        shiftCounters(t.span.counters, shift);
+        shiftCounters(t.span.end_counters, shift);
+    }
+    return true;
+}
+
+static void shiftCounters(NameCounters &counters, const NameCounters &shift)
+{
+    counters.temps += shift.temps;
+    counters.labels += shift.labels;
+    counters.if_statements += shift.if_statements;
+}
+
+/* cached errors as problems of `doc`, which must be loaded */
+static std::vector<Problem> takeProblems(const Document &doc)
+{
+    std::vector<Problem> res;
+    for (const Diagnostic &d : takeDiagnostics()) {
+        unsigned int line_no = std::max(1u,
+                std::min(d.line_no, sourceLineCount()));
+        size_t line = sourceLineBegin(line_no) - doc.text.data();
+        unsigned int length = sourceLineLength(line_no);
+        // the word and the '~' mark after it, see printCachedErrors()
+        unsigned int begin = std::min(d.word_pos, length);
+        unsigned int end = std::max(d.word_pos + 1, d.pos >= 1 ? d.pos - 1 : 0);
+        Problem p;
+        p.begin = line + begin;
+        p.end = line + std::min(end, length);
+        p.is_warning = d.is_warning;
+        p.msg = d.msg;
+        while (!p.msg.empty() && p.msg.back() == '\n')
+            p.msg.pop_back();
+        res.push_back(p);
+    }
+    std::stable_sort(res.begin(), res.end(),
+            [](const Problem &a, const Problem &b) {
+                return a.begin < b.begin;
+            });
+    return res;
+}
+
+
+static void splitItems(const std::string &text, std::vector<Item> &items)
+{
+    items.clear();
+    Item item = Item();
+    item.begin = item.body = NO_OFFSET;
+    int depth = 0;
+    size_t i = 0;
+    while (i < text.size()) {
+        char c = text[i];
+        if (item.begin == NO_OFFSET) {
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                i++;
+                continue;
+            }
+            item.begin = i;
+        }
+        if (c == '\'' || c == '\"') {
+            i = skipLiteral(text, i);
+            continue;
+        }
+        i++;
+        if (c == '{' && depth++ == 0 && item.body == NO_OFFSET)
+            item.body = i - 1;
+        else if (c == '}' && depth > 0)
+            depth--;
+        if (depth == 0 && (c == ';' || c == '}')) {
+            item.end = i;
+            items.push_back(item);
+            item.begin = item.body = NO_OFFSET;
+        }
+    }
+    if (item.begin != NO_OFFSET) {
+        item.end = text.size();
+        items.push_back(item);
+    }
+}
+
+/* one past the '}' matching '{' at `body` */
+static size_t matchBrace(const std::string &text, size_t body)
+{
+    int depth = 0;
+    size_t i = body;
+    while (i < text.size()) {
+        char c = text[i];
+        if (c == '\'' || c == '\"') {
+            i = skipLiteral(text, i);
+            continue;
+        }
+        i++;
+        if (c == '{')
+            depth++;
+        else if (c == '}' && --depth == 0)
+            return i;
+    }
+    return NO_OFFSET;
+}
+
+/**
+ * Skip a literal beginning at `i`, a char literal is always 3
+ * characters, and a string ends at '\"' or the end of line.
+ */
+static size_t skipLiteral(const std::string &text, size_t i)
+{
+    if (text[i] == '\'')
+        return std::min(i + 3, text.size());
+    for (i++; i < text.size(); i++) {
+        char c = text[i];
+        if (c == '\n' || c == '\r')
+            return i;
+        if (c == '\"')
+            return i + 1;
+    }
+    return i;
+}
+
+
+/**
+ * Make `doc` the source code for lexer and line numbers, it stays
+ * loaded while it's edited, see editSourceText().
+ */
+static void loadDocument(const Document &doc)
+{
+    if (loaded_document == &doc)
+        return;
+    loadSourceText(doc.text.data(), doc.text.size());
+    loaded_document = &doc;
+}
+
+/* offset of column `pos` of line `line_no` */
+static size_t offsetAt(const Document &doc,
+        unsigned int line_no, unsigned int pos)
+{
+    line_no = std::max(1u, std::min(line_no, sourceLineCount()));
+    pos = std::min(pos, sourceLineLength(line_no));
+    return sourceLineBegin(line_no) - doc.text.data() + pos;
+}
+
+/**
+ * LSP positions are 0-based lines and UTF-16 code units in a line,
+ * a character beyond a line means the end of that line.
+ */
+static size_t offsetOf(const Document &doc, const JsonValue &position)
+{
+    unsigned int line_no = (unsigned int)position["line"].number + 1;
+    if (line_no > sourceLineCount())
+        return doc.text.size();
+    const char *line = sourceLineBegin(line_no);
+    unsigned int length = sourceLineLength(line_no);
+    unsigned int units = (unsigned int)position["character"].number;
+    unsigned int i = 0;
+    for (unsigned int n = 0; i < length && n < units; ) {
+        // 4-byte UTF-8 characters are 2 UTF-16 code units
+        n += ((unsigned char)line[i] >= 0xf0 ? 2 : 1);
+        i++;
+        while (i < length && ((unsigned char)line[i] & 0xc0) == 0x80)
+            i++;
+    }
+    return line - doc.text.data() + i;
+}
+
+static std::string positionOf(const Document &doc, size_t offset)
+{
+    unsigned int line_no = sourceLineOf(offset);
+    const char *line = sourceLineBegin(line_no);
+    size_t length = doc.text.data() + offset - line;
+    unsigned int units = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = line[i];
+        if ((c & 0xc0) != 0x80)
+            units += (c >= 0xf0 ? 2 : 1);
+    }
+    return "{\"line\":" + std::to_string(line_no - 1) +
+        ",\"character\":" + std::to_string(units) + "}";
+}
@@ -0,0 +1,21 @@
+/**
+ * This is a language server: with `--lsp`, the compiler speaks
+ * Language Server Protocol over stdin and stdout, and publishes
+ * errors found by parser as diagnostics while documents are edited.
+ *
+ * Documents are kept in memory and changed incrementally. After an
+ * edit inside the body of one function, only that function is parsed
+ * again (see pFunctionAgain()), diagnostics of other definitions are
+ * kept and moved along with their text. Any other edit parses the
+ * whole document again.
+ */
+#ifndef LSP_H_
+#define LSP_H_
+
+/**
+ * Serve until "exit" notification or end of input,
+ * return exit code of the process.
+ */
+int runLanguageServer();
+
+#endif // LSP_H_
@@ -0,0 +1,193 @@
+#include <vector>       // vector
+#include <map>          // map
+#include <tuple>        // tuple
+#include <utility>      // swap
+#include "lvn.h"
+#include "table.h"
+
+
+/* opcode, value numbers of operands, and memory state for RARRAY */
+typedef std::tuple<int, int, int, int> ExprKey;
+
+struct Numbering {
+    std::vector<int>            name_values;    // of SSA names, -1 if none
+    std::vector<Operand>        holders;        // name with each value
+    // the rest is of the block being numbered, a holder of a value
+    // found in the block dominates it
+    std::map<int, int>          const_values;
+    std::map<int, int>          global_values;  // of global variables
+    std::map<ExprKey, int>      exprs;
+    std::map<int, int>          array_writes;   // time of last WARRAY
+    int                         call_time;
+    int                         clock;
+};
+
+static int newValue(Numbering &n);
+static int valueOf(Numbering &n, const Operand &t);
+static void define(Numbering &n, const Operand &t, int value);
+static bool isGlobal(const Operand &t);
+
+
+void numberValues(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    Numbering n;
+    n.name_values.assign(f.names.size(), -1);
+    std::vector<Operand> replaced(f.names.size(), NONE);
+    std::vector<bool> removed(f.codes.size(), false);
+    auto replace = [&](Operand t) {
+        return t.kind == OPD_SSA && replaced[t.value] != NONE ?
+            replaced[t.value] : t;
+    };
+
+    // a name is replaced before its uses, which it dominates
+    for (int b : cfg.rpo) {
+        n.const_values.clear();
+        n.global_values.clear();
+        n.exprs.clear();
+        n.array_writes.clear();
+        n.call_time = n.clock = 0;
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (usesSlot(op, (OperandSlot)slot) && replace(t) != t)
+                    f.codes.setOperand(i, (OperandSlot)slot, replace(t));
+            }
+            Operand a = f.codes.operand(i, SLOT_A);
+            Operand res = f.codes.operand(i, SLOT_RES);
+
+            bool computes = false;
+            ExprKey key;
+            if (op == ADD || op == SUB || op == MUL || op == DIV) {
+                int x = valueOf(n, a);
+                int y = valueOf(n, f.codes.operand(i, SLOT_B));
+                if ((op == ADD || op == MUL) && y < x)
+                    std::swap(x, y);
+                key = ExprKey(op, x, y, 0);
+                computes = true;
+            } else if (op == RARRAY) {
+                int time = 0;
+                auto it = n.array_writes.find(a.value);
+                if (it != n.array_writes.end())
+                    time = it->second;
+                if (isGlobal(a) && n.call_time > time)
+                    time = n.call_time;
+                key = ExprKey(op, a.value,
+                        valueOf(n, f.codes.operand(i, SLOT_B)), time);
+                computes = true;
+            } else if (op == ASSIGN && isGlobal(a)) {
+                // a load of the global variable
+                auto it = n.global_values.find(a.value);
+                if (it != n.global_values.end() && res.kind == OPD_SSA &&
+                        n.holders[it->second].kind == OPD_SSA) {
+                    replaced[res.value] = n.holders[it->second];
+                    removed[i] = true;
+                } else {
+                    define(n, res, valueOf(n, a));
+                }
+                continue;
+            }
+
+            if (computes) {
+                auto it = n.exprs.find(key);
+                if (it == n.exprs.end()) {
+                    int value = newValue(n);
+                    n.exprs[key] = value;
+                    define(n, res, value);
+                    continue;
+                }
+                Operand holder = n.holders[it->second];
+                if (holder.kind != OPD_SSA) {
+                    define(n, res, it->second);
+                } else if (res.kind == OPD_SSA) {
+                    replaced[res.value] = holder;
+                    removed[i] = true;
+                } else {
+                    // stored to a variable not renamed
+                    f.codes.set(i, FourTuple{ ASSIGN, holder, NONE, res });
+                    define(n, res, it->second);
+                }
+                continue;
+            }
+
+            switch (op) {
+                case ASSIGN:
+                    define(n, res, valueOf(n, a));
+                    break;
+                case READ:
+                    define(n, f.codes.operand(i, SLOT_B), newValue(n));
+                    break;
+                case GETRET:
+                    define(n, res, newValue(n));
+                    break;
+                case WARRAY:
+                    n.array_writes[a.value] = ++n.clock;
+                    break;
+                case CALL:
+                    n.call_time = ++n.clock;
+                    n.global_values.clear();
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    for (int b : cfg.rpo) {
+        for (Phi &phi : f.phis[b]) {
+            for (Operand &arg : phi.args)
+                arg = replace(arg);
+        }
+    }
+    updateSSA(f, removed);
+}
+
+static int newValue(Numbering &n)
+{
+    n.holders.push_back(NONE);
+    return n.holders.size() - 1;
+}
+
+static int valueOf(Numbering &n, const Operand &t)
+{
+    int constant;
+    if (isConstValue(t, constant)) {
+        auto it = n.const_values.find(constant);
+        if (it != n.const_values.end())
+            return it->second;
+        return n.const_values[constant] = newValue(n);
+    }
+    if (t.kind == OPD_SSA) {
+        if (n.name_values[t.value] < 0) {
+            n.name_values[t.value] = newValue(n);
+            n.holders.back() = t;
+        }
+        return n.name_values[t.value];
+    }
+    if (isGlobal(t)) {
+        auto it = n.global_values.find(t.value);
+        if (it != n.global_values.end())
+            return it->second;
+        return n.global_values[t.value] = newValue(n);
+    }
+    return newValue(n);
+}
+
+/* the value is stored to `t`, which holds it from now on */
+static void define(Numbering &n, const Operand &t, int value)
+{
+    if (t.kind == OPD_SSA) {
+        n.name_values[t.value] = value;
+        if (n.holders[value] == NONE)
+            n.holders[value] = t;
+    } else if (isGlobal(t)) {
+        n.global_values[t.value] = value;
+    }
+}
+
+/* a global variable or array, a call may change it */
+static bool isGlobal(const Operand &t)
+{
+    return t.kind == OPD_VAR && !((TabHandle)t.value & TAB_LOCAL);
+}
@@ -0,0 +1,21 @@
+/**
+ * This module removes redundant computations in each basic block of
+ * a function in SSA form, by local value numbering.
+ *
+ * Operands get value numbers: literals by value, SSA names by what
+ * defines them, and global variables by the last value stored to
+ * them in the block. An arithmetic code, an array read or a load of a
+ * global variable computing a value some name already holds is
+ * removed, and its name replaced by that one, which is defined before
+ * it in the block and so dominates all its uses. `a + b` and `b + a`
+ * are the same. A WARRAY starts a new value of its array, a call new
+ * values of global variables and global arrays.
+ */
+#ifndef LVN_H_
+#define LVN_H_
+
+#include "ssa.h"
+
+void numberValues(SsaFunction &f);
+
+#endif // LVN_H_
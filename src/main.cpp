@@ -1,86 +1,160 @@
-#include <iostream>         // cout
-#include <cstdio>           // printf
-#include <unordered_map>    // unsorted_map
-#include <iomanip>          // setw
-#include <fstream>          // ifstream
-#include "symbol.h"
-#include "error.h"
-#include "common.h"
-#include "grammar.h"
-#include "mips.h"
-
-
-
-/* initialize global variables */
-Symbol          char2sym[128];
-std::unordered_map<std::string, Symbol> key2sym;
-std::string     source_filename;
-std::ifstream   source_stream;
-std::ostream    midcode_stream(NULL);
-std::ostream    mipscode_stream(NULL);
-std::ostream    opt_midcode_stream(NULL);
-std::ostream    opt_mipscode_stream(NULL);
-std::ostream    debug_stream(NULL);
-
-
-static void initialize();
-
-int main(int argc, char *argv[]) {
-    initialize();
-
-    source_filename = argc > 1 ? argv[1] : "hello_world.txt";
-    source_stream.open(source_filename);
-
-    //midcode_stream.rdbuf(std::cout.rdbuf());
-    std::string midcode_filename = "mid_code.txt";
-    std::string mipscode_filename = "mips_code.txt";
-    std::filebuf buffer1, buffer2;
-    buffer1.open(midcode_filename, std::ios_base::out);
-    buffer2.open(mipscode_filename, std::ios_base::out);
-    midcode_stream.rdbuf(&buffer1);
-    mipscode_stream.rdbuf(&buffer2);
-
-    // debug messages
-    debug_stream.rdbuf(std::cout.rdbuf());
-
-    // Do syntax check and generate mid-code
-    pProgram();
-
-    bool has_error = printCachedErrors();
-    if (has_error)
-        exit(1);
-        
-    std::cout << "compile success!\n";
-    std::cout << "mid code at: " << midcode_filename << std::endl;
-    // convert mid-code to MIPS code
-    convertToMIPS();
-    std::cout << "mips code at: " << mipscode_filename << std::endl;
-    std::cout << "\nIf you want to execute this mips program, using following command:\n"
-        << "    $ java -jar mars.jar nc mips_code.txt" << std::endl;
-
-    source_stream.close();
-    return 0;
-}
-
-static void initialize() 
-{
-    /* Initialize reserve word map */
-    key2sym["const"] = CONSTSY;     key2sym["int"] = INTSY;
-    key2sym["char"] = CHARSY;       key2sym["void"] = VOIDSY;
-    key2sym["if"] = IFSY;           key2sym["else"] = ELSESY;
-    key2sym["do"] = DOSY;           key2sym["while"] = WHILESY;
-    key2sym["switch"] = SWITCHSY;   key2sym["case"] = CASESY;   
-    key2sym["default"] = DEFAULTSY; key2sym["scanf"] = SCANFSY; 
-    key2sym["printf"] = PRINTFSY;   key2sym["return"] = RETURNSY; 
-    key2sym["main"] = MAINSY;
-    /* Initialize single character(special symbols) map */
-    char2sym['+'] = PLUS;       char2sym['-'] = MINUS;
-    char2sym['*'] = STAR;       char2sym['/'] = SLASH;
-    char2sym['<'] = LSS;        char2sym['>'] = GTR;
-    char2sym['('] = LPARENT;    char2sym[')'] = RPARENT;
-    char2sym['['] = LBRACK;     char2sym[']'] = RBRACK;
-    char2sym['{'] = LBRACE;     char2sym['}'] = RBRACE;
-    char2sym['='] = BECOMES;    char2sym[','] = COMMA;
-    char2sym[':'] = COLON;      char2sym[';'] = SEMICOLON;
-}
-
+#include <iostream>         // cout
+#include <cstdio>           // printf
+#include <unordered_map>    // unsorted_map
+#include <iomanip>          // setw
+#include <fstream>          // ifstream
+#include <thread>           // hardware_concurrency
+#include <algorithm>        // max
+#include <cstdlib>          // atoi
+#include "symbol.h"
+#include "error.h"
+#include "common.h"
+#include "grammar.h"
+#include "mips.h"
+#include "source.h"
+#include "ast.h"
+#include "lsp.h"
+#include "parallel.h"
+#include "irfile.h"
+#include "cfg.h"
+#include "optimize.h"
+
+
+
+/* initialize global variables */
+std::string     source_filename;
+std::ostream    midcode_stream(NULL);
+std::ostream    mipscode_stream(NULL);
+std::ostream    opt_midcode_stream(NULL);
+std::ostream    opt_mipscode_stream(NULL);
+std::ostream    debug_stream(NULL);
+
+static int generateFromIR(bool optimize);
+static void optimizeProgram();
+
+
+int main(int argc, char *argv[]) {
+    bool lex_thread = false;    // --lex-thread: lex on another thread
+    int jobs = 0;               // --jobs[=N]: compile functions on N threads
+    bool emit_ir = false;       // --emit-ir=bin: save binary IR as well
+    bool from_ir = false;       // --from-ir: load IR instead of source
+    bool dump_cfg = false;      // --dump-cfg: print CFGs to cfg_dump.txt
+    bool optimize = false;      // -O: optimize mid-code, see optimize.h
+    source_filename = "hello_world.txt";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--lex-thread")
+            lex_thread = true;
+        else if (arg == "--jobs")
+            jobs = std::max(1u, std::thread::hardware_concurrency());
+        else if (arg.compare(0, 7, "--jobs=") == 0)
+            jobs = std::max(1, std::atoi(arg.c_str() + 7));
+        else if (arg == "--emit-ir=bin")
+            emit_ir = true;
+        else if (arg == "--from-ir")
+            from_ir = true;
+        else if (arg == "--dump-cfg")
+            dump_cfg = true;
+        else if (arg == "-O")
+            optimize = true;
+        else if (arg == "--lsp")
+            // language server on stdin/stdout, see lsp.h
+            return runLanguageServer();
+        else
+            source_filename = arg;
+    }
+    if (!loadSource(source_filename)) {
+        std::cout << "can't open source file: " << source_filename << std::endl;
+        exit(1);
+    }
+    if (from_ir)
+        return generateFromIR(optimize);
+
+    //midcode_stream.rdbuf(std::cout.rdbuf());
+    std::string midcode_filename = "mid_code.txt";
+    std::string mipscode_filename = "mips_code.txt";
+    std::filebuf buffer1, buffer2;
+    buffer1.open(midcode_filename, std::ios_base::out);
+    buffer2.open(mipscode_filename, std::ios_base::out);
+    midcode_stream.rdbuf(&buffer1);
+    mipscode_stream.rdbuf(&buffer2);
+
+    // debug messages
+    debug_stream.rdbuf(std::cout.rdbuf());
+
+    // Do syntax check and generate mid-code on worker threads, see
+    // parallel.h, a program with errors is compiled again below
+    if (jobs == 0 || !compileInParallel(jobs)) {
+        // Do syntax check and build syntax tree
+        if (lex_thread)
+            startLexerThread();
+        Program *program = pProgram();
+
+        bool has_error = printCachedErrors();
+        if (has_error)
+            exit(1);
+
+        // generate mid-code, then syntax tree is no longer needed
+        lowerProgram(program);
+        ast_arena.clear();
+    }
+    genStringsMidCode(midcode_stream);
+        
+    std::cout << "compile success!\n";
+    std::cout << "mid code at: " << midcode_filename << std::endl;
+    if (emit_ir) {
+        std::string ir_filename = "mid_code.ir";
+        if (!saveBinaryIR(ir_filename)) {
+            std::cout << "can't write binary IR: " << ir_filename << std::endl;
+            exit(1);
+        }
+        std::cout << "binary IR at: " << ir_filename << std::endl;
+    }
+    if (optimize)
+        optimizeProgram();
+    if (dump_cfg) {
+        std::ofstream dump("cfg_dump.txt");
+        dumpCFG(dump, mid_codes);
+    }
+    // convert mid-code to MIPS code
+    convertToMIPS();
+    std::cout << "mips code at: " << mipscode_filename << std::endl;
+    std::cout << "\nIf you want to execute this mips program, using following command:\n"
+        << "    $ java -jar mars.jar nc mips_code.txt" << std::endl;
+
+    unloadSource();
+    return 0;
+}
+
+/**
+ * Generate MIPS code from the loaded IR file, see irfile.h.
+ * mid_code.txt is not written, it may be the file loaded.
+ */
+static int generateFromIR(bool optimize)
+{
+    if (!loadIR())
+        exit(1);
+    if (optimize)
+        optimizeProgram();
+    std::string mipscode_filename = "mips_code.txt";
+    std::filebuf buffer;
+    buffer.open(mipscode_filename, std::ios_base::out);
+    mipscode_stream.rdbuf(&buffer);
+    convertToMIPS();
+    std::cout << "mips code at: " << mipscode_filename << std::endl;
+    unloadSource();
+    return 0;
+}
+
+/* optimize mid-code, and write it to opt_mid_code.txt */
+static void optimizeProgram()
+{
+    std::string filename = "opt_mid_code.txt";
+    std::filebuf buffer;
+    buffer.open(filename, std::ios_base::out);
+    opt_midcode_stream.rdbuf(&buffer);
+    optimizeMidCodes();
+    genStringsMidCode(opt_midcode_stream);
+    opt_midcode_stream.rdbuf(NULL);
+    std::cout << "optimized mid code at: " << filename << std::endl;
+}
@@ -1,189 +1,325 @@
-#include <iostream>     // cout
-#include <cassert>      // assert
-#include <stack>        // stack
-#include <vector>       // vector
-#include <sstream>      // stringstream
-#include <cctype>       // isalpha, isdigit
-#include <map>          // map
-#include <string>       // stoi
-#include "common.h"
-#include "midcode.h"
-
-
-void genMidCode(const OpCode &op, const std::string &a,
-        const std::string &b, const std::string &res);
-void pushMidCodeCacheStack();
-void startCachingMidCode();
-void pauseCachingMidCode();
-void flushCachedMidCode();
-std::string genTempVar();
-std::string genLabel();
-std::string genLabelIf();
-std::string genLabelElse();
-std::string genLabelIfEnd();
-static std::string convertFormat(const FourTuple &ft);
-bool isConstValue(const std::string &t, int &val);
-void functionBegin();
-void functionEnd();
-
-std::vector<FourTuple> mid_codes;
-
-// `cache_depth` will always be 0 unless 
-// we met a switch-case statement
-static int cache_depth = 0;
-static std::vector<std::vector<FourTuple>> cachedMidCode;
-
-void genMidCode(
-    const OpCode &op,
-    const std::string &a,
-    const std::string &b,
-    const std::string &res)
-{
-    FourTuple t = { op, a, b, res };
-    // cache_depth usually is 0
-    if (cache_depth != 0) {
-        // NOTE: do use reference here
-        std::vector<FourTuple> &cache = 
-            cachedMidCode[cache_depth - 1];
-        cache.push_back(t);
-        return;
-    }
-    midcode_stream << convertFormat(t) << std::endl;
-    mid_codes.push_back(t);
-}
-
-void pushMidCodeCacheStack()
-{
-    std::vector<FourTuple> cache;
-    cachedMidCode.push_back(cache);
-}
-void startCachingMidCode()
-{
-    cache_depth++;
-}
-void pauseCachingMidCode()
-{
-    cache_depth--;
-    assert(cache_depth >= 0);
-}
-void flushCachedMidCode()
-{
-    int t = cachedMidCode.size();
-    assert(t > 0); // t must > 0
-    std::vector<FourTuple> &cached = cachedMidCode[t - 1];
-    for (const auto &item : cached) {
-        genMidCode(item.op, item.a, item.b, item.res);
-    }
-    cachedMidCode.pop_back();
-}
-
-/**
- * Note: as user-defined variable names contain only
- * digits and letters, so temporary variable names
- * won't get conflict with user-defined variable names.
- */
-static int temp_count = 0;
-std::string genTempVar()
-{
-    std::stringstream res;
-    res << "$t_" << temp_count++;
-    return res.str();
-}
-
-static int labels_count = 0;
-std::string genLabel()
-{
-    std::stringstream res;
-    res << "$LABEL_" << labels_count++;
-    return res.str();
-}
-
-static int if_statements_count = 0;
-std::string genLabelIf()
-{
-    static std::string t = "$IF_";
-    if_statements_count++;
-    return t + std::to_string(if_statements_count);
-}
-std::string genLabelElse()
-{
-    static std::string t = "$ELSE_";
-    return t + std::to_string(if_statements_count);
-}
-std::string genLabelIfEnd()
-{
-    static std::string t1 = "$IF_";
-    static std::string t2 = "_END";
-    return t1 + std::to_string(if_statements_count) + t2;
-}
-
-
-static std::string convertFormat(const FourTuple &ft)
-{
-    std::stringstream ss;
-    switch(ft.op) {
-        case ASSIGN:    
-            ss << ft.res << " = " << ft.a; 
-            break;
-        case ADD:       
-            ss << ft.res << " = " << ft.a << " + " << ft.b; 
-            break;
-        case SUB:
-            ss << ft.res << " = " << ft.a << " - " << ft.b;
-            break;
-        case MUL:
-            ss << ft.res << " = " << ft.a << " * " << ft.b;
-            break;
-        case DIV:
-            ss << ft.res << " = " << ft.a << " / " << ft.b;
-            break;
-        case WARRAY:    
-            ss << ft.a << "[" << ft.b << "]" << " = " << ft.res;
-            break;
-        case RARRAY:
-            ss << ft.res << " = " << ft.a << "[" << ft.b << "]";
-            break;
-        case COMPARE:
-            ss << ft.a << " " << ft.b << " " << ft.res;
-            break;
-        case FUNC:  ss << ft.a << " " << ft.b << "()"; break;
-        case PARA:  ss << "para " << ft.a << " " << ft.b; break;
-        case GVAR:
-        case VAR:   ss << "var " << ft.a << " " << ft.b
-                       << " " << ft.res; break;
-        case PUSH:  ss << "push " << ft.a << " " << ft.b; break;
-        case CALL:  ss << "call " << ft.a; break;
-        case RET:   ss << "ret " << ft.a; break;
-        case GETRET:ss << "getret " << ft.res; break;
-        case WRITE: ss << "printf " << ft.a << " " << ft.b; break;
-        case READ:  ss << "scanf " << ft.a << " " << ft.b; break;
-        case END:   ss << "end"; break;
-        case LABEL: ss << "label " << ft.a; break;
-        case GOTO:  ss << "goto " << ft.a; break;
-        case BZ:    ss << "bz " << ft.a << " " << ft.b 
-                       << " " << ft.res; 
-                    break;
-        case BNZ:   ss << "bnz " << ft.a << " " << ft.b 
-                       << " " << ft.res; 
-                    break;
-        case TEMP:  ss << "temp " << ft.a << " " << ft.b; break;
-        default:    std::cout << "FUCK: unknown!" << std::endl;
-    }
-    return ss.str();
-}
-
-// both const int and const char are const values
-bool isConstValue(const std::string &t, int &val)
-{
-    if (t[0] == '\'') {
-        assert(t[2] == '\'');
-        val = t[1];
-        return true;
-    } else if (std::isdigit(t[0]) || t[0] == '-') {
-        val = std::stoi(t);
-        return true;
-    }
-    return false;
-}
-
-
+#include <iostream>     // cout
+#include <cassert>      // assert
+#include <vector>       // vector
+#include <sstream>      // stringstream
+#include <string>       // string
+#include "common.h"
+#include "midcode.h"
+
+
+void genMidCode(OpCode op, Operand a, Operand b, Operand res);
+Operand genTempVar();
+Operand genLabel();
+Operand genLabelIf();
+Operand genLabelElse();
+Operand genLabelIfEnd();
+static std::string convertFormat(const FourTuple &ft);
+bool isConstValue(const Operand &t, int &val);
+void functionBegin();
+void functionEnd();
+
+void MidCodes::push(const FourTuple &t)
+{
+    ops.push_back((uint8_t)t.op);
+    kinds.push_back((uint8_t)t.a.kind);
+    kinds.push_back((uint8_t)t.b.kind);
+    kinds.push_back((uint8_t)t.res.kind);
+    values.push_back(t.a.value);
+    values.push_back(t.b.value);
+    values.push_back(t.res.value);
+}
+
+void MidCodes::append(const uint8_t *op_array, const uint8_t *kind_array,
+        const int32_t *value_array, size_t count)
+{
+    ops.insert(ops.end(), op_array, op_array + count);
+    kinds.insert(kinds.end(), kind_array, kind_array + count * SLOT_COUNT);
+    values.insert(values.end(), value_array,
+            value_array + count * SLOT_COUNT);
+}
+
+void MidCodes::setOperand(size_t i, OperandSlot slot, Operand t)
+{
+    size_t k = i * SLOT_COUNT + slot;
+    kinds[k] = (uint8_t)t.kind;
+    values[k] = t.value;
+}
+
+void MidCodes::set(size_t i, const FourTuple &t)
+{
+    ops[i] = (uint8_t)t.op;
+    setOperand(i, SLOT_A, t.a);
+    setOperand(i, SLOT_B, t.b);
+    setOperand(i, SLOT_RES, t.res);
+}
+
+void MidCodes::remove(const std::vector<bool> &removed)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < ops.size(); i++) {
+        if (removed[i])
+            continue;
+        ops[n] = ops[i];
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            kinds[n * SLOT_COUNT + slot] = kinds[i * SLOT_COUNT + slot];
+            values[n * SLOT_COUNT + slot] = values[i * SLOT_COUNT + slot];
+        }
+        n++;
+    }
+    ops.resize(n);
+    kinds.resize(n * SLOT_COUNT);
+    values.resize(n * SLOT_COUNT);
+}
+
+void MidCodes::splice(MidCodes &from, size_t first, size_t last)
+{
+    assert(first <= last && last <= from.size());
+    size_t a = first * SLOT_COUNT, b = last * SLOT_COUNT;
+    ops.insert(ops.end(), from.ops.begin() + first, from.ops.begin() + last);
+    kinds.insert(kinds.end(), from.kinds.begin() + a, from.kinds.begin() + b);
+    values.insert(values.end(), from.values.begin() + a,
+            from.values.begin() + b);
+    from.ops.erase(from.ops.begin() + first, from.ops.begin() + last);
+    from.kinds.erase(from.kinds.begin() + a, from.kinds.begin() + b);
+    from.values.erase(from.values.begin() + a, from.values.begin() + b);
+}
+
+void MidCodes::clear()
+{
+    ops.clear();
+    kinds.clear();
+    values.clear();
+}
+
+
+MidCodes mid_codes;
+/* if not NULL, mid-codes of this thread are collected here */
+static thread_local MidCodes *collected_codes = NULL;
+
+void genMidCode(OpCode op, Operand a, Operand b, Operand res)
+{
+    FourTuple t = { op, a, b, res };
+    if (collected_codes != NULL) {
+        collected_codes->push(t);
+        return;
+    }
+    midcode_stream << convertFormat(t) << std::endl;
+    mid_codes.push(t);
+}
+
+void collectMidCodes(MidCodes *codes)
+{
+    collected_codes = codes;
+}
+
+void appendMidCodes(MidCodes &codes)
+{
+    for (size_t i = 0; i < codes.size(); i++)
+        midcode_stream << convertFormat(codes[i]) << std::endl;
+    mid_codes.splice(codes, 0, codes.size());
+}
+
+void genStringsMidCode(std::ostream &os)
+{
+    const std::vector<std::string> &strings = labeledStrings();
+    for (size_t i = 0; i < strings.size(); i++) {
+        os << "string " << makeOperand(OPD_STRING, i)
+            << " \"" << strings[i] << "\"" << std::endl;
+    }
+}
+
+/**
+ * Note: as user-defined variable names contain only
+ * digits and letters, so temporary variable names
+ * won't get conflict with user-defined variable names.
+ */
+static thread_local int temp_count = 0;
+Operand genTempVar()
+{
+    return makeOperand(OPD_TEMP, temp_count++);
+}
+
+static thread_local int labels_count = 0;
+Operand genLabel()
+{
+    return makeOperand(OPD_LABEL, labels_count++);
+}
+
+static thread_local int if_statements_count = 0;
+Operand genLabelIf()
+{
+    if_statements_count++;
+    return makeOperand(OPD_IF, if_statements_count);
+}
+Operand genLabelElse()
+{
+    return makeOperand(OPD_ELSE, if_statements_count);
+}
+Operand genLabelIfEnd()
+{
+    return makeOperand(OPD_IF_END, if_statements_count);
+}
+
+NameCounters nameCounters()
+{
+    NameCounters res = { temp_count, labels_count, if_statements_count };
+    return res;
+}
+
+void setNameCounters(const NameCounters &counters)
+{
+    temp_count = counters.temps;
+    labels_count = counters.labels;
+    if_statements_count = counters.if_statements;
+}
+
+void renumberOperands(MidCodes &codes, const NameCounters &base,
+        const std::vector<int> &strings)
+{
+    for (size_t i = 0; i < codes.size(); i++) {
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            Operand t = codes.operand(i, (OperandSlot)slot);
+            switch (t.kind) {
+                case OPD_TEMP:      t.value += base.temps; break;
+                case OPD_LABEL:     t.value += base.labels; break;
+                case OPD_IF:
+                case OPD_ELSE:
+                case OPD_IF_END:    t.value += base.if_statements; break;
+                case OPD_STRING:    t.value = strings[t.value]; break;
+                default:            continue;
+            }
+            codes.setOperand(i, (OperandSlot)slot, t);
+        }
+    }
+}
+
+std::ostream &operator<<(std::ostream &os, const Operand &t)
+{
+    switch (t.kind) {
+        case OPD_NONE:      break;
+        case OPD_INT:       os << t.value; break;
+        case OPD_CHAR:      os << '\'' << (char)t.value << '\''; break;
+        case OPD_VAR:       os << tabName(t.value); break;
+        case OPD_TEMP:      os << "$t_" << t.value; break;
+        case OPD_LABEL:     os << "$LABEL_" << t.value; break;
+        case OPD_IF:        os << "$IF_" << t.value; break;
+        case OPD_ELSE:      os << "$ELSE_" << t.value; break;
+        case OPD_IF_END:    os << "$IF_" << t.value << "_END"; break;
+        case OPD_STRING:    os << "$STRING_" << t.value; break;
+        case OPD_TYPE:      os << dtype2midtype[t.value]; break;
+        case OPD_REL:       os << rel2str[t.value]; break;
+        case OPD_SSA:       os << "%" << t.value; break;
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const FourTuple &t)
+{
+    return os << convertFormat(t);
+}
+
+static std::string convertFormat(const FourTuple &ft)
+{
+    std::stringstream ss;
+    switch(ft.op) {
+        case ASSIGN:    
+            ss << ft.res << " = " << ft.a; 
+            break;
+        case ADD:       
+            ss << ft.res << " = " << ft.a << " + " << ft.b; 
+            break;
+        case SUB:
+            ss << ft.res << " = " << ft.a << " - " << ft.b;
+            break;
+        case MUL:
+            ss << ft.res << " = " << ft.a << " * " << ft.b;
+            break;
+        case DIV:
+            ss << ft.res << " = " << ft.a << " / " << ft.b;
+            break;
+        case WARRAY:    
+            ss << ft.a << "[" << ft.b << "]" << " = " << ft.res;
+            break;
+        case RARRAY:
+            ss << ft.res << " = " << ft.a << "[" << ft.b << "]";
+            break;
+        case COMPARE:
+            ss << ft.a << " " << ft.b << " " << ft.res;
+            break;
+        case FUNC:  ss << ft.a << " " << ft.b << "()"; break;
+        case PARA:  ss << "para " << ft.a << " " << ft.b; break;
+        case GVAR:
+        case VAR:   ss << "var " << ft.a << " " << ft.b
+                       << " " << ft.res; break;
+        case PUSH:  ss << "push " << ft.a << " " << ft.b; break;
+        case CALL:  ss << "call " << ft.a; break;
+        case RET:   ss << "ret " << ft.a; break;
+        case GETRET:ss << "getret " << ft.res; break;
+        case WRITE: ss << "printf " << ft.a << " " << ft.b; break;
+        case READ:  ss << "scanf " << ft.a << " " << ft.b; break;
+        case END:   ss << "end"; break;
+        case LABEL: ss << "label " << ft.a; break;
+        case GOTO:  ss << "goto " << ft.a; break;
+        case BZ:    ss << "bz " << ft.a << " " << ft.b 
+                       << " " << ft.res; 
+                    break;
+        case BNZ:   ss << "bnz " << ft.a << " " << ft.b 
+                       << " " << ft.res; 
+                    break;
+        case TEMP:  ss << "temp " << ft.a << " " << ft.b; break;
+        default:    std::cout << "FUCK: unknown!" << std::endl;
+    }
+    return ss.str();
+}
+
+// both const int and const char are const values
+bool isConstValue(const Operand &t, int &val)
+{
+    if (t.kind == OPD_INT || t.kind == OPD_CHAR) {
+        val = t.value;
+        return true;
+    }
+    return false;
+}
+
+OperandSlot defSlot(OpCode op)
+{
+    switch (op) {
+        case ASSIGN:
+        case ADD: case SUB: case MUL: case DIV:
+        case RARRAY:
+        case GETRET:    return SLOT_RES;
+        case READ:      return SLOT_B;
+        default:        return SLOT_COUNT;
+    }
+}
+
+bool usesSlot(OpCode op, OperandSlot slot)
+{
+    switch (op) {
+        case ASSIGN:
+        case RET:       return slot == SLOT_A;
+        case ADD: case SUB: case MUL: case DIV:
+                        return slot == SLOT_A || slot == SLOT_B;
+        case RARRAY:
+        case PUSH:
+        case WRITE:     return slot == SLOT_B;
+        case WARRAY:    return slot == SLOT_B || slot == SLOT_RES;
+        case COMPARE:   return slot == SLOT_A || slot == SLOT_RES;
+        default:        return false;
+    }
+}
+
+int localVariable(const Operand &t)
+{
+    TabHandle handle;
+    if (t.kind == OPD_TEMP)
+        handle = tabTempHandle(t.value);
+    else if (t.kind == OPD_VAR && ((TabHandle)t.value & TAB_LOCAL))
+        handle = t.value;
+    else
+        return -1;
+    if (tabEntry(handle).itype != IT_VARIABLE)
+        return -1;
+    return handle & ~TAB_LOCAL;
+}
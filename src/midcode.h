@@ -1,158 +1,247 @@
-#ifndef MIDCODE_H_
-#define MIDCODE_H_
-
-#include <string>       //std::string
-#include "table.h"
-
-/**
- * This module does:
- *  * generate quadruple(4-tuple) middle code
- */
-
-/**
- * Note: 
- * 1. all consts defined no matter globally or locally,
- * will be replaced by their literal values. So we don't
- * need operations for defining consts in middle-code.
- * 2. global variables should be allocate statically
- * in mips, but local variables should be allocated
- * dynamically in mips code. So we use different
- * operations.
- */
-enum OpCode {
-    ASSIGN,
-    ADD, SUB, MUL, DIV,
-    FUNC, PARA, 
-    GVAR, VAR,
-    PUSH, CALL, 
-    RET, GETRET,
-    WARRAY, RARRAY,         // write array, read array
-    WRITE, READ,
-    COMPARE,
-    END,                    // function complete
-    /*
-    EQUAL, NOT_EQUAL, LESS,
-    LESS_EQUAL, GRATER, GRATER_EQUAL,
-    */
-    LABEL, GOTO, 
-    BZ,                     // branch if previous compare is zero
-    BNZ,                    // branch if previous compare is not zero
-    TEMP,                   // temp variable 
-};
-
-static std::string op2str[] = {
-    "ASSIGN",
-    "ADD", "SUB", "MUL", "DIV",
-    "FUNC", "PARA", 
-    "GVAR", "VAR",
-    "PUSH", "CALL", 
-    "RET", "GETRET",
-    "WARRAY", "RARRAY",
-    "WRITE", "READ",
-    "COMPARE",
-    "END",                  // function complete
-    "LABEL", "GOTO",
-    "BEQ", "BNE",
-    "BZ", "BNZ",
-};
-
-
-typedef struct _FourTuple {
-    OpCode op;
-    std::string a;
-    std::string b;
-    std::string res;
-} FourTuple;
-
-const std::string NONE = "";
-void genMidCode(
-    const OpCode &op, 
-    const std::string &a, 
-    const std::string &b, 
-    const std::string &res
-);
-
-
-/**
- * Following 3 functions is used to generate middle
- * code for switch-case statement
- *
- * Why we need this?
- * Considering following code:
- *
- *      switch(val) {
- *          case 1: statement1;
- *          case 2: statement2;
- *          default: default_statement;
- *      }
- *      other_statement;
- * 
- * What we expected is following mid-code:
- *
- *      compare 1 and val, if equal goto label_1
- *      compare 2 and val, if equal goto label_2
- *   label_default:
- *      default_statement;
- *      goto_label_end
- *   label_1:                   // cached
- *      statement1;             // cached      
- *      goto label_end          // cached    
- *   label_2:                   // cached       
- *      statement2;             // cached 
- *      goto label_end          // cached
- *   label_end:
- *      other_statement;
- *
- * However, our grammar analyzer can only move forward, 
- * it can't go back. Thus we can't generate above code
- * directly. But we can easily generate below mid-code:
- *
- *      compare 1 and val, if equal goto label_1
- *   label_1:                                       // cache this
- *      statement1;                                 // cache this
- *      goto label_end                              // cache this
- *      compare 2 and val, if equal goto label_2
- *   label_2:                                       // cache this
- *      statement2;                                 // cache this
- *      goto label_end                              // cache this
- *   label_default:             
- *      statement
- *      goto_label_end
- *   // put cached statement here
- *   label_end:
- *      other_statement;
- *
- * We cache mid-codes marked with `cached this`, and 
- * put those codes before `label_end`, then mid-code 
- * became what we expected.
- *
- * For nested switch-case statement, we can use
- * a stack-like data structure to cached mid-code.
- */
-void pushMidCodeCacheStack();
-void startCachingMidCode();
-void pauseCachingMidCode();
-void flushCachedMidCode();
-
-/**
- * Generate temporary variable name.
- * Format: $t1, $t2, $t3
- */
-std::string genTempVar();
-
-/**
- * Generate labels for goto-like operations
- * Format: $label_1, $label_2, $label_3
- */
-std::string genLabel();
-
-std::string genLabelIf();
-std::string genLabelElse();
-std::string genLabelIfEnd();
-
-bool isConstValue(const std::string &t, int &val);
-
-
-extern std::vector<FourTuple> mid_codes;
-
-#endif // MIDCODE_H_
+#ifndef MIDCODE_H_
+#define MIDCODE_H_
+
+#include <string>       //std::string
+#include <vector>       //std::vector
+#include <cstdint>      //uint8_t, int32_t
+#include <cstddef>      //size_t
+#include <iostream>     //std::ostream
+#include "table.h"
+#include "intern.h"
+
+/**
+ * This module does:
+ *  * generate quadruple(4-tuple) middle code
+ */
+
+/**
+ * Note: 
+ * 1. all consts defined no matter globally or locally,
+ * will be replaced by their literal values. So we don't
+ * need operations for defining consts in middle-code.
+ * 2. global variables should be allocate statically
+ * in mips, but local variables should be allocated
+ * dynamically in mips code. So we use different
+ * operations.
+ */
+enum OpCode {
+    ASSIGN,
+    ADD, SUB, MUL, DIV,
+    FUNC, PARA, 
+    GVAR, VAR,
+    PUSH, CALL, 
+    RET, GETRET,
+    WARRAY, RARRAY,         // write array, read array
+    WRITE, READ,
+    COMPARE,
+    END,                    // function complete
+    /*
+    EQUAL, NOT_EQUAL, LESS,
+    LESS_EQUAL, GRATER, GRATER_EQUAL,
+    */
+    LABEL, GOTO, 
+    BZ,                     // branch if previous compare is zero
+    BNZ,                    // branch if previous compare is not zero
+    TEMP,                   // temp variable 
+};
+
+static std::string op2str[] = {
+    "ASSIGN",
+    "ADD", "SUB", "MUL", "DIV",
+    "FUNC", "PARA", 
+    "GVAR", "VAR",
+    "PUSH", "CALL", 
+    "RET", "GETRET",
+    "WARRAY", "RARRAY",
+    "WRITE", "READ",
+    "COMPARE",
+    "END",                  // function complete
+    "LABEL", "GOTO",
+    "BEQ", "BNE",
+    "BZ", "BNZ",
+};
+
+
+/* relations of COMPARE, in the order of their symbols(EQL, ...) */
+enum Relation {
+    REL_EQL, REL_NEQ, REL_LSS, REL_LEQ, REL_GTR, REL_GEQ,
+};
+
+static std::string rel2str[] = {
+    "EQL", "NEQ", "LSS", "LEQ", "GTR", "GEQ",
+};
+
+enum OperandKind {
+    OPD_NONE,
+    OPD_INT,        // int literal
+    OPD_CHAR,       // char literal, `value` is its ASCII
+    OPD_VAR,        // identifier, `value` is its TabHandle
+    OPD_TEMP,       // $t_<value>
+    OPD_LABEL,      // $LABEL_<value>
+    OPD_IF,         // $IF_<value>
+    OPD_ELSE,       // $ELSE_<value>
+    OPD_IF_END,     // $IF_<value>_END
+    OPD_STRING,     // $STRING_<value>
+    OPD_TYPE,       // DataType
+    OPD_REL,        // Relation
+    OPD_SSA,        // SSA name, only in the optimizer, see ssa.h
+};
+
+/**
+ * Operands are tagged values, the text of an operand is made
+ * only when mid-code is written, see operator<<.
+ */
+struct Operand {
+    OperandKind kind;
+    int         value;
+    bool operator==(const Operand &t) const
+    { return kind == t.kind && value == t.value; }
+    bool operator!=(const Operand &t) const { return !(*this == t); }
+};
+
+inline Operand makeOperand(OperandKind kind, int value)
+{
+    Operand t = { kind, value };
+    return t;
+}
+inline Operand intOperand(int value) { return makeOperand(OPD_INT, value); }
+inline Operand varOperand(TabHandle handle)
+{ return makeOperand(OPD_VAR, (int)handle); }
+inline Operand typeOperand(DataType dtype)
+{ return makeOperand(OPD_TYPE, dtype); }
+inline Operand relOperand(Relation rel) { return makeOperand(OPD_REL, rel); }
+
+/* variables in text are named by the local scope in use */
+std::ostream &operator<<(std::ostream &os, const Operand &t);
+
+typedef struct _FourTuple {
+    OpCode op;
+    Operand a;
+    Operand b;
+    Operand res;
+} FourTuple;
+
+const Operand NONE = { OPD_NONE, 0 };
+/* a line of mid_code.txt */
+std::ostream &operator<<(std::ostream &os, const FourTuple &t);
+
+/* operands of a mid-code */
+enum OperandSlot { SLOT_A, SLOT_B, SLOT_RES, SLOT_COUNT };
+
+/**
+ * A list of mid-codes stored as structure of arrays: opcodes, kinds
+ * of operands and values of operands are kept in separate contiguous
+ * arrays, 16 bytes for each code. A pass looking only at opcodes, or
+ * only at operands, scans memory linearly without touching the rest.
+ * A FourTuple is put together when a whole code is wanted.
+ */
+class MidCodes {
+public:
+    size_t size() const { return ops.size(); }
+    bool empty() const { return ops.empty(); }
+
+    OpCode op(size_t i) const { return (OpCode)ops[i]; }
+    Operand operand(size_t i, OperandSlot slot) const
+    {
+        size_t k = i * SLOT_COUNT + slot;
+        return makeOperand((OperandKind)kinds[k], values[k]);
+    }
+    FourTuple operator[](size_t i) const
+    {
+        FourTuple t = { op(i), operand(i, SLOT_A), operand(i, SLOT_B),
+            operand(i, SLOT_RES) };
+        return t;
+    }
+
+    void push(const FourTuple &t);
+    /* append `count` codes from raw arrays laid out as ours */
+    void append(const uint8_t *op_array, const uint8_t *kind_array,
+            const int32_t *value_array, size_t count);
+    void setOperand(size_t i, OperandSlot slot, Operand t);
+    void set(size_t i, const FourTuple &t);
+    /* remove codes marked in `removed`, the rest keep their order */
+    void remove(const std::vector<bool> &removed);
+    /* move codes [first, last) of `from` to the end of this list */
+    void splice(MidCodes &from, size_t first, size_t last);
+    void clear();
+
+    /* raw arrays, SLOT_COUNT kinds and values for each code */
+    const uint8_t *opArray() const { return ops.data(); }
+    const uint8_t *kindArray() const { return kinds.data(); }
+    const int32_t *valueArray() const { return values.data(); }
+
+private:
+    std::vector<uint8_t>    ops;        // OpCode
+    std::vector<uint8_t>    kinds;      // OperandKind, SLOT_COUNT for each
+    std::vector<int32_t>    values;     // SLOT_COUNT for each code
+};
+
+void genMidCode(OpCode op, Operand a, Operand b, Operand res);
+/**
+ * Collect mid-codes generated by this thread in `codes` instead of
+ * printing them and adding them to `mid_codes`, NULL stops it.
+ */
+void collectMidCodes(MidCodes *codes);
+/* print collected `codes` and move them to the end of `mid_codes` */
+void appendMidCodes(MidCodes &codes);
+/**
+ * Write labeled strings after mid-codes as `string $STRING_n "..."`,
+ * so that mid_code.txt can be read back, see irfile.h.
+ */
+void genStringsMidCode(std::ostream &os);
+
+
+/**
+ * Generate temporary variable.
+ * Format: $t_0, $t_1, $t_2
+ */
+Operand genTempVar();
+
+/**
+ * Generate labels for goto-like operations
+ * Format: $LABEL_0, $LABEL_1, $LABEL_2
+ */
+Operand genLabel();
+
+Operand genLabelIf();
+Operand genLabelElse();
+Operand genLabelIfEnd();
+
+/**
+ * How many temp vars and labels are generated so far. Restoring
+ * them before parsing a function again makes it reuse its names.
+ */
+struct NameCounters {
+    int     temps;
+    int     labels;
+    int     if_statements;
+};
+NameCounters nameCounters();
+void setNameCounters(const NameCounters &counters);
+/**
+ * Counters are kept for each thread. Temp vars and labels generated
+ * from zero counters are numbered from `base` on, and the string
+ * labeled n on that thread is labeled `strings[n]`, so a function
+ * can be parsed on its own thread and numbered as if it were parsed
+ * after the ones before it.
+ */
+void renumberOperands(MidCodes &codes, const NameCounters &base,
+        const std::vector<int> &strings);
+
+/* int or char literal */
+bool isConstValue(const Operand &t, int &val);
+
+/* slot a code of `op` defines a variable in, SLOT_COUNT if none */
+OperandSlot defSlot(OpCode op);
+/* a code of `op` reads the value of a variable in `slot` */
+bool usesSlot(OpCode op, OperandSlot slot);
+/**
+ * Local entry of a local variable, parameter or temp var in the
+ * local scope in use, -1 for other operands (globals, arrays, ...).
+ */
+int localVariable(const Operand &t);
+
+
+extern MidCodes mid_codes;
+
+#endif // MIDCODE_H_
@@ -1,12 +1,12 @@
-/**
- * This module is mips code generator.
- * Used for convert middle code to mips code 
- */
-#ifndef MIPS_H_
-#define MIPS_H_
-
-
-void convertToMIPS();
-
-
-#endif // MIPS_H_
+/**
+ * This module is mips code generator.
+ * Used for convert middle code to mips code 
+ */
+#ifndef MIPS_H_
+#define MIPS_H_
+
+
+void convertToMIPS();
+
+
+#endif // MIPS_H_
@@ -0,0 +1,90 @@
+#include <iostream>     // cout, endl
+#include <vector>       // vector
+#include <utility>      // swap
+#include "optimize.h"
+#include "common.h"
+#include "midcode.h"
+#include "table.h"
+#include "ssa.h"
+#include "sccp.h"
+#include "lvn.h"
+#include "dce.h"
+#include "coalesce.h"
+#include "frame.h"
+#include "licm.h"
+#include "ivsr.h"
+
+
+static void moveTemps(MidCodes &codes, int delta);
+
+
+void optimizeMidCodes()
+{
+    MidCodes optimized, functions, function;
+    size_t begin = 0;
+    while (begin < mid_codes.size() && mid_codes.op(begin) != FUNC)
+        opt_midcode_stream << mid_codes[begin++] << std::endl;
+    optimized.append(mid_codes.opArray(), mid_codes.kindArray(),
+            mid_codes.valueArray(), begin);
+
+    // functions never called are dropped, before optimizing, and again
+    // after if calls were in dead code
+    std::vector<size_t> funcs;
+    findCalledFunctions(mid_codes, funcs);
+    SsaFunction f;
+    for (size_t first : funcs) {
+        Name func = tabName(mid_codes.operand(first, SLOT_B).value);
+        tabEnterFunction(func);
+        function.clear();
+        insertPreheaders(mid_codes, first, function);
+        buildSSA(function, 0, f);
+        propagateConstants(f);
+        numberValues(f);
+        hoistInvariants(f);
+        reduceStrength(f);
+        removeDeadCode(f);
+        coalesceCopies(f);
+        function.clear();
+        leaveSSA(f, function);
+        removeJumps(function);
+        tabLayoutFrame(func);
+        functions.splice(function, 0, function.size());
+    }
+
+    findCalledFunctions(functions, funcs);
+    int next_temp = 0;
+    for (size_t first : funcs) {
+        size_t last = first;
+        while (functions.op(last) != END)
+            last++;
+        function.clear();
+        function.append(functions.opArray() + first,
+                functions.kindArray() + first * SLOT_COUNT,
+                functions.valueArray() + first * SLOT_COUNT, last + 1 - first);
+        Name func = tabName(function.operand(0, SLOT_B).value);
+        int frame_size = tabEnterFunction(func);
+        // temp vars added are numbered after the function's own, which
+        // may be taken by the next function
+        moveTemps(function, tabMoveTemps(next_temp));
+        next_temp = tabNextTemp();
+        std::cout << "frame of " << func << ": " << frame_size << " -> "
+            << shareFrameSlots(function) << " bytes" << std::endl;
+        for (size_t i = 0; i < function.size(); i++)
+            opt_midcode_stream << function[i] << std::endl;
+        optimized.splice(function, 0, function.size());
+    }
+    std::swap(mid_codes, optimized);
+}
+
+static void moveTemps(MidCodes &codes, int delta)
+{
+    for (size_t i = 0; delta != 0 && i < codes.size(); i++) {
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            Operand t = codes.operand(i, (OperandSlot)slot);
+            if (t.kind == OPD_TEMP) {
+                t.value += delta;
+                codes.setOperand(i, (OperandSlot)slot, t);
+            }
+        }
+    }
+}
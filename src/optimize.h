@@ -0,0 +1,14 @@
+/**
+ * This module optimizes mid-code before code generation (`-O`).
+ *
+ * Functions are optimized one at a time, in SSA form (see ssa.h)
+ * with the function's scope in use, and put back in `mid_codes`.
+ * Optimized mid-code is written to `opt_midcode_stream`, in the
+ * format of mid_code.txt.
+ */
+#ifndef OPTIMIZE_H_
+#define OPTIMIZE_H_
+
+void optimizeMidCodes();
+
+#endif // OPTIMIZE_H_
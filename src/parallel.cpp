@@ -0,0 +1,182 @@
+#include <vector>       // vector
+#include <string>       // string
+#include <thread>       // thread
+#include <atomic>       // atomic
+#include <cassert>      // assert
+#include "common.h"
+#include "parallel.h"
+#include "grammar.h"
+#include "symbol.h"
+#include "source.h"
+#include "error.h"
+#include "table.h"
+#include "midcode.h"
+#include "ast.h"
+
+
+/* a function compiled on a worker thread */
+struct FunctionResult {
+    bool                        ok;         // no errors, stops at its end
+    MidCodes                    codes;
+    NameCounters                count;      // names generated from zero
+    std::vector<std::string>    strings;    // strings labeled from zero
+    FunctionScope               scope;      // temp vars numbered from zero
+};
+
+/* file-scope global variables, functions are taken in order by workers */
+static std::vector<FunctionResult>  results;
+static std::atomic<size_t>          next_function(0);
+
+static void findBodies(std::vector<BodyBraces> &bodies);
+static void compileFunctions(const std::vector<FunctionSpan> *spans);
+static void compileFunction(const FunctionSpan &span, FunctionResult &res);
+static void mergeFunction(FunctionResult &res, NameCounters &base);
+
+
+bool compileInParallel(int jobs)
+{
+    std::vector<BodyBraces> bodies;
+    findBodies(bodies);
+    // nothing is printed until all functions are compiled
+    setServerMode(true);
+    Program *program = NULL;
+    try {
+        program = pProgramHeaders(bodies);
+    } catch (const CompileStop &) {
+        // errors are found, or braces are not matched as expected
+    }
+    setServerMode(false);
+    bool ok = takeDiagnostics().empty() && program != NULL;
+
+    const std::vector<FunctionSpan> &spans = functionSpans();
+    results.assign(ok ? spans.size() : 0, FunctionResult());
+    next_function = 0;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < jobs && i < (int)results.size(); i++)
+        workers.emplace_back(compileFunctions, &spans);
+    for (std::thread &t : workers)
+        t.join();
+    for (const FunctionResult &res : results)
+        ok = ok && res.ok;
+    if (!ok) {
+        // start over, errors will be found on a single thread
+        results.clear();
+        tabClear(GLOBAL);
+        ast_arena.clear();
+        seekSource(0, 0);
+        return false;
+    }
+
+    echoSource();
+    NameCounters base = nameCounters();
+    size_t k = 0;
+    for (const Decl *decl = program->decls; decl != NULL; decl = decl->next) {
+        if (decl->kind == DECL_VAR) {
+            lowerDecl(decl);
+        } else {
+            assert(k < results.size());
+            mergeFunction(results[k++], base);
+        }
+    }
+    setNameCounters(base);
+    results.clear();
+    return true;
+}
+
+/**
+ * Find bodies of functions by matching braces at top level, line
+ * by line. Literals are skipped as the lexer reads them: a char is
+ * 3 characters from its '\'', a string ends at '"' or line end.
+ * Braces in a wrong program may be matched differently from the
+ * parser, it's found when functions are parsed.
+ */
+static void findBodies(std::vector<BodyBraces> &bodies)
+{
+    BodyBraces body = BodyBraces();
+    int depth = 0;
+    for (unsigned int line_no = 1; line_no <= sourceLineCount(); line_no++) {
+        const char *line = sourceLineBegin(line_no);
+        unsigned int length = sourceLineLength(line_no);
+        for (unsigned int pos = 0; pos < length; pos++) {
+            switch (line[pos]) {
+                case '\'':
+                    pos += 2;
+                    break;
+                case '\"':
+                    while (++pos < length && line[pos] != '\"')
+                        ;
+                    break;
+                case '{':
+                    if (depth++ == 0) {
+                        body.line_no = line_no;
+                        body.pos = pos;
+                    }
+                    break;
+                case '}':
+                    // a '}' without '{' is left to parser
+                    if (depth != 0 && --depth == 0) {
+                        body.end_line_no = line_no;
+                        body.end_pos = pos;
+                        bodies.push_back(body);
+                    }
+                    break;
+            }
+        }
+    }
+}
+
+/* worker thread, compile functions until none is left */
+static void compileFunctions(const std::vector<FunctionSpan> *spans)
+{
+    setServerMode(true);
+    for (;;) {
+        size_t k = next_function++;
+        if (k >= results.size())
+            break;
+        compileFunction((*spans)[k], results[k]);
+    }
+}
+
+static void compileFunction(const FunctionSpan &span, FunctionResult &res)
+{
+    NameCounters zero = { 0, 0, 0 };
+    setNameCounters(zero);
+    Decl *decl = NULL;
+    try {
+        decl = pFunctionAgain(span);
+    } catch (const CompileStop &) {
+        decl = NULL;
+    }
+    // it must end where parsing without bodies went on
+    res.ok = (takeDiagnostics().empty() && decl != NULL &&
+            g_line_no == span.end_line_no && g_word_pos == span.end_word_pos);
+    if (res.ok) {
+        collectMidCodes(&res.codes);
+        lowerDecl(decl);
+        collectMidCodes(NULL);
+        res.count = nameCounters();
+        res.scope = tabTakeScope();
+    }
+    res.strings = takeStrings();
+    ast_arena.clear();
+}
+
+/**
+ * Generate mid-codes of a function compiled on a worker thread and
+ * keep its local scope, its names are numbered after those of
+ * functions before it.
+ */
+static void mergeFunction(FunctionResult &res, NameCounters &base)
+{
+    std::vector<int> strings = relabelStrings(res.strings);
+    Name func = res.scope.func;
+    res.scope.first_temp += base.temps;
+    tabKeepScope(res.scope);
+    // its variables are named by its scope in mid-code text
+    tabEnterFunction(func);
+    renumberOperands(res.codes, base, strings);
+    appendMidCodes(res.codes);
+    base.temps += res.count.temps;
+    base.labels += res.count.labels;
+    base.if_statements += res.count.if_statements;
+}
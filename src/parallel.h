@@ -0,0 +1,28 @@
+/**
+ * This is the parallel front end: with `--jobs`, functions are
+ * parsed, checked and lowered to mid-code on a pool of threads.
+ *
+ * A pre-scan matches braces to find function bodies, then the
+ * program is parsed without them (see pProgramHeaders()), which
+ * fills the global table and parameter lists. Each function is then
+ * parsed again on a worker thread seeing the globals defined before
+ * it. Its temp vars, labels and strings are numbered from zero, and
+ * renumbered when mid-codes of functions are merged in source order,
+ * so mid-code is the same as that of a single thread.
+ *
+ * Only programs without errors or warnings are compiled this way.
+ * If anything is found, nothing is printed and the program is
+ * compiled again on a single thread, which reports it as usual.
+ */
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+/**
+ * Compile the loaded source to mid-code with `jobs` worker threads
+ * and print source lines as the lexer does. Return false if the
+ * program must be compiled on a single thread instead, nothing is
+ * printed or generated in that case.
+ */
+bool compileInParallel(int jobs);
+
+#endif // PARALLEL_H_
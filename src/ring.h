@@ -0,0 +1,58 @@
+/**
+ * This is a lock-free single-producer/single-consumer ring buffer.
+ *
+ * One thread calls push() and another thread calls pop(), both
+ * of them wait (yield) if the ring is full or empty. Each side
+ * keeps a cached copy of the other side's index, so the shared
+ * indexes are only read when the cached one says "full"/"empty".
+ */
+#ifndef RING_H_
+#define RING_H_
+
+#include <cstddef>      // size_t
+#include <atomic>       // atomic
+#include <thread>       // yield()
+
+template <typename T, size_t N>
+class SpscRing {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "size must be a power of 2");
+private:
+    // consumer side
+    alignas(64) std::atomic<size_t> head;   // next slot to pop
+    size_t tail_cache;
+    // producer side
+    alignas(64) std::atomic<size_t> tail;   // next slot to push
+    size_t head_cache;
+    alignas(64) T slots[N];
+public:
+    SpscRing(): head(0), tail_cache(0), tail(0), head_cache(0) {}
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    void push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        while (t - head_cache == N) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache == N)
+                std::this_thread::yield();
+        }
+        slots[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+    }
+
+    T pop()
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        while (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache)
+                std::this_thread::yield();
+        }
+        T item = slots[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return item;
+    }
+};
+
+#endif // RING_H_
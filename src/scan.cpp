@@ -0,0 +1,254 @@
+#include <cstddef>      // size_t
+#include "scan.h"
+#if defined(__GNUC__) && defined(__SSE2__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SCAN_USE_X86
+#include <immintrin.h>  // SSE2, AVX2 intrinsics
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+
+/**
+ * Character classes. Each class can test a single character,
+ * and 16/32 characters at a time on x86, in which case a byte
+ * of the result is 0xFF if the character is in the class.
+ *
+ * NOTE: _mm_cmpgt_epi8 is a signed comparison, so non-ASCII
+ * characters(negative values) are never in a class.
+ */
+#ifdef SCAN_USE_X86
+static inline __m128i inRange(__m128i x, char lo, char hi)
+{
+    return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)),
+                         _mm_cmpgt_epi8(_mm_set1_epi8(hi + 1), x));
+}
+AVX2 static inline __m256i inRange(__m256i x, char lo, char hi)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(lo - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), x));
+}
+#endif
+
+struct Blank {
+    static bool test(char c) { return c == ' ' || c == '\t'; }
+#ifdef SCAN_USE_X86
+    static __m128i test(__m128i x) {
+        return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+                            _mm_cmpeq_epi8(x, _mm_set1_epi8('\t')));
+    }
+    AVX2 static __m256i test(__m256i x) {
+        return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+                               _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')));
+    }
+#endif
+};
+
+struct Digit {
+    static bool test(char c) { return c >= '0' && c <= '9'; }
+#ifdef SCAN_USE_X86
+    static __m128i test(__m128i x) { return inRange(x, '0', '9'); }
+    AVX2 static __m256i test(__m256i x) { return inRange(x, '0', '9'); }
+#endif
+};
+
+struct IdentChar {
+    static bool test(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               (c >= '0' && c <= '9') || c == '_';
+    }
+#ifdef SCAN_USE_X86
+    // (c | 0x20) maps 'A'~'Z' to 'a'~'z'
+    static __m128i test(__m128i x) {
+        __m128i lower = _mm_or_si128(x, _mm_set1_epi8(0x20));
+        return _mm_or_si128(
+            _mm_or_si128(inRange(lower, 'a', 'z'), inRange(x, '0', '9')),
+            _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+    }
+    AVX2 static __m256i test(__m256i x) {
+        __m256i lower = _mm256_or_si256(x, _mm256_set1_epi8(0x20));
+        return _mm256_or_si256(
+            _mm256_or_si256(inRange(lower, 'a', 'z'), inRange(x, '0', '9')),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+    }
+#endif
+};
+
+struct StringChar {
+    static bool test(char c) {
+        return c == 32 || c == 33 || (c >= 35 && c <= 126);
+    }
+#ifdef SCAN_USE_X86
+    static __m128i test(__m128i x) {
+        return _mm_andnot_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\"')),
+                                inRange(x, 32, 126));
+    }
+    AVX2 static __m256i test(__m256i x) {
+        return _mm256_andnot_si256(
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\"')),
+            inRange(x, 32, 126));
+    }
+#endif
+};
+
+
+struct LineChar {
+    static bool test(char c) { return c != '\n' && c != '\r'; }
+#ifdef SCAN_USE_X86
+    static __m128i test(__m128i x) {
+        return _mm_xor_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\n')),
+                         _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))),
+            _mm_set1_epi8(-1));
+    }
+    AVX2 static __m256i test(__m256i x) {
+        return _mm256_xor_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')),
+                            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))),
+            _mm256_set1_epi8(-1));
+    }
+#endif
+};
+
+
+/* plain C++ kernels */
+template <class C>
+static size_t scanScalar(const char *p, const char *end)
+{
+    const char *start = p;
+    while (p != end && C::test(*p))
+        p++;
+    return p - start;
+}
+
+static void copyLowerScalar(char *dst, const char *src, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+}
+
+#ifdef SCAN_USE_X86
+/* SSE2 kernels, 16 characters at a time */
+template <class C>
+static size_t scanSSE2(const char *p, const char *end)
+{
+    const char *start = p;
+    while (end - p >= 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        unsigned int miss = ~_mm_movemask_epi8(C::test(x)) & 0xFFFFu;
+        if (miss != 0)
+            return p - start + __builtin_ctz(miss);
+        p += 16;
+    }
+    return p - start + scanScalar<C>(p, end);
+}
+
+static void copyLowerSSE2(char *dst, const char *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i upper = _mm_and_si128(inRange(x, 'A', 'Z'),
+                                      _mm_set1_epi8(0x20));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(x, upper));
+    }
+    copyLowerScalar(dst + i, src + i, n - i);
+}
+
+/* AVX2 kernels, 32 characters at a time */
+template <class C>
+AVX2 static size_t scanAVX2(const char *p, const char *end)
+{
+    const char *start = p;
+    while (end - p >= 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        unsigned int miss = ~(unsigned int)_mm256_movemask_epi8(C::test(x));
+        if (miss != 0)
+            return p - start + __builtin_ctz(miss);
+        p += 32;
+    }
+    return p - start + scanSSE2<C>(p, end);
+}
+
+AVX2 static void copyLowerAVX2(char *dst, const char *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i upper = _mm256_and_si256(inRange(x, 'A', 'Z'),
+                                         _mm256_set1_epi8(0x20));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(x, upper));
+    }
+    copyLowerSSE2(dst + i, src + i, n - i);
+}
+#endif
+
+
+/**
+ * Kernels are picked once before main() runs.
+ */
+typedef size_t (*ScanFunc)(const char *, const char *);
+typedef void (*CopyFunc)(char *, const char *, size_t);
+struct ScanKernels {
+    ScanFunc blanks;
+    ScanFunc ident_chars;
+    ScanFunc digits;
+    ScanFunc string_chars;
+    ScanFunc line_chars;
+    CopyFunc copy_lower;
+};
+
+static ScanKernels selectKernels()
+{
+#ifdef SCAN_USE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        ScanKernels k = { scanAVX2<Blank>, scanAVX2<IdentChar>,
+            scanAVX2<Digit>, scanAVX2<StringChar>, scanAVX2<LineChar>,
+            copyLowerAVX2 };
+        return k;
+    }
+    ScanKernels k = { scanSSE2<Blank>, scanSSE2<IdentChar>,
+        scanSSE2<Digit>, scanSSE2<StringChar>, scanSSE2<LineChar>,
+        copyLowerSSE2 };
+    return k;
+#else
+    ScanKernels k = { scanScalar<Blank>, scanScalar<IdentChar>,
+        scanScalar<Digit>, scanScalar<StringChar>, scanScalar<LineChar>,
+        copyLowerScalar };
+    return k;
+#endif
+}
+
+static const ScanKernels kernels = selectKernels();
+
+size_t scanBlanks(const char *p, const char *end)
+{
+    return kernels.blanks(p, end);
+}
+
+size_t scanIdentChars(const char *p, const char *end)
+{
+    return kernels.ident_chars(p, end);
+}
+
+size_t scanDigits(const char *p, const char *end)
+{
+    return kernels.digits(p, end);
+}
+
+size_t scanStringChars(const char *p, const char *end)
+{
+    return kernels.string_chars(p, end);
+}
+
+size_t scanLineChars(const char *p, const char *end)
+{
+    return kernels.line_chars(p, end);
+}
+
+void copyLower(char *dst, const char *src, size_t n)
+{
+    kernels.copy_lower(dst, src, n);
+}
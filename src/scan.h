@@ -0,0 +1,28 @@
+/**
+ * This module provides character-run kernels for the lexer.
+ *
+ * Each scanXXX() function returns the length of the longest prefix
+ * of [p, end) whose characters all belong to one character class.
+ * SSE2/AVX2 versions test 16/32 characters at a time, the best
+ * version supported by the running CPU is picked at the first call,
+ * and plain C++ versions are used on other platforms.
+ */
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <cstddef>      // size_t
+
+/* ' ' and '\t', line breaks are handled by the lexer */
+size_t scanBlanks(const char *p, const char *end);
+/* letters, digits and '_' */
+size_t scanIdentChars(const char *p, const char *end);
+/* '0' ~ '9' */
+size_t scanDigits(const char *p, const char *end);
+/* valid characters of string: 32(space), 33('!'), 35-126 */
+size_t scanStringChars(const char *p, const char *end);
+/* any character except '\r' and '\n' */
+size_t scanLineChars(const char *p, const char *end);
+/* copy n characters from src to dst, converting letters to lowercase */
+void copyLower(char *dst, const char *src, size_t n);
+
+#endif // SCAN_H_
@@ -0,0 +1,379 @@
+#include <vector>       // vector
+#include <utility>      // pair
+#include <climits>      // INT_MIN
+#include <cstdint>      // uint32_t, int32_t
+#include <cassert>      // assert
+#include "sccp.h"
+
+
+enum ValueState { VAL_UNDEF, VAL_CONST, VAL_VARYING };
+
+struct Value {
+    ValueState  state;
+    int         constant;
+    bool operator!=(const Value &t) const
+    { return state != t.state || (state == VAL_CONST && constant != t.constant); }
+};
+
+struct Propagation {
+    std::vector<Value>                              values;     // of names
+    std::vector<std::vector<size_t> >               code_uses;  // of names
+    std::vector<std::vector<std::pair<int, int> > > phi_uses;   // block, phi
+    std::vector<int>                                block_of;   // of codes
+    std::vector<bool>                               block_exec;
+    std::vector<std::vector<bool> >                 edge_exec;  // by pred
+    std::vector<std::pair<int, int> >               edge_work;
+    std::vector<int>                                name_work;
+};
+
+static void findUses(const SsaFunction &f, Propagation &p);
+static Value valueOf(const Propagation &p, const Operand &t);
+static void lower(Propagation &p, int name, Value value);
+static void visitBlock(const SsaFunction &f, Propagation &p, int b);
+static void evaluate(const SsaFunction &f, Propagation &p, size_t i);
+static void evaluatePhi(Propagation &p, int b, const Phi &phi);
+static bool branchTaken(const SsaFunction &f, const Propagation &p,
+        size_t i, bool &taken);
+static bool fold(OpCode op, int a, int b, int &result);
+static bool compare(Relation rel, int a, int b);
+static void rewrite(SsaFunction &f, const Propagation &p);
+
+static const Value UNDEF = { VAL_UNDEF, 0 };
+static const Value VARYING = { VAL_VARYING, 0 };
+
+
+void propagateConstants(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    Propagation p;
+    findUses(f, p);
+    p.values.assign(f.names.size(), UNDEF);
+    for (size_t name = 0; name < f.names.size(); name++) {
+        // parameters, and locals not initialized
+        if (f.names[name].def == SSA_ENTRY)
+            p.values[name] = VARYING;
+    }
+    p.block_exec.assign(cfg.blocks.size(), false);
+    p.edge_exec.resize(cfg.blocks.size());
+    for (size_t b = 0; b < cfg.blocks.size(); b++)
+        p.edge_exec[b].assign(cfg.blocks[b].preds.size(), false);
+
+    p.block_exec[cfg.entry] = true;
+    visitBlock(f, p, cfg.entry);
+    while (!p.edge_work.empty() || !p.name_work.empty()) {
+        while (!p.edge_work.empty()) {
+            int from = p.edge_work.back().first;
+            int to = p.edge_work.back().second;
+            p.edge_work.pop_back();
+            int j = predIndex(cfg, from, to);
+            if (p.edge_exec[to][j])
+                continue;
+            p.edge_exec[to][j] = true;
+            if (!p.block_exec[to]) {
+                p.block_exec[to] = true;
+                visitBlock(f, p, to);
+            } else {
+                // a new argument for phis
+                for (const Phi &phi : f.phis[to])
+                    evaluatePhi(p, to, phi);
+            }
+        }
+        while (!p.name_work.empty()) {
+            int name = p.name_work.back();
+            p.name_work.pop_back();
+            for (size_t i : p.code_uses[name]) {
+                if (p.block_exec[p.block_of[i]])
+                    evaluate(f, p, i);
+            }
+            for (const std::pair<int, int> &use : p.phi_uses[name]) {
+                if (p.block_exec[use.first])
+                    evaluatePhi(p, use.first,
+                            f.phis[use.first][use.second]);
+            }
+        }
+    }
+    rewrite(f, p);
+}
+
+static void findUses(const SsaFunction &f, Propagation &p)
+{
+    const FunctionCFG &cfg = f.cfg;
+    p.code_uses.assign(f.names.size(), std::vector<size_t>());
+    p.phi_uses.assign(f.names.size(), std::vector<std::pair<int, int> >());
+    p.block_of.assign(f.codes.size(), -1);
+    for (int b : cfg.rpo) {
+        for (size_t k = 0; k < f.phis[b].size(); k++) {
+            for (const Operand &arg : f.phis[b][k].args) {
+                if (arg.kind == OPD_SSA)
+                    p.phi_uses[arg.value].push_back(std::make_pair(b, k));
+            }
+        }
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            p.block_of[i] = b;
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind == OPD_SSA && usesSlot(op, (OperandSlot)slot))
+                    p.code_uses[t.value].push_back(i);
+            }
+        }
+    }
+}
+
+/* literals are constants, global variables and arrays vary */
+static Value valueOf(const Propagation &p, const Operand &t)
+{
+    int constant;
+    if (isConstValue(t, constant)) {
+        Value value = { VAL_CONST, constant };
+        return value;
+    }
+    return t.kind == OPD_SSA ? p.values[t.value] : VARYING;
+}
+
+static void lower(Propagation &p, int name, Value value)
+{
+    Value &old = p.values[name];
+    if (old.state == VAL_VARYING || !(old != value))
+        return;
+    // a constant never changes to another
+    if (old.state == VAL_CONST && value.state == VAL_CONST)
+        value = VARYING;
+    old = value;
+    p.name_work.push_back(name);
+}
+
+static void visitBlock(const SsaFunction &f, Propagation &p, int b)
+{
+    for (const Phi &phi : f.phis[b])
+        evaluatePhi(p, b, phi);
+    const BasicBlock &block = f.cfg.blocks[b];
+    for (size_t i = block.begin; i < block.end; i++)
+        evaluate(f, p, i);
+    // a branch adds its edges when its compare is evaluated
+    OpCode last = (block.begin < block.end ? f.codes.op(block.end - 1) : LABEL);
+    if (last != BZ && last != BNZ) {
+        for (int s : block.succs)
+            p.edge_work.push_back(std::make_pair(b, s));
+    }
+}
+
+static void evaluate(const SsaFunction &f, Propagation &p, size_t i)
+{
+    OpCode op = f.codes.op(i);
+    if (op == COMPARE) {
+        int b = p.block_of[i];
+        const std::vector<int> &succs = f.cfg.blocks[b].succs;
+        bool taken;
+        if (!branchTaken(f, p, i, taken)) {
+            for (int s : succs)
+                p.edge_work.push_back(std::make_pair(b, s));
+        } else {
+            // fall through first, then jump target
+            p.edge_work.push_back(std::make_pair(b,
+                        taken ? succs.back() : succs.front()));
+        }
+        return;
+    }
+    OperandSlot slot = defSlot(op);
+    if (slot == SLOT_COUNT)
+        return;
+    Operand def = f.codes.operand(i, slot);
+    if (def.kind != OPD_SSA)
+        return;
+    Value a = valueOf(p, f.codes.operand(i, SLOT_A));
+    Value b = valueOf(p, f.codes.operand(i, SLOT_B));
+    Value value = VARYING;
+    if (op == ASSIGN) {
+        value = a;
+    } else if (op == ADD || op == SUB || op == MUL || op == DIV) {
+        if (a.state == VAL_UNDEF || b.state == VAL_UNDEF)
+            value = UNDEF;
+        else if (a.state == VAL_CONST && b.state == VAL_CONST &&
+                fold(op, a.constant, b.constant, value.constant))
+            value.state = VAL_CONST;
+    }
+    lower(p, def.value, value);
+}
+
+/* meet of arguments on executable edges */
+static void evaluatePhi(Propagation &p, int b, const Phi &phi)
+{
+    Value value = UNDEF;
+    for (size_t j = 0; j < phi.args.size(); j++) {
+        if (!p.edge_exec[b][j])
+            continue;
+        Value arg = valueOf(p, phi.args[j]);
+        if (arg.state == VAL_UNDEF)
+            continue;
+        if (value.state == VAL_UNDEF)
+            value = arg;
+        else if (value != arg)
+            value = VARYING;
+    }
+    lower(p, phi.name, value);
+}
+
+/**
+ * Whether the branch after COMPARE `codes[i]` is taken, false if it's
+ * not known: operands are not both constants.
+ */
+static bool branchTaken(const SsaFunction &f, const Propagation &p,
+        size_t i, bool &taken)
+{
+    Value a = valueOf(p, f.codes.operand(i, SLOT_A));
+    Operand rel = f.codes.operand(i, SLOT_B);
+    Value b = (rel == NONE ? a : valueOf(p, f.codes.operand(i, SLOT_RES)));
+    if (a.state != VAL_CONST || b.state != VAL_CONST)
+        return false;
+    bool value = (rel == NONE ? a.constant != 0 :
+            compare((Relation)rel.value, a.constant, b.constant));
+    taken = (f.codes.op(i + 1) == BNZ ? value : !value);
+    return true;
+}
+
+/**
+ * Values are words, arithmetic wraps as MIPS does. Division by zero,
+ * and the one overflowing, are left to run.
+ */
+static bool fold(OpCode op, int a, int b, int &result)
+{
+    uint32_t x = a, y = b;
+    switch (op) {
+        case ADD:   result = (int32_t)(x + y); return true;
+        case SUB:   result = (int32_t)(x - y); return true;
+        case MUL:   result = (int32_t)(x * y); return true;
+        case DIV:
+            if (b == 0 || (a == INT_MIN && b == -1))
+                return false;
+            result = a / b;
+            return true;
+        default:    return false;
+    }
+}
+
+static bool compare(Relation rel, int a, int b)
+{
+    switch (rel) {
+        case REL_EQL:   return a == b;
+        case REL_NEQ:   return a != b;
+        case REL_LSS:   return a < b;
+        case REL_LEQ:   return a <= b;
+        case REL_GTR:   return a > b;
+        case REL_GEQ:   return a >= b;
+    }
+    return false;
+}
+
+
+/**
+ * Replace uses of constant names with literals, and remove their
+ * definitions. Arithmetic can't have two literals, so a division
+ * which can't be folded keeps its divisor name, and that definition
+ * becomes an ASSIGN of the constant.
+ */
+static void rewrite(SsaFunction &f, const Propagation &p)
+{
+    const FunctionCFG &cfg = f.cfg;
+    std::vector<bool> removed(f.codes.size(), false);
+    std::vector<bool> kept(f.names.size(), false);
+    auto literal = [&](const Operand &t, Operand &lit) {
+        if (t.kind != OPD_SSA || p.values[t.value].state != VAL_CONST)
+            return false;
+        lit = intOperand(p.values[t.value].constant);
+        return true;
+    };
+
+    for (int b : cfg.rpo) {
+        if (!p.block_exec[b])
+            continue;
+        for (Phi &phi : f.phis[b]) {
+            for (Operand &arg : phi.args)
+                literal(arg, arg);
+        }
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            bool taken;
+            if (op == COMPARE && !branchTaken(f, p, i, taken)) {
+                // both edges are executable, nothing is left undefined
+                for (int s : block.succs)
+                    assert(p.edge_exec[s][predIndex(cfg, b, s)]);
+            } else if (op == COMPARE) {
+                removed[i] = true;
+                i++;
+                const std::vector<int> &succs = block.succs;
+                if (succs.size() == 1) {
+                    // it branches to the next block
+                    removed[i] = true;
+                } else if (taken) {
+                    f.codes.set(i, FourTuple{ GOTO,
+                            f.codes.operand(i, SLOT_A), NONE, NONE });
+                    removeEdge(f, b, succs.front());
+                } else {
+                    removed[i] = true;
+                    removeEdge(f, b, succs.back());
+                }
+                continue;
+            }
+            OperandSlot slot = defSlot(op);
+            Operand def = (slot == SLOT_COUNT ? NONE : f.codes.operand(i, slot));
+            if (def.kind == OPD_SSA && p.values[def.value].state == VAL_CONST)
+                continue;
+            Operand a = f.codes.operand(i, SLOT_A), lit_a = a;
+            Operand c = f.codes.operand(i, SLOT_B), lit_c = c;
+            literal(a, lit_a);
+            literal(c, lit_c);
+            int x, y, result;
+            bool arithmetic = (op == ADD || op == SUB || op == MUL || op == DIV);
+            if (arithmetic && isConstValue(lit_a, x) && isConstValue(lit_c, y)) {
+                if (fold(op, x, y, result)) {
+                    // into a variable not renamed, e.g. a global one
+                    f.codes.set(i, FourTuple{ ASSIGN, intOperand(result),
+                            NONE, def });
+                } else if (c.kind == OPD_SSA) {
+                    kept[c.value] = true;
+                    f.codes.setOperand(i, SLOT_A, lit_a);
+                } else {
+                    kept[a.value] = true;
+                }
+                continue;
+            }
+            for (int s = SLOT_A; s < SLOT_COUNT; s++) {
+                Operand t = f.codes.operand(i, (OperandSlot)s), lit;
+                if (usesSlot(op, (OperandSlot)s) && literal(t, lit))
+                    f.codes.setOperand(i, (OperandSlot)s, lit);
+            }
+        }
+    }
+
+    // definitions of constants left
+    for (int b : cfg.rpo) {
+        if (!p.block_exec[b])
+            continue;
+        std::vector<Phi> &phis = f.phis[b];
+        size_t n = 0;
+        for (size_t k = 0; k < phis.size(); k++) {
+            int name = phis[k].name;
+            if (p.values[name].state != VAL_CONST || kept[name])
+                phis[n++] = phis[k];
+        }
+        phis.resize(n);
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OperandSlot slot = defSlot(f.codes.op(i));
+            if (slot == SLOT_COUNT || removed[i])
+                continue;
+            Operand def = f.codes.operand(i, slot);
+            if (def.kind != OPD_SSA || p.values[def.value].state != VAL_CONST)
+                continue;
+            if (kept[def.value])
+                f.codes.set(i, FourTuple{ ASSIGN,
+                        intOperand(p.values[def.value].constant), NONE, def });
+            else
+                removed[i] = true;
+        }
+    }
+    updateSSA(f, removed);
+}
@@ -0,0 +1,23 @@
+/**
+ * This module propagates constants through a function in SSA form,
+ * by sparse conditional constant propagation (Wegman and Zadeck).
+ *
+ * A name is undefined until a definition in a block found executable
+ * gives it a constant, or proves it's not one; a name never goes back
+ * up. Blocks are executable if an edge to them is, an edge is if its
+ * block is and its branch may be taken. So a constant comparison
+ * leaves the branch not taken unexecutable, and values on it don't
+ * spoil phis it goes to.
+ *
+ * Then uses of constant names become literals, their definitions are
+ * removed, a branch of constants becomes a GOTO or nothing, and its
+ * edge not taken is removed with the blocks it was the only way to.
+ */
+#ifndef SCCP_H_
+#define SCCP_H_
+
+#include "ssa.h"
+
+void propagateConstants(SsaFunction &f);
+
+#endif // SCCP_H_
@@ -0,0 +1,201 @@
+#include <string>       // string
+#include <vector>       // vector
+#include <fstream>      // ifstream
+#include <cassert>      // assert
+#include <algorithm>    // upper_bound
+#if defined(__unix__) || defined(__APPLE__)
+#define SOURCE_USE_MMAP
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#endif
+#include "source.h"
+#include "scan.h"
+
+
+/* file-scope global variables */
+static const char          *src_begin = NULL;   // first character
+static const char          *src_end = NULL;     // one past last character
+static bool                 src_mapped = false; // unmap or delete?
+static std::vector<char>    src_buffer;         // used if not mapped
+/**
+ * line_begin[i] is the offset of line i+1, line_end[i] is
+ * the offset of its line break (or end of file).
+ */
+static std::vector<unsigned int> line_begin;
+static std::vector<unsigned int> line_end;
+
+#define NO_STOP ((size_t)-1)
+
+static void buildLineTable();
+static bool scanLines(size_t from, size_t stop);
+
+
+bool loadSource(const std::string &filename)
+{
+    unloadSource();
+#ifdef SOURCE_USE_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            src_begin = (const char *)addr;
+            src_end = src_begin + st.st_size;
+            src_mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (!src_mapped) {
+        // fall back to a single read of the whole file
+        std::ifstream in(filename, std::ios::in | std::ios::binary);
+        if (!in)
+            return false;
+        in.seekg(0, std::ios::end);
+        std::streamoff size = in.tellg();
+        in.seekg(0, std::ios::beg);
+        src_buffer.resize(size > 0 ? (size_t)size : 0);
+        if (size > 0)
+            in.read(&src_buffer[0], size);
+        src_begin = src_buffer.data();
+        src_end = src_begin + src_buffer.size();
+    }
+    buildLineTable();
+    return true;
+}
+
+void loadSourceText(const char *text, size_t size)
+{
+    unloadSource();
+    src_begin = text;
+    src_end = text + size;
+    buildLineTable();
+}
+
+void unloadSource()
+{
+#ifdef SOURCE_USE_MMAP
+    if (src_mapped)
+        munmap((void *)src_begin, src_end - src_begin);
+#endif
+    src_mapped = false;
+    src_buffer.clear();
+    src_begin = src_end = NULL;
+    line_begin.clear();
+    line_end.clear();
+}
+
+const char *sourceText()
+{
+    return src_begin;
+}
+
+size_t sourceSize()
+{
+    return src_end - src_begin;
+}
+
+void editSourceText(const char *text, size_t size,
+        size_t begin, size_t old_end, size_t new_end)
+{
+    size_t delta = new_end - old_end;   // modulo 2^n
+    // a line break may be joined with or split from the characters
+    // next to the change (e.g. "\r" and "\n"), so scanning starts
+    // from the line before, and stops at a line beginning at least
+    // 2 characters after the change, whose line break is unchanged
+    size_t first = std::upper_bound(line_begin.begin(), line_begin.end(),
+            begin) - line_begin.begin() - 1;
+    if (first != 0)
+        first--;
+    size_t last = std::upper_bound(line_begin.begin(), line_begin.end(),
+            old_end + 1) - line_begin.begin();
+    std::vector<unsigned int> kept_begin(line_begin.begin() + last,
+            line_begin.end());
+    std::vector<unsigned int> kept_end(line_end.begin() + last,
+            line_end.end());
+    size_t from = line_begin[first];
+    line_begin.resize(first);
+    line_end.resize(first);
+    src_begin = text;
+    src_end = text + size;
+    if (!scanLines(from, kept_begin.empty() ? NO_STOP : kept_begin[0] + delta))
+        return;
+    for (size_t i = 0; i < kept_begin.size(); i++) {
+        line_begin.push_back(kept_begin[i] + delta);
+        line_end.push_back(kept_end[i] + delta);
+    }
+}
+
+static void buildLineTable()
+{
+    scanLines(0, NO_STOP);
+}
+
+/**
+ * Add lines beginning from offset `from` to the line table, until
+ * the line beginning at `stop`, which is not added. Return false if
+ * the end of source is reached instead.
+ */
+static bool scanLines(size_t from, size_t stop)
+{
+    const char *p = src_begin + from;
+    const char *line = p;
+    while ((p += scanLineChars(p, src_end)) != src_end) {
+        line_begin.push_back(line - src_begin);
+        line_end.push_back(p - src_begin);
+        // "\r\n" is one line break
+        if (*p == '\r' && p + 1 != src_end && p[1] == '\n')
+            p++;
+        line = ++p;
+        if ((size_t)(line - src_begin) == stop)
+            return true;
+    }
+    // text after the last line break is always a line, and the
+    // source always ends with an empty line
+    line_begin.push_back(line - src_begin);
+    line_end.push_back(src_end - src_begin);
+    if (line != src_end) {
+        line_begin.push_back(src_end - src_begin);
+        line_end.push_back(src_end - src_begin);
+    }
+    return false;
+}
+
+unsigned int sourceLineCount()
+{
+    return line_begin.size();
+}
+
+const char *sourceLineBegin(unsigned int line_no)
+{
+    assert(line_no >= 1 && line_no <= line_begin.size());
+    return src_begin + line_begin[line_no - 1];
+}
+
+unsigned int sourceLineLength(unsigned int line_no)
+{
+    assert(line_no >= 1 && line_no <= line_begin.size());
+    return line_end[line_no - 1] - line_begin[line_no - 1];
+}
+
+unsigned int sourceLineOf(size_t offset)
+{
+    // the last line whose beginning is not after `offset`
+    auto it = std::upper_bound(line_begin.begin(), line_begin.end(), offset);
+    assert(it != line_begin.begin());
+    return it - line_begin.begin();
+}
+
+std::string sourceLine(unsigned int line_no)
+{
+    // the source always ends with an empty line, see scanLines()
+    if (line_no < 1 || line_no >= line_begin.size())
+        return "";
+    std::string line(sourceLineBegin(line_no), sourceLineLength(line_no));
+    line.push_back('\n');
+    return line;
+}
@@ -0,0 +1,61 @@
+/**
+ * This module holds the whole source file in memory.
+ *
+ * The file is mapped once with mmap (or read with a single read on
+ * platforms without mmap), the lexer walks it with a raw pointer and
+ * a table of line-start offsets is used to find line text for error
+ * messages, so no per-line string copies are made.
+ */
+#ifndef SOURCE_H_
+#define SOURCE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Load `filename` into memory and build the line table.
+ * Return false if the file can't be opened.
+ */
+bool loadSource(const std::string &filename);
+/**
+ * Use `size` characters at `text` as source code, e.g. a document
+ * kept by the language server. The text is not copied, it must
+ * live until the source is unloaded or loaded again.
+ */
+void loadSourceText(const char *text, size_t size);
+/**
+ * Characters [begin, old_end) of the loaded text are replaced, and
+ * they are [begin, new_end) of `text` now. Only entries of changed
+ * lines in the line table are built again.
+ */
+void editSourceText(const char *text, size_t size,
+        size_t begin, size_t old_end, size_t new_end);
+void unloadSource();
+/* the whole loaded text, e.g. of a binary file */
+const char *sourceText();
+size_t sourceSize();
+
+/**
+ * Number of lines of source code. A line break is "\n", "\r\n"
+ * or a single "\r". Source code always ends with an empty line,
+ * which is where "program incomplete" errors are reported.
+ */
+unsigned int sourceLineCount();
+/**
+ * Get text of line `line_no` (1-based) without line break.
+ */
+const char *sourceLineBegin(unsigned int line_no);
+unsigned int sourceLineLength(unsigned int line_no);
+/**
+ * Line (1-based) of the character at `offset`,
+ * or of the line break at `offset`.
+ */
+unsigned int sourceLineOf(size_t offset);
+/**
+ * Get a copy of line `line_no` with a trailing '\n', or "" for the
+ * empty line at end of file, only used for printing error messages.
+ */
+std::string sourceLine(unsigned int line_no);
+
+#endif // SOURCE_H_
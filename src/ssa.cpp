@@ -0,0 +1,636 @@
+#include <vector>       // vector
+#include <utility>      // pair
+#include <algorithm>    // sort, find
+#include <cassert>      // assert
+#include "ssa.h"
+#include "dataflow.h"
+#include "table.h"
+
+
+/* a copy of an edge, destination and source */
+typedef std::pair<Operand, Operand> Copy;
+
+/* an edge taken by a branch to a join point gets its own block for copies */
+struct SplitEdge {
+    Operand             label;      // of the new block
+    std::vector<Copy>   copies;
+    Operand             target;     // label of the join point
+};
+
+static void findVariables(SsaFunction &f);
+static void placePhis(SsaFunction &f);
+static void renameVariables(SsaFunction &f);
+static int newName(SsaFunction &f, int var, int block, int def);
+static bool fallsThrough(const SsaFunction &f, int block);
+static void findLiveNames(const SsaFunction &f, VariableBits &names,
+        DataflowResult &live);
+static void findConflicts(const SsaFunction &f, const VariableBits &bits,
+        const DataflowResult &flow,
+        std::vector<std::vector<int> > &conflicts);
+static void assignStorage(const SsaFunction &f,
+        const std::vector<std::vector<int> > &conflicts,
+        std::vector<Operand> &storage, std::vector<FourTuple> &decls);
+static Operand newTemp(DataType dtype, std::vector<FourTuple> &decls);
+static void edgeCopies(const SsaFunction &f,
+        const std::vector<Operand> &storage, int from, int to,
+        std::vector<Copy> &copies);
+static void sequentialize(std::vector<Copy> &copies, MidCodes &out,
+        Operand &swap, std::vector<FourTuple> &decls);
+
+
+size_t buildSSA(const MidCodes &codes, size_t begin, SsaFunction &f)
+{
+    assert(codes.op(begin) == FUNC);
+    size_t end = begin + 1;
+    while (codes.op(end) != END)
+        end++;
+    end++;
+    f.codes.clear();
+    f.codes.append(codes.opArray() + begin,
+            codes.kindArray() + begin * SLOT_COUNT,
+            codes.valueArray() + begin * SLOT_COUNT, end - begin);
+    buildCFG(f.codes, 0, f.cfg);
+    buildDominators(f.cfg, f.dom);
+    f.phis.assign(f.cfg.blocks.size(), std::vector<Phi>());
+    f.names.clear();
+    findVariables(f);
+    placePhis(f);
+    renameVariables(f);
+    return end;
+}
+
+static void findVariables(SsaFunction &f)
+{
+    f.vars.clear();
+    for (size_t i = 0; i < f.codes.size(); i++) {
+        for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+            Operand t = f.codes.operand(i, (OperandSlot)slot);
+            int v = localVariable(t);
+            if (v < 0)
+                continue;
+            if ((size_t)v >= f.vars.size())
+                f.vars.resize(v + 1, NONE);
+            f.vars[v] = t;
+        }
+    }
+}
+
+/**
+ * Only variables used in a block before it's defined there can be
+ * live across blocks, phis are placed for them where they are live.
+ */
+static void placePhis(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    size_t n = cfg.blocks.size();
+    Liveness liveness;
+    findLiveVariables(f.codes, cfg, liveness);
+    const VariableBits &vars = liveness.vars;
+    const std::vector<BitSet> &live_in = liveness.live.in;
+
+    std::vector<int> defined_in(vars.var.size(), -1);   // last block
+    std::vector<std::vector<int> > def_blocks(vars.var.size());
+    for (int b : cfg.rpo) {
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OperandSlot slot = defSlot(f.codes.op(i));
+            int k = (slot == SLOT_COUNT ? -1 :
+                    vars.bitOf(f.codes.operand(i, slot)));
+            if (k >= 0 && defined_in[k] != b) {
+                defined_in[k] = b;
+                def_blocks[k].push_back(b);
+            }
+        }
+    }
+
+    // a definition needs phis at its iterated dominance frontier
+    std::vector<int> has_phi(n, -1), queued(n, -1);
+    std::vector<int> work;
+    for (size_t k = 0; k < vars.var.size(); k++) {
+        int v = vars.var[k];
+        work = def_blocks[k];
+        for (int b : work)
+            queued[b] = v;
+        while (!work.empty()) {
+            int x = work.back();
+            work.pop_back();
+            for (int y : f.dom.frontier[x]) {
+                if (has_phi[y] == v || !live_in[y].test(k))
+                    continue;
+                has_phi[y] = v;
+                Phi phi;
+                phi.name = newName(f, v, y, SSA_PHI);
+                phi.args.assign(cfg.blocks[y].preds.size(), NONE);
+                f.phis[y].push_back(phi);
+                if (queued[y] != v) {
+                    queued[y] = v;
+                    work.push_back(y);
+                }
+            }
+        }
+    }
+}
+
+/* walk the dominator tree with an explicit stack, see dom.cpp */
+static void renameVariables(SsaFunction &f)
+{
+    const FunctionCFG &cfg = f.cfg;
+    std::vector<int> current(f.vars.size(), -1);    // name of each variable
+    std::vector<int> entry_names(f.vars.size(), -1);
+    // variables defined on the path down the tree, with names before
+    std::vector<std::pair<int, int> > undo;
+    auto nameOf = [&](int v) {
+        if (current[v] >= 0)
+            return current[v];
+        if (entry_names[v] < 0)
+            entry_names[v] = newName(f, v, cfg.entry, SSA_ENTRY);
+        return entry_names[v];
+    };
+    auto define = [&](int v, int name) {
+        undo.push_back(std::make_pair(v, current[v]));
+        current[v] = name;
+    };
+    auto renameBlock = [&](int b) {
+        for (const Phi &phi : f.phis[b])
+            define(f.names[phi.name].var, phi.name);
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            OpCode op = f.codes.op(i);
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                if (!usesSlot(op, (OperandSlot)slot))
+                    continue;
+                int v = localVariable(f.codes.operand(i, (OperandSlot)slot));
+                if (v >= 0)
+                    f.codes.setOperand(i, (OperandSlot)slot,
+                            makeOperand(OPD_SSA, nameOf(v)));
+            }
+            OperandSlot slot = defSlot(op);
+            int v = (slot == SLOT_COUNT ? -1 :
+                    localVariable(f.codes.operand(i, slot)));
+            if (v >= 0) {
+                int name = newName(f, v, b, i);
+                f.codes.setOperand(i, slot, makeOperand(OPD_SSA, name));
+                define(v, name);
+            }
+        }
+        for (int s : block.succs) {
+            int j = predIndex(cfg, b, s);
+            for (Phi &phi : f.phis[s])
+                phi.args[j] = makeOperand(OPD_SSA,
+                        nameOf(f.names[phi.name].var));
+        }
+    };
+
+    // blocks on the path, with their next child and undo mark
+    struct Visit {
+        int     block;
+        size_t  child;
+        size_t  undo;
+    };
+    std::vector<Visit> path;
+    Visit root = { cfg.entry, 0, 0 };
+    path.push_back(root);
+    renameBlock(cfg.entry);
+    while (!path.empty()) {
+        Visit &top = path.back();
+        const std::vector<int> &children = f.dom.children[top.block];
+        if (top.child < children.size()) {
+            Visit next = { children[top.child++], 0, undo.size() };
+            path.push_back(next);
+            renameBlock(next.block);
+        } else {
+            while (undo.size() > top.undo) {
+                current[undo.back().first] = undo.back().second;
+                undo.pop_back();
+            }
+            path.pop_back();
+        }
+    }
+}
+
+static int newName(SsaFunction &f, int var, int block, int def)
+{
+    SsaName name = { var, block, def };
+    f.names.push_back(name);
+    return f.names.size() - 1;
+}
+
+
+void removeEdge(SsaFunction &f, int from, int to)
+{
+    int j = predIndex(f.cfg, from, to);
+    for (Phi &phi : f.phis[to])
+        phi.args.erase(phi.args.begin() + j);
+    removeEdge(f.cfg, from, to);
+}
+
+void updateSSA(SsaFunction &f, std::vector<bool> &removed)
+{
+    FunctionCFG &cfg = f.cfg;
+    findReversePostorder(cfg);
+    std::vector<bool> reachable(cfg.blocks.size(), false);
+    for (int b : cfg.rpo)
+        reachable[b] = true;
+    for (size_t k = 0; k < cfg.blocks.size(); k++) {
+        if (reachable[k])
+            continue;
+        const BasicBlock &block = cfg.blocks[k];
+        if (f.dom.reachable(k)) {
+            // codes are renamed, they can't be left as unreachable ones
+            // are; temp vars declared keep their frame slots
+            for (size_t i = block.begin; i < block.end; i++) {
+                OpCode op = f.codes.op(i);
+                removed[i] = removed[i] || (op != LABEL && op != TEMP);
+            }
+        }
+        f.phis[k].clear();
+        while (!block.succs.empty())
+            removeEdge(f, k, block.succs.back());
+    }
+
+    // new index of each code, and of the end
+    std::vector<size_t> moved(f.codes.size() + 1);
+    size_t n = 0;
+    for (size_t i = 0; i < f.codes.size(); i++) {
+        moved[i] = n;
+        n += !removed[i];
+    }
+    moved[f.codes.size()] = n;
+    for (SsaName &name : f.names) {
+        if (name.def >= 0)
+            name.def = (removed[name.def] ? SSA_DEAD : (int)moved[name.def]);
+    }
+    for (BasicBlock &block : cfg.blocks) {
+        block.begin = moved[block.begin];
+        block.end = moved[block.end];
+    }
+    cfg.end = moved[cfg.end];
+    f.codes.remove(removed);
+    buildDominators(cfg, f.dom);
+}
+
+void moveCodes(SsaFunction &f, const std::vector<int> &to,
+        const std::vector<std::vector<FourTuple> > &added)
+{
+    FunctionCFG &cfg = f.cfg;
+    std::vector<std::vector<size_t> > moved_in(cfg.blocks.size());
+    for (size_t i = 0; i < to.size(); i++) {
+        if (to[i] >= 0)
+            moved_in[to[i]].push_back(i);
+    }
+    MidCodes codes;
+    std::vector<size_t> moved(f.codes.size());     // new index of each code
+    std::vector<std::pair<int, size_t> > added_defs;
+    auto put = [&](size_t i) {
+        moved[i] = codes.size();
+        codes.push(f.codes[i]);
+    };
+    for (size_t k = 0; k < cfg.blocks.size(); k++) {
+        BasicBlock &block = cfg.blocks[k];
+        size_t jump = block.end;        // a COMPARE goes with its branch
+        if (block.begin < block.end) {
+            OpCode op = f.codes.op(block.end - 1);
+            if (op == GOTO || op == RET)
+                jump = block.end - 1;
+            else if (op == BZ || op == BNZ)
+                jump = block.end - 2;
+        }
+        size_t begin = codes.size();
+        for (size_t i = block.begin; i < jump; i++) {
+            if (to[i] < 0)
+                put(i);
+        }
+        for (size_t i : moved_in[k])
+            put(i);
+        for (const FourTuple &t : added[k]) {
+            if (defSlot(t.op) == SLOT_RES && t.res.kind == OPD_SSA)
+                added_defs.push_back(std::make_pair(t.res.value, codes.size()));
+            codes.push(t);
+        }
+        for (size_t i = jump; i < block.end; i++)
+            put(i);
+        block.begin = begin;
+        block.end = codes.size();
+    }
+    for (SsaName &name : f.names) {
+        if (name.def >= 0)
+            name.def = moved[name.def];
+    }
+    for (const std::pair<int, size_t> &t : added_defs)
+        f.names[t.first].def = t.second;
+    cfg.end = codes.size();
+    std::swap(f.codes, codes);
+}
+
+/* the block has no jump at its end, it may be empty */
+static bool fallsThrough(const SsaFunction &f, int block)
+{
+    const BasicBlock &b = f.cfg.blocks[block];
+    if (b.begin == b.end)
+        return true;
+    OpCode op = f.codes.op(b.end - 1);
+    return op != GOTO && op != RET;
+}
+
+
+void leaveSSA(const SsaFunction &f, MidCodes &out)
+{
+    VariableBits names;
+    DataflowResult live;
+    std::vector<std::vector<int> > conflicts;
+    std::vector<Operand> storage;
+    std::vector<FourTuple> decls;       // of new temp vars
+    findLiveNames(f, names, live);
+    findConflicts(f, names, live, conflicts);
+    assignStorage(f, conflicts, storage, decls);
+
+    const FunctionCFG &cfg = f.cfg;
+    auto store = [&](Operand t) {
+        return t.kind == OPD_SSA ? storage[t.value] : t;
+    };
+    std::vector<Copy> copies;
+    std::vector<SplitEdge> splits;
+    Operand swap = NONE;
+    for (int k = 0; k < cfg.exit; k++) {
+        const BasicBlock &block = cfg.blocks[k];
+        if (!f.dom.reachable(k)) {
+            // never runs, its codes are not renamed
+            out.append(f.codes.opArray() + block.begin,
+                    f.codes.kindArray() + block.begin * SLOT_COUNT,
+                    f.codes.valueArray() + block.begin * SLOT_COUNT,
+                    block.end - block.begin);
+            continue;
+        }
+        size_t last = block.end - 1;     // not used if it's empty
+        OpCode last_op = (block.begin < block.end ? f.codes.op(last) : LABEL);
+        bool branch = (last_op == BZ || last_op == BNZ);
+        int target = (branch || last_op == GOTO ? block.succs.back() : -1);
+        for (size_t i = block.begin; i < block.end; i++) {
+            FourTuple t = f.codes[i];
+            t.a = store(t.a);
+            t.b = store(t.b);
+            t.res = store(t.res);
+            if (i == last && last_op == GOTO) {
+                edgeCopies(f, storage, k, target, copies);
+                sequentialize(copies, out, swap, decls);
+            }
+            if (i == last && branch) {
+                edgeCopies(f, storage, k, target, copies);
+                if (!copies.empty()) {
+                    SplitEdge split = { genLabel(), copies, t.a };
+                    splits.push_back(split);
+                    t.a = split.label;
+                }
+            }
+            if (t.op == ASSIGN && t.a == t.res)
+                continue;
+            out.push(t);
+        }
+        if (fallsThrough(f, k)) {
+            // copies of the edge falling through, after the branch
+            edgeCopies(f, storage, k, k + 1, copies);
+            sequentialize(copies, out, swap, decls);
+        }
+    }
+    if (!splits.empty()) {
+        // the last block falls through to END, but not to blocks below
+        if (fallsThrough(f, cfg.exit - 1))
+            out.push(FourTuple{ RET, NONE, NONE, NONE });
+    }
+    for (SplitEdge &split : splits) {
+        out.push(FourTuple{ LABEL, split.label, NONE, NONE });
+        sequentialize(split.copies, out, swap, decls);
+        out.push(FourTuple{ GOTO, split.target, NONE, NONE });
+    }
+    for (const FourTuple &t : decls)
+        out.push(t);
+    out.push(f.codes[cfg.blocks[cfg.exit].begin]);
+}
+
+/**
+ * Find names live in and out of each block, only those used out of
+ * their blocks have bits. A phi reads its argument at the end of the
+ * predecessor, and defines its name at the beginning of its block.
+ */
+static void findLiveNames(const SsaFunction &f, VariableBits &names,
+        DataflowResult &live)
+{
+    const FunctionCFG &cfg = f.cfg;
+    names.bit.assign(f.names.size(), -1);
+    names.var.clear();
+    auto mark = [&](Operand t) {
+        if (t.kind == OPD_SSA && names.bit[t.value] < 0) {
+            names.bit[t.value] = names.var.size();
+            names.var.push_back(t.value);
+        }
+    };
+    for (int b : cfg.rpo) {
+        for (const Phi &phi : f.phis[b]) {
+            mark(makeOperand(OPD_SSA, phi.name));
+            for (const Operand &arg : phi.args)
+                mark(arg);
+        }
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.begin; i < block.end; i++) {
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind == OPD_SSA && f.names[t.value].block != b)
+                    mark(t);
+            }
+        }
+    }
+
+    // a name is defined once, its uses out of its block are upward
+    // exposed, and a use in its block follows the definition
+    DataflowProblem problem;
+    problem.init(cfg, FLOW_BACKWARD, FLOW_UNION, names.var.size());
+    problem.edge_gen.assign(cfg.blocks.size(), BitSet(names.var.size()));
+    for (int b : cfg.rpo) {
+        for (const Phi &phi : f.phis[b])
+            problem.kill[b].set(names.bit[phi.name]);
+        const BasicBlock &block = cfg.blocks[b];
+        for (int s : block.succs) {
+            int j = predIndex(cfg, b, s);
+            for (const Phi &phi : f.phis[s]) {
+                if (phi.args[j].kind == OPD_SSA)
+                    problem.edge_gen[b].set(names.bit[phi.args[j].value]);
+            }
+        }
+        for (size_t i = block.begin; i < block.end; i++) {
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind != OPD_SSA || names.bit[t.value] < 0)
+                    continue;
+                if (f.names[t.value].block != b)
+                    problem.gen[b].set(names.bit[t.value]);
+                else
+                    problem.kill[b].set(names.bit[t.value]);
+            }
+        }
+    }
+    solveDataflow(cfg, problem, live);
+}
+
+/**
+ * Two versions of a variable conflict if one is live where the other
+ * is defined, they can't be stored in the variable together. The
+ * source of a copy holds the same value, it doesn't conflict.
+ */
+static void findConflicts(const SsaFunction &f, const VariableBits &bits,
+        const DataflowResult &flow,
+        std::vector<std::vector<int> > &conflicts)
+{
+    const FunctionCFG &cfg = f.cfg;
+    conflicts.assign(f.names.size(), std::vector<int>());
+    // live names of each variable, going up a block
+    std::vector<std::vector<int> > live(f.vars.size());
+    std::vector<int> touched;
+    auto addLive = [&](int name) {
+        std::vector<int> &names = live[f.names[name].var];
+        if (std::find(names.begin(), names.end(), name) != names.end())
+            return;
+        if (names.empty())
+            touched.push_back(f.names[name].var);
+        names.push_back(name);
+    };
+    auto define = [&](int name, int copied) {
+        std::vector<int> &names = live[f.names[name].var];
+        for (int x : names) {
+            if (x != name && x != copied) {
+                conflicts[name].push_back(x);
+                conflicts[x].push_back(name);
+            }
+        }
+        names.erase(std::remove(names.begin(), names.end(), name),
+                names.end());
+    };
+
+    for (int b : cfg.rpo) {
+        flow.out[b].forEach([&](size_t k) { addLive(bits.var[k]); });
+        const BasicBlock &block = cfg.blocks[b];
+        for (size_t i = block.end; i-- > block.begin; ) {
+            OpCode op = f.codes.op(i);
+            OperandSlot slot = defSlot(op);
+            Operand def = (slot == SLOT_COUNT ? NONE : f.codes.operand(i, slot));
+            if (def.kind == OPD_SSA) {
+                Operand a = f.codes.operand(i, SLOT_A);
+                int copied = (op == ASSIGN && a.kind == OPD_SSA ? a.value : -1);
+                define(def.value, copied);
+            }
+            for (int slot = SLOT_A; slot < SLOT_COUNT; slot++) {
+                Operand t = f.codes.operand(i, (OperandSlot)slot);
+                if (t.kind == OPD_SSA && usesSlot(op, (OperandSlot)slot))
+                    addLive(t.value);
+            }
+        }
+        for (const Phi &phi : f.phis[b])
+            define(phi.name, -1);
+        for (int v : touched)
+            live[v].clear();
+        touched.clear();
+    }
+}
+
+/**
+ * Versions of a variable are stored in the variable if they don't
+ * conflict, the others in new temp vars, first fit in order of
+ * definitions down the dominator tree.
+ */
+static void assignStorage(const SsaFunction &f,
+        const std::vector<std::vector<int> > &conflicts,
+        std::vector<Operand> &storage, std::vector<FourTuple> &decls)
+{
+    std::vector<int> order(f.names.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](int x, int y) {
+        const SsaName &a = f.names[x], &b = f.names[y];
+        if (a.var != b.var)
+            return a.var < b.var;
+        if (a.block != b.block)
+            return f.dom.pre[a.block] < f.dom.pre[b.block];
+        return a.def < b.def;
+    });
+    // storage of each name: 0 for its variable, k for k-th new temp var
+    std::vector<int> cell(f.names.size(), -1);
+    std::vector<Operand> temps;     // of the variable
+    std::vector<bool> taken;
+    storage.assign(f.names.size(), NONE);
+    for (size_t k = 0; k < order.size(); k++) {
+        int name = order[k];
+        int var = f.names[name].var;
+        if (k == 0 || f.names[order[k - 1]].var != var)
+            temps.clear();
+        taken.assign(temps.size() + 1, false);
+        for (int x : conflicts[name]) {
+            if (cell[x] >= 0)
+                taken[cell[x]] = true;
+        }
+        int c = std::find(taken.begin(), taken.end(), false) - taken.begin();
+        if (c > (int)temps.size())
+            temps.push_back(newTemp(tabEntry(var | TAB_LOCAL).dtype, decls));
+        cell[name] = c;
+        storage[name] = (c == 0 ? f.vars[var] : temps[c - 1]);
+    }
+}
+
+static Operand newTemp(DataType dtype, std::vector<FourTuple> &decls)
+{
+    Operand t = makeOperand(OPD_TEMP, tabNextTemp());
+    tabInsertTemp(t.value, dtype);
+    decls.push_back(FourTuple{ TEMP, typeOperand(dtype), t, NONE });
+    return t;
+}
+
+static void edgeCopies(const SsaFunction &f,
+        const std::vector<Operand> &storage, int from, int to,
+        std::vector<Copy> &copies)
+{
+    copies.clear();
+    if (f.phis[to].empty())
+        return;
+    int j = predIndex(f.cfg, from, to);
+    for (const Phi &phi : f.phis[to]) {
+        Operand arg = phi.args[j];
+        assert(arg != NONE);
+        if (arg.kind == OPD_SSA)
+            arg = storage[arg.value];
+        // a copy to itself does nothing
+        if (arg != storage[phi.name])
+            copies.push_back(Copy(storage[phi.name], arg));
+    }
+}
+
+/**
+ * Put copies that happen at once in order, none of them is a copy to
+ * itself: a copy is done when its
+ * destination is no other's source. What's left are cycles, a cycle
+ * is broken by saving a destination in temp var `swap`.
+ */
+static void sequentialize(std::vector<Copy> &copies, MidCodes &out,
+        Operand &swap, std::vector<FourTuple> &decls)
+{
+    while (!copies.empty()) {
+        size_t k = 0;
+        for (; k < copies.size(); k++) {
+            bool read = false;
+            for (const Copy &c : copies)
+                read = read || c.second == copies[k].first;
+            if (!read)
+                break;
+        }
+        if (k == copies.size()) {
+            if (swap == NONE)
+                swap = newTemp(DT_INT, decls);
+            Operand saved = copies[0].first;
+            out.push(FourTuple{ ASSIGN, saved, NONE, swap });
+            for (Copy &c : copies) {
+                if (c.second == saved)
+                    c.second = swap;
+            }
+            k = 0;
+        }
+        out.push(FourTuple{ ASSIGN, copies[k].second, NONE, copies[k].first });
+        copies.erase(copies.begin() + k);
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * This module puts a function's mid-code in SSA form, and takes it
+ * out of SSA form again for the code generator.
+ *
+ * Local variables, parameters and temp vars are renamed: each
+ * definition gets a new SSA name (an OPD_SSA operand), and each use
+ * the name of the definition reaching it. Phis are placed at the
+ * iterated dominance frontiers of definitions, only where the
+ * variable is live (pruned SSA), and only for variables used out of
+ * the block defining them. Global variables and arrays are memory,
+ * they are not renamed.
+ *
+ * Out of SSA, a name is stored in the variable it's a version of,
+ * unless it's live where another version of the variable is defined
+ * (which happens when optimizations move uses), then in a new temp
+ * var. A phi becomes copies on its incoming edges, the copies of an
+ * edge happen at once, so they are ordered that no source is written
+ * before it's read, and a cycle goes through a temp var.
+ */
+#ifndef SSA_H_
+#define SSA_H_
+
+#include <vector>       // vector
+#include <cstddef>      // size_t
+#include "midcode.h"
+#include "cfg.h"
+#include "dom.h"
+
+#define SSA_ENTRY   (-1)    // value of the variable at function entry
+#define SSA_PHI     (-2)    // defined by a phi of its block
+#define SSA_DEAD    (-3)    // its definition is removed
+
+struct SsaName {
+    int     var;        // local entry of the variable
+    int     block;      // defining block
+    int     def;        // defining code, SSA_ENTRY or SSA_PHI
+};
+
+struct Phi {
+    int                     name;
+    std::vector<Operand>    args;   // one for each predecessor, in order
+};
+
+struct SsaFunction {
+    MidCodes                        codes;      // FUNC to END
+    FunctionCFG                     cfg;
+    DominatorTree                   dom;
+    std::vector<std::vector<Phi> >  phis;       // of each block
+    std::vector<SsaName>            names;
+    /* operand of each local entry renamed, NONE for others */
+    std::vector<Operand>            vars;
+};
+
+/**
+ * Put the function whose FUNC is `codes[begin]` in SSA form in `f`,
+ * its scope must be in use. Codes of unreachable blocks are not
+ * renamed. Return where the next function begins.
+ */
+size_t buildSSA(const MidCodes &codes, size_t begin, SsaFunction &f);
+/**
+ * Optimizations change a function in SSA form in place: codes may be
+ * replaced with `f.codes.set()`, or marked to be removed. A jump
+ * removed or turned into another takes its edges with it, see
+ * removeEdge(); a block falls through to the next one if its last
+ * code is no jump, so blocks can be emptied.
+ */
+/* remove the edge from block `from` to `to`, and its phi arguments */
+void removeEdge(SsaFunction &f, int from, int to);
+/**
+ * Remove codes marked in `removed`, then find blocks reachable and
+ * dominators again. Blocks not reachable lose their phis and
+ * edges, those no longer reachable their codes but labels (which dead
+ * code may still jump to) and temp var declarations.
+ */
+void updateSSA(SsaFunction &f, std::vector<bool> &removed);
+/**
+ * Move codes with `to[i] >= 0` to the end of block `to[i]`, before
+ * its jump, in the order they were, then put codes `added[b]` there
+ * too. Edges are left as they are, so are phis and dominators; blocks
+ * of names defined by codes moved or added are not, the caller knows
+ * them (a name defined by a code added must have no def yet).
+ */
+void moveCodes(SsaFunction &f, const std::vector<int> &to,
+        const std::vector<std::vector<FourTuple> > &added);
+
+/**
+ * Append codes of `f` out of SSA form to `out`. Temp vars may be
+ * added to the scope in use, its frame must be laid out again.
+ */
+void leaveSSA(const SsaFunction &f, MidCodes &out);
+
+#endif // SSA_H_
@@ -1,49 +1,110 @@
 #include <string>       // string
 #include <iostream>     // cout
-#include <cctype>       // isalpha(), isdigit(), tolower()
+#include <cctype>       // isalpha(), isdigit()
 #include <cstdlib>      // exit()
-#include <cstdio>       // printf()
+#include <cstdio>       // snprintf()
+#include <cstring>      // memcmp()
 #include <sstream>      // stringstream
-#include <iomanip>      // setw()
+#include <thread>       // thread
+#include <cassert>      // assert
 #include "common.h"
 #include "symbol.h"
 #include "error.h"
+#include "source.h"
+#include "scan.h"
+#include "ring.h"
 
 
-/* initialize global variables */
-Symbol          g_sym;          // Type of word read in
-std::string     g_id;           // used if g_sym==IDENT
-char            g_char;         // used if g_sym==CHARVALUE
-int             g_num;          // used if g_sym==INTVALUE
-std::string     g_str;          // used if g_sym==STRVALUE
+/* initialize global variables, one copy for each thread */
+thread_local Symbol         g_sym;          // Type of word read in
+thread_local Name           g_id;           // used if g_sym==IDENT
+thread_local char           g_char;         // used if g_sym==CHARVALUE
+thread_local int            g_num;          // used if g_sym==INTVALUE
+thread_local std::string    g_str;          // used if g_sym==STRVALUE
 
-std::string     g_line = "";    // last line from source code
-unsigned int    g_pos = 0;      // the pos of next character
-unsigned int    g_line_no = 0;  // the No. of current line
-unsigned int    g_word_pos;     // the start pos of current word
+thread_local unsigned int   g_pos = 0;      // the pos of next character
+thread_local unsigned int   g_line_no = 0;  // the No. of current line
+thread_local unsigned int   g_word_pos;     // the start pos of current word
 
-/* file-scope global variable */
-static char         ch = ' ';   // last character read in
+/* file-scope global variable, one copy for each thread */
+static thread_local char         ch = '\n';  // last character read in
+static thread_local const char  *line_ptr = NULL;    // text of current line
+static thread_local unsigned int line_len = 0;       // length without line break
+static thread_local const char  *text_end = NULL;    // end of whole source
 
+/**
+ * In lexer thread mode, scanSymbol() runs on the lexer thread and
+ * every token is sent to parser as a Token through `token_ring`.
+ * The lexer thread never prints, reports errors or exits by itself,
+ * those are sent as tokens too and done by parser when it receives
+ * them. Source lines are echoed by parser up to the line of each
+ * token received, so output is the same as single-thread mode.
+ */
+enum TokenKind {
+    // 0 ~ 63 are Symbol
+    TOKEN_ERROR = 64,   // call error(msg)
+    TOKEN_WARNING,      // print msg and the character in value
+    TOKEN_FATAL,        // print msg and exit
+    TOKEN_END,          // no more source code
+};
+
+struct Token {
+    unsigned char   kind;       // Symbol or TokenKind
+    unsigned int    line_no;    // g_line_no
+    unsigned int    word_pos;   // g_word_pos
+    unsigned int    pos;        // g_pos
+    unsigned int    value;      // name id, integer or character
+    const char     *msg;        // used by TOKEN_ERROR/WARNING/FATAL
+};
+
+/* thrown to unwind the lexer thread when it has nothing more to send */
+struct LexerStop {};
+
+static bool                     lexer_thread_mode = false;
+static SpscRing<Token, 4096>    token_ring;
+
+static void scanSymbol();
+static void receiveSymbol();
+static void sendToken(int kind, unsigned int value, const char *msg);
+static void lexError(const char *msg);
+static void lexWarning(const char *msg, char c);
+static void lexFatal(const char *msg);
+static void echoLines(unsigned int line_no);
 static bool nextch();
+static void enterLine(unsigned int line_no);
 static void readUnsignedInteger();
 static void readIdentifier();
 static void readString();
 static void readCharacter();
 static bool isBlankCharacter(char c);
+static void skipRun(size_t length);
 
 
 void readSymbol() 
+{
+    if (lexer_thread_mode)
+        receiveSymbol();
+    else
+        scanSymbol();
+}
+
+static void scanSymbol()
 {
 goto_label:
-    while (isBlankCharacter(ch))
-        nextch();
+    while (isBlankCharacter(ch)) {
+        // most words are apart by a single blank, skip it directly
+        if (ch != '\n' && g_pos < line_len &&
+                isBlankCharacter(line_ptr[g_pos]))
+            skipRun(scanBlanks(line_ptr + g_pos - 1, text_end));
+        else
+            nextch();
+    }
     g_word_pos = g_pos - 1;
-    if (std::isdigit(ch)) {
+    if (ch >= '0' && ch <= '9') {
         readUnsignedInteger();
         return;
     }
-    if (std::isalpha(ch) || ch == '_') {
+    if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_') {
         readIdentifier();
         return;
     }
@@ -63,11 +124,8 @@ goto_label:
                   } else g_sym = LSS;
                   break;
         case '!': nextch();
-                  if (ch != '=') {
-                      std::cout << "operater ! is not allowed" 
-                           << std::endl;
-                      std::exit(1);
-                  }
+                  if (ch != '=')
+                      lexFatal("operater ! is not allowed");
                   g_sym = NEQ;
                   nextch();
                   break;
@@ -77,8 +135,8 @@ goto_label:
                       nextch();
                   } else g_sym = BECOMES;
                   break;
-        default: if (char2sym[(int)ch] == 0) {
-                     error(ERR_UNSUPPORTED_CHARACTER);
+        default: if ((unsigned char)ch >= 128 || char2sym[(int)ch] == 0) {
+                     lexError(ERR_UNSUPPORTED_CHARACTER);
                      nextch();
                      goto goto_label;
                  }
@@ -105,17 +163,60 @@ static void readIdentifier()
     /**
      * Important: identifiers is not case-sensitve.
      */
-    g_id.clear();
-    while (std::isdigit(ch) || std::isalpha(ch)
-            || ch == '_') {
-        ch = std::tolower(ch);
-        g_id.push_back(ch);
-        nextch();
+    static thread_local char lower_buf[64];          // identifier in lowercase
+    static thread_local std::string lower_long;      // used if it is longer
+    const char *start = line_ptr + g_pos - 1;
+    size_t length = scanIdentChars(start, text_end);
+    char *lower = lower_buf;
+    if (length > sizeof(lower_buf)) {
+        lower_long.resize(length);
+        lower = &lower_long[0];
     }
-    // map will return 0 if key is not in map,
-    // which is exactly what we want, because
-    // user-defined identifier's enum value is 0
-    g_sym = key2sym[g_id];
+    copyLower(lower, start, length);
+    skipRun(length);
+    // user-defined identifier's enum value is 0(IDENTSY)
+    g_sym = reservedWord(lower, length);
+    if (g_sym == IDENTSY)
+        g_id = intern(lower, length);
+}
+
+/**
+ * This is a perfect hash of reserve words: a word is selected by its
+ * length and first character (and second character for "case" and
+ * "char"), then only one comparison is needed to confirm it.
+ */
+Symbol reservedWord(const char *id, size_t length)
+{
+    const char *word = NULL;
+    Symbol sym = IDENTSY;
+    switch (length) {
+        case 2: if (id[0] == 'i')       { word = "if"; sym = IFSY; }
+                else if (id[0] == 'd')  { word = "do"; sym = DOSY; }
+                break;
+        case 3: if (id[0] == 'i')       { word = "int"; sym = INTSY; }
+                break;
+        case 4: if (id[0] == 'c') {
+                    if (id[1] == 'h')   { word = "char"; sym = CHARSY; }
+                    else                { word = "case"; sym = CASESY; }
+                }
+                else if (id[0] == 'v')  { word = "void"; sym = VOIDSY; }
+                else if (id[0] == 'e')  { word = "else"; sym = ELSESY; }
+                else if (id[0] == 'm')  { word = "main"; sym = MAINSY; }
+                break;
+        case 5: if (id[0] == 'c')       { word = "const"; sym = CONSTSY; }
+                else if (id[0] == 'w')  { word = "while"; sym = WHILESY; }
+                else if (id[0] == 's')  { word = "scanf"; sym = SCANFSY; }
+                break;
+        case 6: if (id[0] == 's')       { word = "switch"; sym = SWITCHSY; }
+                else if (id[0] == 'p')  { word = "printf"; sym = PRINTFSY; }
+                else if (id[0] == 'r')  { word = "return"; sym = RETURNSY; }
+                break;
+        case 7: if (id[0] == 'd')       { word = "default"; sym = DEFAULTSY; }
+                break;
+    }
+    if (word == NULL || std::memcmp(id, word, length) != 0)
+        return IDENTSY;
+    return sym;
 }
 
 
@@ -129,14 +230,12 @@ static void readCharacter()
     if (ch != '+' && ch != '-' && ch != '*' && 
             ch != '/' && ch != '_' && 
             !std::isdigit(ch) && !std::isalpha(ch)) {
-        std::cout << "Invalid ASCII character in char " 
-            << ch << std::endl;
+        lexWarning("Invalid ASCII character in char ", ch);
     }
     g_char = ch;
     nextch();
     if (ch != '\'') {
-        std::cout << "Single quotation mark missing at char "
-            << ch << std::endl;
+        lexWarning("Single quotation mark missing at char ", ch);
     }
     g_sym = CHARVALUE;
     nextch();
@@ -155,20 +254,21 @@ static void readString()
     nextch();
     while (ch != '\"') {
 		if (ch == '\n') {
-            error(ERR_STRING_NOT_END);
+            lexError(ERR_STRING_NOT_END);
             break;
             // may go to next line and comtinue compiling
 		}
         if (!(ch == 32 || ch == 33 ||
               (ch >= 35 && ch <= 126))) {
-            error(ERR_STRING_INVALID_CHARACTER);
+            lexError(ERR_STRING_INVALID_CHARACTER);
             nextch();
             continue;
         }
-        g_str.push_back(ch);
-        //if (ch == '\\')
-        //    g_str.push_back('\\');
-        nextch();
+        // take all valid characters until '\"' or an invalid one
+        const char *start = line_ptr + g_pos - 1;
+        size_t length = scanStringChars(start, text_end);
+        g_str.append(start, length);
+        skipRun(length);
     }
     g_sym = STRVALUE;
     // next character must be right quotation mark, skip it
@@ -177,83 +277,244 @@ static void readString()
 
 static void readUnsignedInteger() 
 {
+    const char *start = line_ptr + g_pos - 1;
+    size_t length = scanDigits(start, text_end);
     g_num = 0;
-    while (ch >= '0' && ch <= '9') {
-        g_num = 10 * g_num + ch - '0';
-        nextch();
+    for (size_t i = 0; i < length; i++) {
+        g_num = 10 * g_num + start[i] - '0';
     }
+    skipRun(length);
     g_sym = INTVALUE;
 }
 
 /**
- * Used to handle different line break like "\r\n" and "\n"
- * From: https://stackoverflow.com/questions/6089231/
+ * `ch` is the first of `length` characters of current line
+ * found by a scanXXX() kernel, skip them all and read the 
+ * character after them.
+ *
+ * Kernels are given the end of whole source rather than of current
+ * line, none of their classes has '\r' or '\n', so a run never
+ * goes past a line break.
  */
-static std::istream& safeGetline(std::istream& is, std::string& t)
+static void skipRun(size_t length)
 {
-    t.clear();
-    std::istream::sentry se(is, true);
-    std::streambuf* sb = is.rdbuf();
-    for(;;) {
-        int c = sb->sbumpc();
-        switch (c) {
-        case '\n':
-            return is;
-        case '\r':
-            if(sb->sgetc() == '\n')
-                sb->sbumpc();
-            return is;
-        case std::streambuf::traits_type::eof():
-            if(t.empty())
-                is.setstate(std::ios::eofbit);
-            return is;
-        default:
-            t += (char)c;
-        }
-    }
+    g_pos += length - 1;
+    nextch();
 }
 
-
 /**
  * use `check_remaining_flag` to control whether
  * compiler program should exit when no more code
  *
  * return value is used only when check_remaining_flag=true
  */
-static bool check_remaining_flag = false;
+static thread_local bool check_remaining_flag = false;
 static bool nextch() 
 {
-    if (g_pos == g_line.size()) {
-        if (!safeGetline(source_stream, g_line)) {
+    // g_pos == line_len + 1 means the line break is consumed
+    if (g_line_no == 0 || g_pos > line_len) {
+        if (g_line_no == sourceLineCount()) {
             if (check_remaining_flag) {
                 return false;
             }
+            if (lexer_thread_mode) {
+                sendToken(TOKEN_END, 0, NULL);
+                throw LexerStop();
+            }
             error(ERR_PROGRAM_INCOMPLETE);
-            printCachedErrors();
-            std::exit(1);
+            stopCompiling();
         }
-        g_line.push_back('\n');
-        
         g_pos = 0;
         g_line_no++;
-
-        std::cout << std::setw(4) << (int)g_line_no 
-            << " " << g_line;
+        enterLine(g_line_no);
+        if (!lexer_thread_mode && !serverMode())
+            echoLines(g_line_no);
     } 
-    ch = g_line[g_pos];
+    // every line ends with a '\n' no matter what line break is used
+    ch = (g_pos == line_len) ? '\n' : line_ptr[g_pos];
     g_pos++;
     return true;
 }
 
+void seekSource(unsigned int line_no, unsigned int pos)
+{
+    assert(!lexer_thread_mode);
+    check_remaining_flag = false;
+    if (line_no == 0) {
+        // the state before the first readSymbol()
+        g_line_no = g_pos = 0;
+        line_ptr = NULL;
+        line_len = 0;
+        ch = '\n';
+        return;
+    }
+    g_line_no = line_no;
+    enterLine(line_no);
+    g_pos = pos;
+    nextch();
+}
+
+/* make line `line_no` current line, g_pos is not changed */
+static void enterLine(unsigned int line_no)
+{
+    line_ptr = sourceLineBegin(line_no);
+    line_len = sourceLineLength(line_no);
+    text_end = sourceText() + sourceSize();
+}
+
+/**
+ * Print source lines up to line `line_no`, each line is
+ * printed once.
+ */
+static unsigned int echoed_line_no = 0;
+static void echoLines(unsigned int line_no)
+{
+    while (echoed_line_no < line_no) {
+        echoed_line_no++;
+        // same as `cout << setw(4) << echoed_line_no << " "`
+        char number[16];
+        int n = std::snprintf(number, sizeof(number), "%4u ", echoed_line_no);
+        std::cout.write(number, n)
+            .write(sourceLineBegin(echoed_line_no),
+                   sourceLineLength(echoed_line_no))
+            .put('\n');
+    }
+}
+
+void echoSource()
+{
+    echoLines(sourceLineCount());
+}
+
 void extraCodeChecking()
 {
+    if (lexer_thread_mode) {
+        // let the lexer thread stop, words after main are not used
+        Token t = token_ring.pop();
+        while (t.kind != TOKEN_END && t.kind != TOKEN_FATAL)
+            t = token_ring.pop();
+        // the thread is done, read on here as the serial lexer would
+        // after the last word, g_line_no and g_pos are received with it
+        lexer_thread_mode = false;
+        enterLine(g_line_no);
+    }
     check_remaining_flag = true;
     while (nextch()) {
         if (!isBlankCharacter(ch)) {
             error(ERR_REDUNDENT_CODE);
-            printCachedErrors();
-            std::exit(1);
+            stopCompiling();
         }
     }
 }
 
+
+/**
+ * Errors found by lexer, they are reported by parser
+ * in lexer thread mode.
+ */
+static void lexError(const char *msg)
+{
+    if (lexer_thread_mode)
+        sendToken(TOKEN_ERROR, 0, msg);
+    else
+        error(msg);
+}
+
+static void lexWarning(const char *msg, char c)
+{
+    if (lexer_thread_mode)
+        sendToken(TOKEN_WARNING, (unsigned char)c, msg);
+    else if (serverMode())
+        warning(msg + std::string(1, c));
+    else
+        std::cout << msg << c << std::endl;
+}
+
+static void lexFatal(const char *msg)
+{
+    if (lexer_thread_mode) {
+        sendToken(TOKEN_FATAL, 0, msg);
+        throw LexerStop();
+    }
+    if (serverMode()) {
+        error(msg);
+        stopCompiling();
+    }
+    std::cout << msg << std::endl;
+    std::exit(1);
+}
+
+static void sendToken(int kind, unsigned int value, const char *msg)
+{
+    Token t;
+    t.kind = kind;
+    t.line_no = g_line_no;
+    t.word_pos = g_word_pos;
+    t.pos = g_pos;
+    t.value = value;
+    t.msg = msg;
+    token_ring.push(t);
+}
+
+static void lexerThread()
+{
+    try {
+        for (;;) {
+            scanSymbol();
+            unsigned int value = 0;
+            switch (g_sym) {
+                case IDENTSY:   value = g_id.id; break;
+                case INTVALUE:  value = (unsigned int)g_num; break;
+                case CHARVALUE: value = (unsigned char)g_char; break;
+                case STRVALUE:  value = intern(g_str).id; break;
+                default: break;
+            }
+            sendToken(g_sym, value, NULL);
+        }
+    } catch (const LexerStop &) {
+        // TOKEN_END or TOKEN_FATAL is sent
+    }
+}
+
+void startLexerThread()
+{
+    lexer_thread_mode = true;
+    // the thread stops by itself after the last token is sent
+    std::thread(lexerThread).detach();
+}
+
+static void receiveSymbol()
+{
+    for (;;) {
+        Token t = token_ring.pop();
+        echoLines(t.line_no);
+        g_line_no = t.line_no;
+        g_word_pos = t.word_pos;
+        g_pos = t.pos;
+        switch (t.kind) {
+            case TOKEN_ERROR:
+                error(t.msg);
+                continue;
+            case TOKEN_WARNING:
+                std::cout << t.msg << (char)t.value << std::endl;
+                continue;
+            case TOKEN_FATAL:
+                std::cout << t.msg << std::endl;
+                std::exit(1);
+            case TOKEN_END:
+                error(ERR_PROGRAM_INCOMPLETE);
+                stopCompiling();
+        }
+        g_sym = (Symbol)t.kind;
+        switch (g_sym) {
+            case IDENTSY:   g_id = Name(t.value); break;
+            case INTVALUE:  g_num = (int)t.value; break;
+            case CHARVALUE: g_char = (char)t.value; break;
+            case STRVALUE:  g_str.assign(nameText(Name(t.value)),
+                                    nameLength(Name(t.value)));
+                            break;
+            default: break;
+        }
+        return;
+    }
+}
@@ -1,152 +1,211 @@
-/**
- * This module is lexical analyzer
- * it mainly provides getSymbol() function
- */
-#ifndef SYMBOL_H_
-#define SYMBOL_H_
-
-#include <string>
-#include <bitset>           // bitset
-#include <initializer_list> // initializer_list
-#include <iostream>
-#include <vector>
-
-/**
- * Declaring word type enum
- * Types:
- *      1. user-defined identifiers
- *          * function name
- *          * const name
- *          * variable name
- *      2. reserve words
- *      3. delimeters and operators
- */
-enum Symbol {
-    /* User-defined identifiers */
-    IDENTSY=0,  // identifiers
-    /* Reserve Words (or call them key word) */
-    CONSTSY,    // const
-    INTSY,      // int
-    CHARSY,     // char
-    VOIDSY,     // void
-    IFSY,       // if
-    ELSESY,     // else
-    DOSY,       // do
-    WHILESY,    // while
-    SWITCHSY,   // switch
-    CASESY,     // case
-    DEFAULTSY,  // default
-    SCANFSY,    // scanf
-    PRINTFSY,   // printf
-    RETURNSY,   // return
-    MAINSY=15,     // main
-    /* Literals */
-    CHARVALUE,  // character integer literal
-    INTVALUE,   // unsinged integer literal
-    STRVALUE,   // string literal
-    /* Delimeters or Operators */
-    PLUS=19, MINUS, STAR, SLASH,
-    EQL=23, NEQ, LSS, LEQ, GTR, GEQ, 
-    LPARENT=29, RPARENT, LBRACK, RBRACK, LBRACE, RBRACE,
-    BECOMES=35, COMMA, COLON, SEMICOLON=38, 
-};
-
-
-/**
- * This is a custom set class for symbol.
- * Designed for write less code related to error handling.
- * Usage:
- *      // constructor
- *      Symset s1 = { IDENTSY, CONSTY, CHARSY };
- *      Symset s2 = { DOSY, CASESY, WHIlESY };
- *      Symset s3({SEMICOLON, RBRACE, RPARENT});
- *      // add two sets
- *      Symset s4 = s1 + s2;
- *      // check if constains 
- *      s4.contains(IDENTSY);  // true
- */
-class Symset {
-private:
-    // `long long` at least 64 bits, enough for symbols
-    long long bitmap;
-public:
-    Symset():bitmap(0LL) {}
-    Symset(std::initializer_list<int> il) {
-        bitmap = 0LL;
-        for (auto itm : il) {
-            if (itm < 0 || itm >= 64) {
-                std::cout << "values of symset must between 1 and 64"
-                    << std::endl;
-                exit(1);
-            }
-            // (long long) is important
-            bitmap |= (long long)1 << itm;
-        }
-    }
-    bool contains(int item) {
-        return (bool)(((long long)1 << item) & bitmap);
-    }
-    Symset operator+(const Symset &t1) {
-        Symset res;
-        res.bitmap = bitmap | t1.bitmap;
-        return res;
-    }
-    void printBits() const {
-        std::bitset<64> t(bitmap);
-        std::cout << t << std::endl;
-    }
-    std::vector<int> toVector() {
-        std::vector<int> res;
-        for (int i = 0; i < 64; i++) {
-            if (contains(i))
-                res.push_back(i);
-        }
-        return res;
-    }
-};
-
-
-/** NOTE:
- * If there are no static modifier, we will get 
- * multiple definition error, because each file 
- * who includes this will make a app-scrop global
- * variable. This won't cause error when compiling
- * each single .cpp file, but will cause error when
- * linker trys to link .o files.
- * We have two ways to eliminate this error:
- * 1. add static modifier, so that each .cpp file
- *    holds a file-scope global variable. This is
- *    a litttle bit of wasting memory.
- * 2. add extern modifier and define it once in any
- *    one of .cpp files.
- * */
-static std::string tokens[] = {
-    "IDENTSY", "CONSTSY", "INTSY", "CHARSY", "VOIDSY", "IFSY", // 0~5
-    "ELSESY", "DOSY", "WHILESY", "SWITCHSY", "CASESY",         // 6~10
-    "DEFAULTSY", "SCANFSY", "PRINTFSY", "RETURNSY", "MAINSY",  // 11~15
-    "CHARVALUE", "INTVALUE", "STRVALUE",                       // 16~18
-    "PLUS", "MINUS", "STAR", "SLASH",                          // 19~22
-    "EQL", "NEQ", "LSS", "LEQ", "GTR", "GEQ",                  // 23~28
-    "LPARENT", "RPARENT", "lBRACK", "RBRACK", "LBRACE", "RBRACE",
-    "BECOMES", "COMMA", "COLON", "SEMICOLON",
-};
-static std::string sym2str[] = {
-    "identifier", "const", "int", "char", "void", "if",
-    "else", "do", "while", "switch", "case",
-    "default", "scanf", "printf", "return", "main",
-    "char-literal", "int-literal", "str-literal",
-    "\'+\'", "\'-\'", "\'*\'", "\'/\'",
-    "\'==\'", "\'!=\'", "\'<\'", "\'<=\'", "\'>\'", "\'>=\'",
-    "\'(\'", "\')\'", "\'[\'", "\']\'", "\'{\'", "\'}\'", 
-    "\'=\'", "\',\'", "\':\'", "\';\'",
-};
-
-void readSymbol();
-/**
- * For checking remaining code after main function's definition
- * There should be no more extra non-emtpy characters
- */
-void extraCodeChecking();
-
-
-#endif // SYMBOL_H_
+/**
+ * This module is lexical analyzer
+ * it mainly provides getSymbol() function
+ */
+#ifndef SYMBOL_H_
+#define SYMBOL_H_
+
+#include <string>
+#include <cstddef>          // size_t
+#include <bitset>           // bitset
+#include <iostream>
+#include <vector>
+
+/**
+ * Declaring word type enum
+ * Types:
+ *      1. user-defined identifiers
+ *          * function name
+ *          * const name
+ *          * variable name
+ *      2. reserve words
+ *      3. delimeters and operators
+ */
+enum Symbol {
+    /* User-defined identifiers */
+    IDENTSY=0,  // identifiers
+    /* Reserve Words (or call them key word) */
+    CONSTSY,    // const
+    INTSY,      // int
+    CHARSY,     // char
+    VOIDSY,     // void
+    IFSY,       // if
+    ELSESY,     // else
+    DOSY,       // do
+    WHILESY,    // while
+    SWITCHSY,   // switch
+    CASESY,     // case
+    DEFAULTSY,  // default
+    SCANFSY,    // scanf
+    PRINTFSY,   // printf
+    RETURNSY,   // return
+    MAINSY=15,     // main
+    /* Literals */
+    CHARVALUE,  // character integer literal
+    INTVALUE,   // unsinged integer literal
+    STRVALUE,   // string literal
+    /* Delimeters or Operators */
+    PLUS=19, MINUS, STAR, SLASH,
+    EQL=23, NEQ, LSS, LEQ, GTR, GEQ, 
+    LPARENT=29, RPARENT, LBRACK, RBRACK, LBRACE, RBRACE,
+    BECOMES=35, COMMA, COLON, SEMICOLON=38, 
+};
+
+
+/**
+ * This is a custom set class for symbol.
+ * Designed for write less code related to error handling.
+ * All operations are constexpr, sets defined as constexpr
+ * constants are built at compile time, so checking a symbol
+ * is a single AND.
+ * Usage:
+ *      // constructor
+ *      constexpr Symset s1(IDENTSY, CONSTSY, CHARSY);
+ *      constexpr Symset s2(DOSY, CASESY, WHILESY);
+ *      // add two sets
+ *      constexpr Symset s3 = s1 + s2;
+ *      // check if constains
+ *      s3.contains(IDENTSY);  // true
+ */
+class Symset {
+private:
+    // `unsigned long long` at least 64 bits, enough for symbols
+    unsigned long long bitmap;
+
+    struct Bits {};
+    constexpr Symset(Bits, unsigned long long bits): bitmap(bits) {}
+
+    static constexpr unsigned long long bitsOf()
+    {
+        return 0ULL;
+    }
+    // an item out of range fails compiling of a constexpr set
+    template <typename... Items>
+    static constexpr unsigned long long bitsOf(int item, Items... items)
+    {
+        return (item >= 0 && item < 64 ? 1ULL << item :
+                throw "values of symset must between 0 and 63") |
+            bitsOf(items...);
+    }
+public:
+    constexpr Symset(): bitmap(0ULL) {}
+    template <typename... Items>
+    constexpr explicit Symset(int item, Items... items):
+        bitmap(bitsOf(item, items...)) {}
+
+    constexpr bool contains(int item) const {
+        return (bitmap >> item) & 1ULL;
+    }
+    constexpr Symset operator+(const Symset &t1) const {
+        return Symset(Bits(), bitmap | t1.bitmap);
+    }
+    void printBits() const {
+        std::bitset<64> t(bitmap);
+        std::cout << t << std::endl;
+    }
+    std::vector<int> toVector() const {
+        std::vector<int> res;
+        for (int i = 0; i < 64; i++) {
+            if (contains(i))
+                res.push_back(i);
+        }
+        return res;
+    }
+};
+
+
+/** NOTE:
+ * If there are no static modifier, we will get 
+ * multiple definition error, because each file 
+ * who includes this will make a app-scrop global
+ * variable. This won't cause error when compiling
+ * each single .cpp file, but will cause error when
+ * linker trys to link .o files.
+ * We have two ways to eliminate this error:
+ * 1. add static modifier, so that each .cpp file
+ *    holds a file-scope global variable. This is
+ *    a litttle bit of wasting memory.
+ * 2. add extern modifier and define it once in any
+ *    one of .cpp files.
+ * */
+static std::string tokens[] = {
+    "IDENTSY", "CONSTSY", "INTSY", "CHARSY", "VOIDSY", "IFSY", // 0~5
+    "ELSESY", "DOSY", "WHILESY", "SWITCHSY", "CASESY",         // 6~10
+    "DEFAULTSY", "SCANFSY", "PRINTFSY", "RETURNSY", "MAINSY",  // 11~15
+    "CHARVALUE", "INTVALUE", "STRVALUE",                       // 16~18
+    "PLUS", "MINUS", "STAR", "SLASH",                          // 19~22
+    "EQL", "NEQ", "LSS", "LEQ", "GTR", "GEQ",                  // 23~28
+    "LPARENT", "RPARENT", "lBRACK", "RBRACK", "LBRACE", "RBRACE",
+    "BECOMES", "COMMA", "COLON", "SEMICOLON",
+};
+static std::string sym2str[] = {
+    "identifier", "const", "int", "char", "void", "if",
+    "else", "do", "while", "switch", "case",
+    "default", "scanf", "printf", "return", "main",
+    "char-literal", "int-literal", "str-literal",
+    "\'+\'", "\'-\'", "\'*\'", "\'/\'",
+    "\'==\'", "\'!=\'", "\'<\'", "\'<=\'", "\'>\'", "\'>=\'",
+    "\'(\'", "\')\'", "\'[\'", "\']\'", "\'{\'", "\'}\'", 
+    "\'=\'", "\',\'", "\':\'", "\';\'",
+};
+
+/**
+ * Map from single character to symbol, characters which are not
+ * a single-character symbol are mapped to 0(IDENTSY).
+ * The table is built at compile time.
+ */
+constexpr Symbol charSymbol(int c)
+{
+    return c == '+' ? PLUS :    c == '-' ? MINUS :
+           c == '*' ? STAR :    c == '/' ? SLASH :
+           c == '<' ? LSS :     c == '>' ? GTR :
+           c == '(' ? LPARENT : c == ')' ? RPARENT :
+           c == '[' ? LBRACK :  c == ']' ? RBRACK :
+           c == '{' ? LBRACE :  c == '}' ? RBRACE :
+           c == '=' ? BECOMES : c == ',' ? COMMA :
+           c == ':' ? COLON :   c == ';' ? SEMICOLON : IDENTSY;
+}
+#define CHAR_SYMBOL_4(c)    charSymbol(c), charSymbol(c + 1), \
+                            charSymbol(c + 2), charSymbol(c + 3)
+#define CHAR_SYMBOL_16(c)   CHAR_SYMBOL_4(c), CHAR_SYMBOL_4(c + 4), \
+                            CHAR_SYMBOL_4(c + 8), CHAR_SYMBOL_4(c + 12)
+constexpr Symbol char2sym[128] = {
+    CHAR_SYMBOL_16(0),  CHAR_SYMBOL_16(16), CHAR_SYMBOL_16(32),
+    CHAR_SYMBOL_16(48), CHAR_SYMBOL_16(64), CHAR_SYMBOL_16(80),
+    CHAR_SYMBOL_16(96), CHAR_SYMBOL_16(112),
+};
+#undef CHAR_SYMBOL_4
+#undef CHAR_SYMBOL_16
+
+/**
+ * Map from identifier(in lowercase) to symbol, return IDENTSY
+ * if it is not a reserve word.
+ */
+Symbol reservedWord(const char *id, size_t length);
+
+void readSymbol();
+/**
+ * Make the lexer read on from column `pos` (0-based) of line
+ * `line_no`, so the next readSymbol() gets the word there.
+ * Line 0 starts over from the beginning of source.
+ */
+void seekSource(unsigned int line_no, unsigned int pos);
+/**
+ * Run the lexer on its own thread, which sends tokens to
+ * readSymbol() through a ring buffer. Call it before the
+ * first readSymbol().
+ */
+void startLexerThread();
+/**
+ * Print source lines not printed yet, as the lexer does when it
+ * reads them, in case they are read on other threads.
+ */
+void echoSource();
+/**
+ * For checking remaining code after main function's definition
+ * There should be no more extra non-emtpy characters
+ */
+void extraCodeChecking();
+
+
+#endif // SYMBOL_H_
@@ -1,151 +1,391 @@
-#include <unordered_map>    // unordered_map
-#include <cassert>          // assert
-#include <iomanip>          // setw
-#include <map>				// map
-#include <sstream>          // stringstream
-#include "symbol.h"
-#include "table.h"
-#include "error.h"
-
-
-
-/* For global variables */
-static std::unordered_map<std::string, TabEntry> symbolTableG;
-/* For local variables */
-static std::unordered_map<std::string, TabEntry> symbolTableL;
-
-static std::unordered_map<std::string, std::vector<DataType>> funcParams;
-
-/**
- * Insert a parameter's type definition in to a function's
- * parameter list, which is used to type checking for 
- * function calls.
- */
-void tabInsertParam(const std::string &id, DataType &dtype)
-{
-    std::unordered_map<std::string, std::vector
-        <DataType>>::iterator it;
-    if ((it = funcParams.find(id)) == funcParams.end()) {
-        std::vector<DataType> params;
-        params.push_back(dtype);
-        funcParams[id] = params;
-    } 
-    else {
-        std::vector<DataType> &params = (*it).second;
-        params.push_back(dtype);
-    }
-}
-
-
-const std::vector<DataType> & tabGetParams(const std::string &id) 
-{
-    const static std::vector<DataType> EMPTY_PARAMS;
-    std::unordered_map<std::string, std::vector
-        <DataType>>::iterator it;
-    if ((it = funcParams.find(id)) != funcParams.end()) {
-        return (*it).second;
-    }
-    else return EMPTY_PARAMS;
-}
-
-
-/**
- * TODO: might use pointer to improve perfomance 
- */
-bool tabFind(const std::string &id, TabEntry &entry)
-{
-    std::unordered_map<std::string, TabEntry>::iterator it;
-    // find in local
-    if ((it = symbolTableL.find(id)) != symbolTableL.end()) {
-        entry = (*it).second;
-        return true;
-    }
-    // find in global
-    if ((it = symbolTableG.find(id)) != symbolTableG.end()) {
-        entry = (*it).second;
-        return true;
-    }
-    return false;
-}
-
-static void printTabEntry(const std::string &id, 
-        const TabEntry &entry)
-{
-    std::cout << id 
-        << ", " << itype2str[entry.itype]
-        << ", " << dtype2str[entry.dtype] 
-        << ", ";
-    if (entry.itype == IT_CONST) {
-        if (entry.dtype == DT_INT)
-            std::cout << entry.value;
-        else // DT_CHAR
-            std::cout << (char)entry.value;
-    }
-    else
-        std::cout << entry.value;
-    std::cout << ", " << entry.addr;
-    std::cout << std::endl;
-}
-
-void printSymbolTable(IdentScope scope)
-{
-    std::cout << (scope == GLOBAL ? 
-        "##############Global table##############\n":
-        "##############Local table###############\n");
-    const std::unordered_map<std::string, TabEntry> &symbolTable =
-        (scope == GLOBAL) ? symbolTableG : symbolTableL;
-    int count = 0;
-    for (auto const& item : symbolTable) {
-        count++;
-        std::cout << count << ":";
-        printTabEntry(item.first, item.second);
-    }
-    std::cout << "################Table End###########\n";
-    count = 0;
-}
-
-void tabInsert(
-    const std::string &id, 
-    const TabEntry &entry)
-{
-    // TODO: 
-    // local variable name can't be same with the name
-    // of the function where the local variable is defined in.
-    // (What a stupid rule!)
-    std::unordered_map<std::string, TabEntry> &symbolTable =
-        (entry.scope == GLOBAL) ? symbolTableG : symbolTableL;
-    if (symbolTable.find(id) != symbolTable.end()) {
-        error(entry.scope == GLOBAL ? ERR_DUPLICATE_GLOBAL_IDENTIFIER :
-                ERR_DUPLICATE_LOCAL_IDENTIFIER);
-        return;
-    }
-    symbolTable[id] = entry;
-}
-
-
-void tabClear(IdentScope scope)
-{
-    assert(scope == LOCAL);
-    symbolTableL.clear();
-}
-
-
-std::map<std::string, std::string> strings_table;
-static int strings_count = 0;
-/**
- * Insert string into strings table and generate
- * a label for the string.
- */
-std::string string2label(const std::string &str)
-{
-    std::map<std::string, std::string>::iterator it;
-    if ((it = strings_table.find(str)) != strings_table.end()) {
-        return (*it).second;
-    }
-    std::stringstream ss;
-    ss << "$STRING_" << strings_count;
-    std::string label = ss.str();
-    strings_table[str] = label;
-    strings_count++;
-    return label;
-}
+#include <vector>           // vector
+#include <algorithm>        // copy
+#include <utility>          // swap, move
+#include <cassert>          // assert
+#include <iomanip>          // setw
+#include <map>				// map
+#include <string>           // string, to_string()
+#include "symbol.h"
+#include "table.h"
+#include "error.h"
+
+
+/**
+ * A scope is a flat table of entries in order of definition, and
+ * an array indexed by identifier's name id, which holds the handle
+ * of an entry plus one, 0 if the name isn't defined. Only names of
+ * defined entries are set, so the index can be cleared without
+ * touching every name.
+ */
+struct SymbolTable {
+    std::vector<Name>       ids;
+    std::vector<TabEntry>   entries;
+    std::vector<unsigned>   index;
+};
+
+/* For global variables */
+static SymbolTable symbolTableG;
+/**
+ * For local variables, each thread parses its own function. Entries
+ * are in `local_scope`, or in a kept scope after tabEnterFunction().
+ */
+static thread_local FunctionScope local_scope;
+static thread_local FunctionScope *scope_in_use = NULL;
+static thread_local std::vector<unsigned> local_index;
+
+/* global entries with greater stamps are hidden */
+static thread_local unsigned int global_limit = TAB_NO_LIMIT;
+
+/* scopes of lowered functions, indexed by function's name id */
+static std::vector<FunctionScope> kept_scopes;
+static std::vector<unsigned> kept_index;
+
+static std::vector<std::vector<DataType>> funcParams;
+
+static const int WORD_SIZE = 4;     // char takes a word as int does
+
+/**
+ * Insert a parameter's type definition in to a function's
+ * parameter list, which is used to type checking for 
+ * function calls.
+ */
+void tabInsertParam(Name id, DataType &dtype)
+{
+    if (id.id >= funcParams.size())
+        funcParams.resize(nameCount());
+    funcParams[id.id].push_back(dtype);
+}
+
+
+const std::vector<DataType> & tabGetParams(Name id) 
+{
+    const static std::vector<DataType> EMPTY_PARAMS;
+    if (id.id < funcParams.size())
+        return funcParams[id.id];
+    else return EMPTY_PARAMS;
+}
+
+
+static FunctionScope &localScope()
+{
+    return scope_in_use == NULL ? local_scope : *scope_in_use;
+}
+
+/* handle + 1 of `id` in `index`, 0 if not found */
+static unsigned int findIn(const std::vector<unsigned> &index, Name id)
+{
+    return id.id < index.size() ? index[id.id] : 0;
+}
+
+static void setIndex(std::vector<unsigned> &index, Name id,
+        unsigned int handle)
+{
+    if (id.id >= index.size())
+        index.resize(nameCount(), 0);
+    index[id.id] = handle + 1;
+}
+
+/* clear the index of local scope in use */
+static void unbindLocals()
+{
+    for (Name id : localScope().ids) {
+        if (id != NAME_EMPTY)   // not a temp var
+            local_index[id.id] = 0;
+    }
+}
+
+TabHandle tabLookup(Name id)
+{
+    // find in local, then in global
+    unsigned int k = findIn(local_index, id);
+    if (k != 0)
+        return (k - 1) | TAB_LOCAL;
+    k = findIn(symbolTableG.index, id);
+    if (k != 0 && k <= global_limit)
+        return k - 1;
+    return TAB_NONE;
+}
+
+const TabEntry &tabEntry(TabHandle handle)
+{
+    assert(handle != TAB_NONE);
+    if (handle & TAB_LOCAL)
+        return localScope().entries[handle & ~TAB_LOCAL];
+    return symbolTableG.entries[handle];
+}
+
+Name tabName(TabHandle handle)
+{
+    assert(handle != TAB_NONE);
+    if (handle & TAB_LOCAL)
+        return localScope().ids[handle & ~TAB_LOCAL];
+    return symbolTableG.ids[handle];
+}
+
+unsigned int tabGlobalStamp()
+{
+    return symbolTableG.ids.size();
+}
+
+void tabLimitGlobals(unsigned int stamp)
+{
+    global_limit = stamp;
+}
+
+static void printTabEntry(Name id, const TabEntry &entry)
+{
+    std::cout << id 
+        << ", " << itype2str[entry.itype]
+        << ", " << dtype2str[entry.dtype] 
+        << ", ";
+    if (entry.itype == IT_CONST) {
+        if (entry.dtype == DT_INT)
+            std::cout << entry.value;
+        else // DT_CHAR
+            std::cout << (char)entry.value;
+    }
+    else
+        std::cout << entry.value;
+    std::cout << ", " << entry.addr;
+    std::cout << std::endl;
+}
+
+void printSymbolTable(IdentScope scope)
+{
+    std::cout << (scope == GLOBAL ? 
+        "##############Global table##############\n":
+        "##############Local table###############\n");
+    const std::vector<Name> &ids =
+        (scope == GLOBAL) ? symbolTableG.ids : localScope().ids;
+    const std::vector<TabEntry> &entries =
+        (scope == GLOBAL) ? symbolTableG.entries : localScope().entries;
+    for (size_t i = 0; i < ids.size(); i++) {
+        std::cout << i + 1 << ":";
+        printTabEntry(ids[i], entries[i]);
+    }
+    std::cout << "################Table End###########\n";
+}
+
+TabHandle tabInsert(Name id, const TabEntry &entry)
+{
+    // TODO: 
+    // local variable name can't be same with the name
+    // of the function where the local variable is defined in.
+    // (What a stupid rule!)
+    bool global = (entry.scope == GLOBAL);
+    std::vector<unsigned> &index = global ? symbolTableG.index : local_index;
+    if (findIn(index, id) != 0) {
+        error(global ? ERR_DUPLICATE_GLOBAL_IDENTIFIER :
+                ERR_DUPLICATE_LOCAL_IDENTIFIER);
+        return TAB_NONE;
+    }
+    // kept scopes are read only
+    assert(global || scope_in_use == NULL);
+    std::vector<Name> &ids = global ? symbolTableG.ids : local_scope.ids;
+    std::vector<TabEntry> &entries =
+        global ? symbolTableG.entries : local_scope.entries;
+    TabHandle handle = entries.size();
+    setIndex(index, id, handle);
+    ids.push_back(id);
+    entries.push_back(entry);
+    return global ? handle : handle | TAB_LOCAL;
+}
+
+
+void tabClear(IdentScope scope)
+{
+    unbindLocals();
+    scope_in_use = NULL;
+    local_scope = FunctionScope();
+    if (scope == GLOBAL) {
+        for (Name id : symbolTableG.ids)
+            symbolTableG.index[id.id] = 0;
+        symbolTableG.ids.clear();
+        symbolTableG.entries.clear();
+        for (const FunctionScope &kept : kept_scopes)
+            kept_index[kept.func.id] = 0;
+        kept_scopes.clear();
+        funcParams.clear();
+        global_limit = TAB_NO_LIMIT;
+        takeStrings();
+    }
+}
+
+SavedScope tabSaveScope(Arena &arena)
+{
+    assert(scope_in_use == NULL);
+    unsigned int count = local_scope.ids.size();
+    Name *ids = static_cast<Name *>(
+            arena.allocate(count * sizeof(Name), alignof(Name)));
+    TabEntry *entries = static_cast<TabEntry *>(
+            arena.allocate(count * sizeof(TabEntry), alignof(TabEntry)));
+    std::copy(local_scope.ids.begin(), local_scope.ids.end(), ids);
+    std::copy(local_scope.entries.begin(), local_scope.entries.end(),
+            entries);
+    tabClear(LOCAL);
+    SavedScope saved = { ids, entries, count };
+    return saved;
+}
+
+void tabRestoreScope(const SavedScope &saved, int first_temp)
+{
+    assert(scope_in_use == NULL && local_scope.ids.empty());
+    for (unsigned int i = 0; i < saved.count; i++) {
+        setIndex(local_index, saved.ids[i], i);
+        local_scope.ids.push_back(saved.ids[i]);
+        local_scope.entries.push_back(saved.entries[i]);
+    }
+    local_scope.first_temp = first_temp;
+}
+
+TabHandle tabInsertTemp(int temp, DataType dtype)
+{
+    FunctionScope &scope = localScope();
+    assert(temp >= scope.first_temp);
+    size_t k = temp - scope.first_temp;
+    if (k >= scope.temps.size())
+        scope.temps.resize(k + 1, TAB_NONE);
+    TabHandle handle = scope.entries.size();
+    scope.temps[k] = handle;
+    TabEntry entry = { LOCAL, IT_VARIABLE, dtype, -1, -1 };
+    scope.ids.push_back(NAME_EMPTY);
+    scope.entries.push_back(entry);
+    return handle | TAB_LOCAL;
+}
+
+int tabNextTemp()
+{
+    const FunctionScope &scope = localScope();
+    return scope.first_temp + scope.temps.size();
+}
+
+int tabMoveTemps(int first_temp)
+{
+    FunctionScope &scope = localScope();
+    int delta = first_temp - scope.first_temp;
+    scope.first_temp = first_temp;
+    return delta;
+}
+
+TabHandle tabTempHandle(int temp)
+{
+    const FunctionScope &scope = localScope();
+    size_t k = temp - scope.first_temp;
+    assert(k < scope.temps.size() && scope.temps[k] != TAB_NONE);
+    return scope.temps[k] | TAB_LOCAL;
+}
+
+void tabLayoutFrame(Name func)
+{
+    tabLayoutFrame(func, std::vector<int>());
+}
+
+void tabLayoutFrame(Name func, const std::vector<int> &slots)
+{
+    FunctionScope &scope = localScope();
+    std::vector<int> slot_addr;     // of each shared slot, 1 if none yet
+    int addr = 0;                   // below $ra
+    for (size_t k = 0; k < scope.entries.size(); k++) {
+        TabEntry &entry = scope.entries[k];
+        int slot = (k < slots.size() ? slots[k] : -1);
+        if (entry.itype == IT_VARIABLE && slot >= 0) {
+            if ((size_t)slot >= slot_addr.size())
+                slot_addr.resize(slot + 1, 1);
+            if (slot_addr[slot] == 1) {
+                addr -= WORD_SIZE;
+                slot_addr[slot] = addr;
+            }
+            entry.addr = slot_addr[slot];
+            continue;
+        }
+        if (entry.itype == IT_VARIABLE)
+            addr -= WORD_SIZE;
+        else if (entry.itype == IT_ARRAY)
+            addr -= WORD_SIZE * entry.value;
+        entry.addr = addr;
+    }
+    int size = WORD_SIZE - addr;    // $ra included
+    for (TabEntry &entry : scope.entries)
+        entry.addr += size - WORD_SIZE;
+    scope.func = func;
+    scope.frame_size = size;
+}
+
+FunctionScope tabTakeScope()
+{
+    assert(scope_in_use == NULL);
+    unbindLocals();
+    FunctionScope scope;
+    std::swap(scope, local_scope);
+    return scope;
+}
+
+void tabKeepScope(FunctionScope &scope)
+{
+    // a kept scope in use may be moved when it grows
+    if (scope_in_use != NULL) {
+        unbindLocals();
+        scope_in_use = NULL;
+    }
+    setIndex(kept_index, scope.func, kept_scopes.size());
+    kept_scopes.push_back(std::move(scope));
+}
+
+int tabEnterFunction(Name func)
+{
+    unsigned int k = findIn(kept_index, func);
+    assert(k != 0);
+    unbindLocals();
+    local_scope = FunctionScope();
+    scope_in_use = &kept_scopes[k - 1];
+    for (size_t i = 0; i < scope_in_use->ids.size(); i++) {
+        if (scope_in_use->ids[i] != NAME_EMPTY)     // not a temp var
+            setIndex(local_index, scope_in_use->ids[i], i);
+    }
+    return scope_in_use->frame_size;
+}
+
+const std::vector<FunctionScope> &tabKeptScopes()
+{
+    return kept_scopes;
+}
+
+
+thread_local std::map<std::string, int> strings_table;
+static thread_local std::vector<std::string> strings_labeled;  // in order
+/**
+ * Insert string into strings table and generate
+ * a label for the string.
+ */
+int string2label(const std::string &str)
+{
+    std::map<std::string, int>::iterator it;
+    if ((it = strings_table.find(str)) != strings_table.end()) {
+        return (*it).second;
+    }
+    int label = strings_labeled.size();
+    strings_table[str] = label;
+    strings_labeled.push_back(str);
+    return label;
+}
+
+std::vector<std::string> takeStrings()
+{
+    std::vector<std::string> res;
+    res.swap(strings_labeled);
+    strings_table.clear();
+    return res;
+}
+
+const std::vector<std::string> &labeledStrings()
+{
+    return strings_labeled;
+}
+
+std::vector<int> relabelStrings(const std::vector<std::string> &strings)
+{
+    std::vector<int> labels;
+    for (const std::string &str : strings)
+        labels.push_back(string2label(str));
+    return labels;
+}
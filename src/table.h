@@ -1,88 +1,204 @@
-/**
- * This is symbol table management module
- */
-
-#ifndef TABLE_H_
-#define TABLE_H_
-
-#include <unordered_map>    // unordered_map
-#include "symbol.h"
-
-enum IdentScope {
-    GLOBAL,
-    LOCAL,
-};
-
-/* IT is short of identifier type */
-enum IdentType {
-    IT_CONST,
-    IT_VARIABLE,
-    IT_FUNCTION, 
-    IT_ARRAY,
-};
-
-/* DT is short of data type */
-enum DataType {
-    DT_VOID = 0,     /* used for functions without return value */
-    DT_INT,
-    DT_CHAR,
-};
-
-typedef Symset ITset; // identifier type set
-typedef Symset DTset; // data type type set
-
-static std::string itype2str[] = { 
-    "IT_CONST", "IT_VARIABLE", "IT_FUNCTION"
-};
-static std::string dtype2str[] = { 
-    "DT_VOID", "DE_INT", "DT_CHAR", "DT_ARRAY" 
-};
-static std::string dtype2midtype[] = {
-    "void", "int", "char", "array",
-};
-
-/**
- * scope: 
- *   identifier's scope
- *
- * itype: 1. const identifier(IT_CONST)
- *        2. variable identifier(IT_VARIABLE)
- *        3. function identifier(IT_FUNCTION)
- *        4. array identifier(IT_ARRAY)
- * dtype: 
- *   for consts: DT_CHAR for char const
- *               DT_INT for int const
- *   for variables: DT_CHAR for char variable
- *                  DT_INT for int variable
- *   for functions: DT_CHAR for char functions(return char value)
- *                  DT_INT for int functions(return int value)
- *                  DT_VOID for void functions(no return value)
- * value:
- *   for consts: 
- *      * value of int or ASCII value of char
- *   for arrays:
- *      * array size
- * addr:
- *   for arrays and variables:
- *      * allocated relative address in function
- */
-typedef struct _TabEntry {
-    IdentScope  scope;
-    IdentType   itype;
-    DataType    dtype;
-    int         value;
-    int         addr;
-} TabEntry;
-
-void tabInsert(const std::string &id, const TabEntry &entry);
-bool tabFind(const std::string &id, TabEntry &entry);
-void tabClear(IdentScope scope);
-
-void tabInsertParam(const std::string &id, DataType &dtype);
-const std::vector<DataType> & tabGetParams(const std::string &id);
-
-void printSymbolTable(IdentScope scope);
-
-std::string string2label(const std::string &str);
-
-#endif // TABLE_H_
+/**
+ * This is symbol table management module
+ */
+
+#ifndef TABLE_H_
+#define TABLE_H_
+
+#include <vector>           // vector
+#include <map>              // map
+#include <string>           // string
+#include "symbol.h"
+#include "intern.h"
+#include "arena.h"
+
+enum IdentScope {
+    GLOBAL,
+    LOCAL,
+};
+
+/* IT is short of identifier type */
+enum IdentType {
+    IT_CONST,
+    IT_VARIABLE,
+    IT_FUNCTION, 
+    IT_ARRAY,
+};
+
+/* DT is short of data type */
+enum DataType {
+    DT_VOID = 0,     /* used for functions without return value */
+    DT_INT,
+    DT_CHAR,
+    DT_STR,         /* only in mid-code, printf of a string */
+};
+
+typedef Symset ITset; // identifier type set
+typedef Symset DTset; // data type type set
+
+static std::string itype2str[] = { 
+    "IT_CONST", "IT_VARIABLE", "IT_FUNCTION"
+};
+static std::string dtype2str[] = { 
+    "DT_VOID", "DE_INT", "DT_CHAR", "DT_STR" 
+};
+static std::string dtype2midtype[] = {
+    "void", "int", "char", "str",
+};
+
+/**
+ * scope: 
+ *   identifier's scope
+ *
+ * itype: 1. const identifier(IT_CONST)
+ *        2. variable identifier(IT_VARIABLE)
+ *        3. function identifier(IT_FUNCTION)
+ *        4. array identifier(IT_ARRAY)
+ * dtype: 
+ *   for consts: DT_CHAR for char const
+ *               DT_INT for int const
+ *   for variables: DT_CHAR for char variable
+ *                  DT_INT for int variable
+ *   for functions: DT_CHAR for char functions(return char value)
+ *                  DT_INT for int functions(return int value)
+ *                  DT_VOID for void functions(no return value)
+ * value:
+ *   for consts: 
+ *      * value of int or ASCII value of char
+ *   for arrays:
+ *      * array size
+ * addr:
+ *   for local arrays and variables:
+ *      * relative address in function's frame, see tabLayoutFrame()
+ */
+typedef struct _TabEntry {
+    IdentScope  scope;
+    IdentType   itype;
+    DataType    dtype;
+    int         value;
+    int         addr;
+} TabEntry;
+
+/**
+ * Entries of a scope are kept in a flat table in order of definition,
+ * a handle is the index of an entry in its table. Handles of local
+ * entries have TAB_LOCAL set, they index the local scope in use.
+ * Lookups index arrays by name id, no string is hashed.
+ */
+typedef unsigned int TabHandle;
+#define TAB_NONE        0xffffffffu
+#define TAB_LOCAL       0x80000000u
+
+/* return TAB_NONE if `id` is already defined in the scope */
+TabHandle tabInsert(Name id, const TabEntry &entry);
+/* find in local scope, then in global, TAB_NONE if not found */
+TabHandle tabLookup(Name id);
+const TabEntry &tabEntry(TabHandle handle);
+Name tabName(TabHandle handle);
+/**
+ * Clearing LOCAL drops the local scope in use. Clearing GLOBAL
+ * clears all tables, kept scopes, parameter lists and strings.
+ */
+void tabClear(IdentScope scope);
+
+/**
+ * Local scope of a function lives from parsing through code
+ * generation, on the thread it's parsed on:
+ *  1. parser defines parameters, consts and variables, then saves
+ *     the scope in the syntax tree by tabSaveScope()
+ *  2. lowering restores it by tabRestoreScope(), defines temp vars
+ *     as variables and assigns frame offsets by tabLayoutFrame(),
+ *     then it's kept by tabKeepScope(tabTakeScope())
+ *  3. code generator uses it again by tabEnterFunction()
+ * The optimizer may add temp vars to a kept scope in use, and lay
+ * out its frame again, see optimize.h.
+ */
+struct SavedScope {
+    const Name     *ids;
+    const TabEntry *entries;
+    unsigned int    count;
+};
+
+/**
+ * Temp vars have no names in the scope, temp var n is the entry
+ * `temps[n - first_temp]`, and the function's temp vars are
+ * numbered from `first_temp`.
+ */
+struct FunctionScope {
+    Name                    func;
+    std::vector<Name>       ids;        // in order of definition
+    std::vector<TabEntry>   entries;
+    int                     frame_size; // $ra included
+    int                     first_temp;
+    std::vector<unsigned>   temps;
+};
+
+/* save local scope in `arena`, and clear it */
+SavedScope tabSaveScope(Arena &arena);
+/**
+ * Define saved entries in the local scope, which must be empty.
+ * Temp vars of the function are numbered from `first_temp`.
+ */
+void tabRestoreScope(const SavedScope &saved, int first_temp);
+/* define temp var `temp` as a local variable */
+TabHandle tabInsertTemp(int temp, DataType dtype);
+/* handle of temp var `temp` in local scope */
+TabHandle tabTempHandle(int temp);
+/* number after the last temp var of local scope, free for a new one */
+int tabNextTemp();
+/**
+ * Number temp vars of local scope from `first_temp` on, in the same
+ * order. Return how much their numbers are moved by.
+ */
+int tabMoveTemps(int first_temp);
+/**
+ * Give local variables and arrays of function `func` offsets in its
+ * frame in order of definition, the first one at the top.
+ */
+void tabLayoutFrame(Name func);
+/**
+ * Lay out the frame the same way, but local variables of the same
+ * slot share it, `slots[k]` is the slot of entry k, -1 for its own.
+ */
+void tabLayoutFrame(Name func, const std::vector<int> &slots);
+/* take the local scope away, it's cleared */
+FunctionScope tabTakeScope();
+/* keep `scope` for code generation, it's moved from */
+void tabKeepScope(FunctionScope &scope);
+/* use kept scope of `func` as local scope, return its frame size */
+int tabEnterFunction(Name func);
+/* kept scopes in order of functions, for saving them in IR files */
+const std::vector<FunctionScope> &tabKeptScopes();
+
+/**
+ * Global entries are stamped 1, 2, 3, ... in order of insertion.
+ * tabLimitGlobals(stamp) hides entries inserted after `stamp`
+ * from tabFind(), so that a function can be parsed again seeing
+ * the same globals as the first time. TAB_NO_LIMIT shows all.
+ */
+#define TAB_NO_LIMIT    0xffffffffu
+unsigned int tabGlobalStamp();      // stamp of the last entry
+void tabLimitGlobals(unsigned int stamp);
+
+void tabInsertParam(Name id, DataType &dtype);
+const std::vector<DataType> & tabGetParams(Name id);
+
+void printSymbolTable(IdentScope scope);
+
+/**
+ * Strings are labeled $STRING_0, $STRING_1, ... in order of first
+ * use, n of its label $STRING_n is returned. Each thread has its
+ * own strings table.
+ */
+int string2label(const std::string &str);
+/* strings labeled on this thread in order, the table is cleared */
+std::vector<std::string> takeStrings();
+/* strings labeled on this thread in order */
+const std::vector<std::string> &labeledStrings();
+/**
+ * Label `strings` taken from another thread on this thread in
+ * order, return their labels here.
+ */
+std::vector<int> relabelStrings(const std::vector<std::string> &strings);
+
+#endif // TABLE_H_
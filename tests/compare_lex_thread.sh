@@ -0,0 +1,15 @@
+#!/bin/sh
+# Compile every test program with and without --lex-thread, the
+# output (source echo, diagnostics) must be the same.
+# Run from the repository root after `make`.
+status=0
+for file in tests/*.txt; do
+    ./test "$file" > /tmp/lex_serial.out 2>&1
+    ./test --lex-thread "$file" > /tmp/lex_thread.out 2>&1
+    if ! cmp -s /tmp/lex_serial.out /tmp/lex_thread.out; then
+        echo "differs with --lex-thread: $file"
+        status=1
+    fi
+done
+rm -f /tmp/lex_serial.out /tmp/lex_thread.out
+exit $status